@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ *
+ * This example reads the synthetic audio source's signals through the
+ * audio source interface, the way the usb_microphone example reads its
+ * source every USB frame, and prints how long the reads take and whether
+ * the levels come out as configured. It needs no microphone, and also
+ * builds for the SDK's host platform (cmake -DPICO_PLATFORM=host).
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "pico/stdlib.h"
+#include "pico/synth_source.h"
+
+#define SAMPLE_RATE 48000
+#define SAMPLE_BUFFER_SIZE 48 // 1 ms, as a USB frame
+#define CHANNELS 2
+#define AMPLITUDE 16384
+#define BLOCKS 1000
+
+// variables
+int16_t sample_buffer[SAMPLE_BUFFER_SIZE * CHANNELS];
+int32_t sample_buffer32[SAMPLE_BUFFER_SIZE * CHANNELS];
+
+// reads BLOCKS blocks, returns false if the level is off
+bool bench(const char* label, const struct synth_source_config* config, bool q31, float expected_rms)
+{
+    struct audio_source source;
+
+    if (synth_source_init(&source, config) < 0) {
+        printf("%-12s init failed\n", label);
+        return false;
+    }
+    audio_source_start(&source);
+
+    // time the reads alone first
+    const uint64_t start_us = time_us_64();
+
+    for (int block = 0; block < BLOCKS; block++) {
+        if (q31) {
+            audio_source_read32(&source, sample_buffer32, SAMPLE_BUFFER_SIZE);
+        } else {
+            audio_source_read(&source, sample_buffer, SAMPLE_BUFFER_SIZE);
+        }
+    }
+
+    const uint64_t busy_us = time_us_64() - start_us;
+
+    // then the same samples again, for their level (past the PDM decimator's
+    // DC blocker settling)
+    audio_source_start(&source);
+
+    double sum_squares = 0;
+
+    for (int block = 0; block < BLOCKS; block++) {
+        if (q31) {
+            audio_source_read32(&source, sample_buffer32, SAMPLE_BUFFER_SIZE);
+        } else {
+            audio_source_read(&source, sample_buffer, SAMPLE_BUFFER_SIZE);
+        }
+
+        if (block >= BLOCKS / 2) {
+            for (int i = 0; i < SAMPLE_BUFFER_SIZE * CHANNELS; i++) {
+                const float x = q31 ? sample_buffer32[i] / 65536.0f : sample_buffer[i];
+
+                sum_squares += x * x;
+            }
+        }
+    }
+
+    const float rms = sqrt(sum_squares / (BLOCKS / 2 * SAMPLE_BUFFER_SIZE * CHANNELS));
+    const bool ok = fabsf(rms - expected_rms) < expected_rms * 0.01f;
+    struct audio_source_stats stats;
+
+    audio_source_get_stats(&source, &stats);
+    audio_source_deinit(&source);
+
+    printf("%-12s %4lu blocks: %6.1f us per block (%5.1f%% of real time), rms %7.1f (expected %7.1f) %s\n",
+           label, (unsigned long)stats.blocks_read, (float)busy_us / BLOCKS,
+           100.0f * busy_us / (BLOCKS * 1e6f * SAMPLE_BUFFER_SIZE / SAMPLE_RATE),
+           rms, expected_rms, ok ? "ok" : "FAIL");
+
+    return ok;
+}
+
+int main(void)
+{
+    // initialize stdio and wait for USB CDC connect
+    stdio_init_all();
+#if PICO_ON_DEVICE
+    while (!stdio_usb_connected()) {
+        tight_loop_contents();
+    }
+#endif
+
+    struct synth_source_config config = {
+        .sample_rate = SAMPLE_RATE,
+        .sample_buffer_size = SAMPLE_BUFFER_SIZE,
+        .channels = CHANNELS,
+        .amplitude = AMPLITUDE,
+    };
+    bool ok = true;
+
+    config.signal = SYNTH_SOURCE_TONE;
+    ok &= bench("tone", &config, false, AMPLITUDE / sqrtf(2));
+    ok &= bench("tone q31", &config, true, AMPLITUDE / sqrtf(2));
+
+    config.signal = SYNTH_SOURCE_NOISE;
+    ok &= bench("noise", &config, false, AMPLITUDE / sqrtf(3));
+
+    config.signal = SYNTH_SOURCE_PDM;
+    config.decimation = 64;
+    ok &= bench("pdm /64", &config, false, AMPLITUDE / sqrtf(2));
+    ok &= bench("pdm /64 q31", &config, true, AMPLITUDE / sqrtf(2));
+
+    printf("%s\n", ok ? "ok" : "FAIL");
+
+    return ok ? 0 : 1;
+}
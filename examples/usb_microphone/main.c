@@ -5,20 +5,50 @@
  * 
  * This examples creates a USB Microphone device using the TinyUSB
  * library and captures data from a PDM microphone using a sample
- * rate of 16 kHz, to be sent the to PC.
+ * rate of 16 kHz, to be sent the to PC. The USB_MICROPHONE_SOURCE
+ * CMake option streams from an analog microphone or the synthetic
+ * test signal instead, through the same audio source calls.
  * 
  * The USB microphone code is based on the TinyUSB audio_test example.
  * 
  * https://github.com/hathach/tinyusb/tree/master/examples/device/audio_test
  */
 
+#include <stdio.h>
+#include <string.h>
+
 #include "pico/critical_section.h"
+#include "pico/stdlib.h"
 
+#include "pico/audio_source.h"
 #include "pico/pdm_microphone.h"
+#include "pico/pdm_profile.h"
+#if defined(USB_MICROPHONE_SOURCE_ANALOG)
+#include "pico/analog_microphone.h"
+#elif defined(USB_MICROPHONE_SOURCE_SYNTH)
+#include "pico/synth_source.h"
+#endif
 
 #include "usb_microphone.h"
 
 // configuration
+#if defined(USB_MICROPHONE_SOURCE_ANALOG)
+const struct analog_microphone_config config = {
+  .gpio = 26,
+  .bias_voltage = 1.25,
+  .sample_rate = SAMPLE_RATE,
+  .sample_buffer_size = SAMPLE_BUFFER_SIZE / 4, // a USB frame is 4 blocks, read a block behind the ADC
+  .channels = CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX,
+  .oversample = 4,
+};
+#elif defined(USB_MICROPHONE_SOURCE_SYNTH)
+const struct synth_source_config config = {
+  .signal = SYNTH_SOURCE_TONE,
+  .sample_rate = SAMPLE_RATE,
+  .sample_buffer_size = SAMPLE_BUFFER_SIZE,
+  .channels = CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX,
+};
+#else
 const struct pdm_microphone_config config = {
   .gpio_clk = 6,
   .gpio_data = 2,
@@ -26,26 +56,76 @@ const struct pdm_microphone_config config = {
   .pio_sm = 0,
   .sample_rate = SAMPLE_RATE,
   .sample_buffer_size = SAMPLE_BUFFER_SIZE,
+  .resample = true,
+  .raw_buffer_count = 8, // resample keeps the reader half way, no need for 64
+  .free_running = true, // the DMA cycles through the raw buffers without IRQs
+  .placement = PDM_MICROPHONE_PLACEMENT_CORE1, // filter on core1, the USB callbacks on core0 only copy frames
 };
+#endif
 
 // variables
 critical_section_t crit_sect;
+struct audio_source source;
+#if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2
 uint16_t sample_buffer[SAMPLE_BUFFER_SIZE*CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX];
+#else
+int32_t sample_buffer[SAMPLE_BUFFER_SIZE*CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX];
+#endif
 
 // callback functions
-void on_pdm_samples_ready();
 void on_usb_microphone_post_tx();
 void on_usb_microphone_pre_tx();
+void print_profile();
+void report_health();
+void halt(const char* what);
 
 // main entrypoint
 int main(void) {
+#if !defined(USB_MICROPHONE_SOURCE_ANALOG) && !defined(USB_MICROPHONE_SOURCE_SYNTH)
+  // run clk_sys at a frequency near the default 125 MHz that the PIO divides
+  // down to the exact PDM clock, e.g. 132 MHz for 88 kHz at /48
+  const uint32_t sample_rates[] = { SAMPLE_RATE };
+  const uint8_t decimations[] = { PDM_DECIMATION };
+  const struct pdm_clock_request clock_request = {
+    .sample_rates = sample_rates,
+    .n_sample_rates = 1,
+    .decimations = decimations,
+    .n_decimations = 1,
+    .cycles_per_bit = pdm_microphone_cycles_per_bit(),
+    .sys_clock_min_khz = 120000,
+    .sys_clock_max_khz = 133000,
+    .pdm_clock_min_hz = 1000000,
+    .pdm_clock_max_hz = 4800000,
+  };
+  struct pdm_clock_plan clock_plan;
+  if (pdm_clock_plan(&clock_request, &clock_plan) == 0) {
+    set_sys_clock_khz(clock_plan.sys_clock_khz, true);
+  }
+#endif
+
+  // for the profile and for the diagnostics below
+  stdio_init_all();
+
   // initialize critical section objects
   critical_section_init(&crit_sect);
 
-  // initialize and start the PDM microphone
-  pdm_microphone_init(&config);
-  pdm_microphone_set_samples_ready_handler(on_pdm_samples_ready);
-  pdm_microphone_start();
+  // initialize and start the audio source
+#if defined(USB_MICROPHONE_SOURCE_ANALOG)
+  if (analog_microphone_source_init(&source, &config) < 0) {
+    halt("analog microphone source initialization failed!");
+  }
+#elif defined(USB_MICROPHONE_SOURCE_SYNTH)
+  if (synth_source_init(&source, &config) < 0) {
+    halt("synth source initialization failed!");
+  }
+#else
+  if (pdm_microphone_source_init(&source, &config) < 0) {
+    halt("PDM microphone source initialization failed!");
+  }
+#endif
+  if (audio_source_start(&source) < 0) {
+    halt("audio source start failed!");
+  }
 
   // initialize the USB microphone interface
   usb_microphone_init();
@@ -56,20 +136,31 @@ int main(void) {
   while (1) {
     // handle any USB mic tasks
     usb_microphone_task();
+    report_health();
+
+#if PDM_PROFILE
+    print_profile();
+#endif
   }
 
   // return success
   return 0;
 }
 
-// PDM DMA completion callback
-void on_pdm_samples_ready() {}
-
 // tinyUSB post-transmission callback
 void on_usb_microphone_post_tx() {
-  // process PDM samples and populate local buffer
+  // read the source's samples into the local buffer
   critical_section_enter_blocking(&crit_sect);
-  pdm_microphone_read(sample_buffer, SAMPLE_BUFFER_SIZE);
+#if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2
+  int n = audio_source_read(&source, (int16_t*)sample_buffer, SAMPLE_BUFFER_SIZE);
+#else
+  int n = audio_source_read32(&source, sample_buffer, SAMPLE_BUFFER_SIZE);
+#endif
+  // a source that came up short (e.g. the analog one while it buffers its
+  // cushion, or after an underrun) sends silence for the rest of the frame
+  for (uint j = 0; n >= 0 && n < SAMPLE_BUFFER_SIZE && j < source.channels; j++) {
+    memset(&sample_buffer[j * SAMPLE_BUFFER_SIZE + n], 0x00, (SAMPLE_BUFFER_SIZE - n) * sizeof(sample_buffer[0]));
+  }
   critical_section_exit(&crit_sect);
 }
 
@@ -79,4 +170,81 @@ void on_usb_microphone_pre_tx() {
   critical_section_enter_blocking(&crit_sect);
   usb_microphone_write(sample_buffer);
   critical_section_exit(&crit_sect);
-}
\ No newline at end of file
+}
+
+// sends the capture health counters to the CDC interface once a second,
+// while a terminal is connected
+void report_health() {
+  static uint64_t next_us = 0;
+  const uint64_t now_us = time_us_64();
+
+  if (now_us < next_us || !usb_microphone_health_connected()) {
+    return;
+  }
+  next_us = now_us + 1000000;
+
+  struct audio_source_stats stats;
+  uint32_t latency_us;
+  char line[384];
+  int n;
+
+  critical_section_enter_blocking(&crit_sect);
+  audio_source_get_stats(&source, &stats);
+  latency_us = audio_source_latency_us(&source);
+  critical_section_exit(&crit_sect);
+
+  n = snprintf(line, sizeof(line),
+               "t %lu ms source %s blocks %lu overruns %lu underruns %lu dropped %lu repeated %lu "
+               "saturated %lu latency %lu us short_writes %lu",
+               (unsigned long)(now_us / 1000), source.name, (unsigned long)stats.blocks_written,
+               (unsigned long)stats.overruns, (unsigned long)stats.underruns,
+               (unsigned long)stats.blocks_dropped, (unsigned long)stats.blocks_repeated,
+               (unsigned long)stats.saturated, (unsigned long)latency_us,
+               (unsigned long)usb_microphone_short_writes());
+#if !defined(USB_MICROPHONE_SOURCE_ANALOG) && !defined(USB_MICROPHONE_SOURCE_SYNTH)
+  // the PDM driver's own counters on top
+  struct pdm_microphone_health health;
+
+  critical_section_enter_blocking(&crit_sect);
+  pdm_microphone_instance_get_health(source.context, &health);
+  critical_section_exit(&crit_sect);
+
+  n += snprintf(line + n, sizeof(line) - n, " late_irqs %lu distance", (unsigned long)health.late_irqs);
+  for (int i = 0; i < PDM_MICROPHONE_DISTANCE_BUCKETS && n < (int)sizeof(line) - 12; i++) {
+    n += snprintf(line + n, sizeof(line) - n, " %lu", (unsigned long)health.distance[i]);
+  }
+#endif
+  snprintf(line + n, sizeof(line) - n, "\r\n");
+
+  usb_microphone_health_write(line);
+}
+
+// prints the pipeline's stage timings every 10 seconds (PDM_PROFILE builds)
+void print_profile() {
+  static uint64_t next_us = 10000000;
+  const uint64_t now_us = time_us_64();
+
+  if (now_us < next_us) {
+    return;
+  }
+  next_us = now_us + 10000000;
+
+  const float us_per_tick = 1e6f / pdm_profile_tick_hz();
+  for (int stage = 0; stage < PDM_PROFILE_STAGES; stage++) {
+    struct pdm_profile_stats stats;
+
+    if (pdm_profile_get_stats(stage, &stats)) {
+      printf("%-10s %8lu x  min %7.1f  mean %7.1f  p50 %7.1f  p90 %7.1f  p99 %7.1f  max %7.1f us\n",
+             pdm_profile_stage_name(stage), (unsigned long)stats.count, stats.min * us_per_tick,
+             stats.mean * us_per_tick, stats.p50 * us_per_tick, stats.p90 * us_per_tick,
+             stats.p99 * us_per_tick, stats.max * us_per_tick);
+    }
+  }
+}
+
+// prints what failed and stops there, without enumerating a USB device that
+// would stream nothing
+void halt(const char* what) {
+  printf("%s\n", what);
+  while (1) { tight_loop_contents(); }
+}
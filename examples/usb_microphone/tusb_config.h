@@ -85,13 +85,21 @@ extern "C" {
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_CDC               0
+#define CFG_TUD_CDC               1 // capture health reports, next to the audio function
 #define CFG_TUD_MSC               0
 #define CFG_TUD_HID               0
 #define CFG_TUD_MIDI              0
 #define CFG_TUD_AUDIO             1
 #define CFG_TUD_VENDOR            0
 
+//--------------------------------------------------------------------
+// CDC CLASS DRIVER CONFIGURATION
+//--------------------------------------------------------------------
+
+#define CFG_TUD_CDC_RX_BUFSIZE    64
+#define CFG_TUD_CDC_TX_BUFSIZE    512 // a whole health report
+#define CFG_TUD_CDC_EP_BUFSIZE    64
+
 //--------------------------------------------------------------------
 // AUDIO CLASS DRIVER CONFIGURATION
 //--------------------------------------------------------------------
@@ -104,12 +112,17 @@ extern "C" {
 #define CFG_TUD_AUDIO_FUNC_1_CTRL_BUF_SZ                              64                                      // Size of control request buffer
 
 #define CFG_TUD_AUDIO_ENABLE_EP_IN                                    1
-#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX                    2                                       // Driver gets this info from the descriptors - we define it here to use it to setup the descriptors and to do calculations with it below
+#define CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX                    2                                       // Driver gets this info from the descriptors - we define it here to use it to setup the descriptors and to do calculations with it below - 2 (16 bit), 3 (packed 24 bit) or 4 (24 or 32 bit in 32)
+#define CFG_TUD_AUDIO_FUNC_1_RESOLUTION_TX                            (CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2 ? 16 : 24) // Valid (most significant) bits per sample
 #define CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX                            1                                       // Driver gets this info from the descriptors - we define it here to use it to setup the descriptors and to do calculations with it below - be aware: for different number of channels you need another descriptor!
 #define CFG_TUD_AUDIO_EP_SZ_IN                                        (MS_PER_FRAME * SAMPLES_PER_MS) * CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX * CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX
 #define CFG_TUD_AUDIO_FUNC_1_EP_IN_SZ_MAX                             CFG_TUD_AUDIO_EP_SZ_IN                  // Maximum EP IN size for all AS alternate settings used
 #define CFG_TUD_AUDIO_FUNC_1_EP_IN_SW_BUF_SZ                          CFG_TUD_AUDIO_EP_SZ_IN
 
+#if CFG_TUD_AUDIO_EP_SZ_IN > 1023
+#error "Isochronous full-speed packets are limited to 1023 bytes, reduce the sample rate, channels or sample size!"
+#endif
+
 // #define CFG_TUD_AUDIO_ENABLE_ENCODING                                 0
 // #define CFG_TUD_AUDIO_ENABLE_ENCODING                                 1
 // #define CFG_TUD_AUDIO_ENABLE_TYPE_I_ENCODING                          1
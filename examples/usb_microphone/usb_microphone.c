@@ -25,6 +25,8 @@
 
 #include "usb_microphone.h"
 
+#include "pico/pdm_profile.h"
+
 // Audio controls
 // Current states
 bool mute[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX + 1]; 						// +1 for master channel 0
@@ -40,6 +42,9 @@ audio_control_range_4_n_t(1) sampleFreqRng; 						// Sample frequency range stat
 static usb_microphone_tx_ready_handler_t usb_microphone_tx_ready_handler = NULL;
 static usb_microphone_tx_done_handler_t usb_microphone_tx_done_handler = NULL;
 
+// tud_audio_write() calls that did not take the whole frame
+static uint32_t short_writes = 0;
+
 /*------------- MAIN -------------*/
 void usb_microphone_init()
 {
@@ -64,20 +69,66 @@ void usb_microphone_set_tx_done_handler(usb_microphone_tx_done_handler_t handler
 }
 
 // tmp buffer (TODO: TMP)
-uint16_t tmp_sample_buffer[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX*SAMPLE_BUFFER_SIZE];
+uint8_t tmp_sample_buffer[CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX*SAMPLE_BUFFER_SIZE*CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX];
 
 // write input data to tinyusb device fifo
+// (uint16_t samples, or Q31 int32_t samples for 3 and 4 bytes per sample)
 uint16_t usb_microphone_write(const void * data) {
+  PDM_PROFILE_BEGIN(interleave_start);
+#if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 2
   // interleave samples
   uint16_t const* buf16 = (uint16_t const*) data;
+  uint16_t* tmp16 = (uint16_t*) tmp_sample_buffer;
   for (int j = 0; j < CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX; j++) {
     for (uint8_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
-      tmp_sample_buffer[j+CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX*i] = buf16[j*SAMPLE_BUFFER_SIZE+i];
+      tmp16[j+CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX*i] = buf16[j*SAMPLE_BUFFER_SIZE+i];
+    }
+  }
+#else
+  // interleave samples, keeping the valid (upper) bits little endian and
+  // MSB-aligned in each subslot, as the descriptors announce
+  int32_t const* buf32 = (int32_t const*) data;
+  uint32_t const mask = ~0u << (32 - CFG_TUD_AUDIO_FUNC_1_RESOLUTION_TX);
+  uint8_t* out = tmp_sample_buffer;
+  for (uint8_t i = 0; i < SAMPLE_BUFFER_SIZE; i++) {
+    for (int j = 0; j < CFG_TUD_AUDIO_FUNC_1_N_CHANNELS_TX; j++) {
+      uint32_t sample = (uint32_t) buf32[j*SAMPLE_BUFFER_SIZE+i] & mask;
+#if CFG_TUD_AUDIO_FUNC_1_N_BYTES_PER_SAMPLE_TX == 4
+      *out++ = sample;
+#endif
+      *out++ = sample >> 8;
+      *out++ = sample >> 16;
+      *out++ = sample >> 24;
     }
   }
+#endif
+
+  PDM_PROFILE_END(PDM_PROFILE_INTERLEAVE, interleave_start);
 
   // write interleaved samples
-  tud_audio_write((uint8_t *)tmp_sample_buffer, sizeof(tmp_sample_buffer));
+  PDM_PROFILE_BEGIN(write_start);
+  uint16_t const written = tud_audio_write(tmp_sample_buffer, sizeof(tmp_sample_buffer));
+  PDM_PROFILE_END(PDM_PROFILE_WRITE, write_start);
+
+  if (written < sizeof(tmp_sample_buffer)) {
+    short_writes++;
+  }
+
+  return written;
+}
+
+uint32_t usb_microphone_short_writes() {
+  return short_writes;
+}
+
+bool usb_microphone_health_connected() {
+  return tud_cdc_connected();
+}
+
+void usb_microphone_health_write(const char * text) {
+  // drop what does not fit rather than stall the audio
+  tud_cdc_write_str(text);
+  tud_cdc_write_flush();
 }
 
 void usb_microphone_task() {
@@ -21,5 +21,10 @@ void usb_microphone_set_tx_ready_handler(usb_microphone_tx_ready_handler_t handl
 void usb_microphone_set_tx_done_handler(usb_microphone_tx_done_handler_t handler);
 void usb_microphone_task();
 uint16_t usb_microphone_write(const void * data);
+uint32_t usb_microphone_short_writes();
+
+// capture health reports, on the CDC interface
+bool usb_microphone_health_connected();
+void usb_microphone_health_write(const char * text);
 
 #endif
@@ -35,13 +35,29 @@
 /* Globals */
 
 #ifdef USE_LUT
-  int32_t lut[256][DECIMATION_MAX / 8][SINCN];
+#if defined(LUT_IN_FLASH)
+#define LUT_STORAGE const __attribute__((section(".flashdata.pdm_lut")))
+#elif defined(LUT_IN_SCRATCH_X)
+#define LUT_STORAGE __attribute__((section(".scratch_x.pdm_lut")))
+#elif defined(LUT_IN_SCRATCH_Y)
+#define LUT_STORAGE __attribute__((section(".scratch_y.pdm_lut")))
+#else
+#define LUT_STORAGE
+#endif
+
+#ifdef LUT_PRECOMPUTED
+#include "pdm_lut.h"
+#else
+  lut_entry_t lut[LUT_SIZE][LUT_DECIMATION / LUT_BITS][SINCN];
+#endif
 #endif
 
 
 /* Functions -----------------------------------------------------------------*/
  
 #ifdef USE_LUT
+#if LUT_BITS == 8
+#if LUT_HAS(48)
 int32_t filter_table_mono_48(uint8_t *data, uint8_t sincn) {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -51,7 +67,9 @@ int32_t filter_table_mono_48(uint8_t *data, uint8_t sincn) {
     lut[data[4]][4][sincn] +
     lut[data[5]][5][sincn];
 }
+#endif
 
+#if LUT_HAS(64)
 int32_t filter_table_mono_64(uint8_t *data, uint8_t sincn) {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -75,7 +93,9 @@ int32_t filter_table_stereo_64(uint8_t *data, uint8_t sincn) {
     lut[data[12]][6][sincn] +
     lut[data[14]][7][sincn];
 }
+#endif
 
+#if LUT_HAS(128)
 int32_t filter_table_mono_128(uint8_t *data, uint8_t sincn) {
   return (int32_t)
     lut[data[0]][0][sincn] +
@@ -115,14 +135,70 @@ int32_t filter_table_stereo_128(uint8_t *data, uint8_t sincn) {
     lut[data[28]][14][sincn] +
     lut[data[30]][15][sincn];
 }
+#endif
+#else
+/* Index of LUT group g in an MSB-first PDM byte stream whose bytes are stride apart. */
+static inline uint16_t lut_index(uint8_t *data, uint8_t g, uint8_t stride) {
+#if LUT_BITS == 4
+  uint8_t c = data[(g >> 1) * stride];
+  return (g & 1) ? (c & 0x0F) : (c >> 4);
+#elif LUT_BITS == 12
+  uint8_t *p = data + (g >> 1) * 3 * stride;
+  return (g & 1) ? (((p[stride] & 0x0F) << 8) | p[2 * stride]) : ((p[0] << 4) | (p[stride] >> 4));
+#else
+  return (data[2 * g * stride] << 8) | data[(2 * g + 1) * stride];
+#endif
+}
+
+static int32_t filter_table_lut(uint8_t *data, uint8_t sincn, uint8_t decimation, uint8_t stride) {
+  int32_t F = 0;
+  uint8_t g;
+
+  for (g = 0; g < decimation / LUT_BITS; g++)
+    F += lut[lut_index(data, g, stride)][g][sincn];
+  return F;
+}
+
+#if LUT_HAS(48)
+int32_t filter_table_mono_48(uint8_t *data, uint8_t sincn) {
+  return filter_table_lut(data, sincn, 48, 1);
+}
+#endif
+
+#if LUT_HAS(64)
+int32_t filter_table_mono_64(uint8_t *data, uint8_t sincn) {
+  return filter_table_lut(data, sincn, 64, 1);
+}
+
+int32_t filter_table_stereo_64(uint8_t *data, uint8_t sincn) {
+  return filter_table_lut(data, sincn, 64, 2);
+}
+#endif
+
+#if LUT_HAS(128)
+int32_t filter_table_mono_128(uint8_t *data, uint8_t sincn) {
+  return filter_table_lut(data, sincn, 128, 1);
+}
+
+int32_t filter_table_stereo_128(uint8_t *data, uint8_t sincn) {
+  return filter_table_lut(data, sincn, 128, 2);
+}
+#endif
+#endif
+#if LUT_HAS(64)
 int32_t (* filter_tables_64[2]) (uint8_t *data, uint8_t sincn) = {filter_table_mono_64, filter_table_stereo_64};
+#endif
+#if LUT_HAS(128)
 int32_t (* filter_tables_128[2]) (uint8_t *data, uint8_t sincn) = {filter_table_mono_128, filter_table_stereo_128};
-#else
+#endif
+#endif
+
+/* Without a matching Look-Up Table the filters compute the sums bit by bit. */
 
 int32_t filter_table(uint8_t *data, uint8_t sincn, TPDMFilter_InitStruct *param) {
   uint8_t c, i;
   uint16_t data_index = 0;
-  uint32_t *coef_p = &coef[sincn][0];
+  uint32_t *coef_p = &param->coef[sincn][0];
   int32_t F = 0;
   uint8_t decimation = param->Decimation;
   uint8_t channels = param->In_MicChannels;
@@ -141,7 +217,6 @@ int32_t filter_table(uint8_t *data, uint8_t sincn, TPDMFilter_InitStruct *param)
   }
   return F;
 }
-#endif
  
 void convolve(uint32_t Signal[/* SignalLen */], unsigned short SignalLen,
               uint32_t Kernel[/* KernelLen */], unsigned short KernelLen,
@@ -197,21 +272,20 @@ void Open_PDM_Filter_Init(TPDMFilter_InitStruct *Filter) {
   Filter->div_const = Filter->sub_const * Filter->MaxVolume / 32768 / FILTER_GAIN;
   Filter->div_const = (Filter->div_const == 0 ? 1 : Filter->div_const);
  
-#ifdef USE_LUT
+#if defined(USE_LUT) && !defined(LUT_PRECOMPUTED)
   /* Look-Up Table. */
-  uint16_t c, d, s;
+  uint32_t c;
+  uint16_t d, s, k;
+  if (decimation > LUT_DECIMATION)
+    return;
   for (s = 0; s < SINCN; s++) {
     uint32_t *coef_p = &Filter->coef[s][0];
-    for (c = 0; c < 256; c++)
-      for (d = 0; d < decimation / 8; d++)
-        lut[c][d][s] = ((c >> 7)       ) * coef_p[d * 8    ] +
-                       ((c >> 6) & 0x01) * coef_p[d * 8 + 1] +
-                       ((c >> 5) & 0x01) * coef_p[d * 8 + 2] +
-                       ((c >> 4) & 0x01) * coef_p[d * 8 + 3] +
-                       ((c >> 3) & 0x01) * coef_p[d * 8 + 4] +
-                       ((c >> 2) & 0x01) * coef_p[d * 8 + 5] +
-                       ((c >> 1) & 0x01) * coef_p[d * 8 + 6] +
-                       ((c     ) & 0x01) * coef_p[d * 8 + 7];
+    for (c = 0; c < LUT_SIZE; c++)
+      for (d = 0; d < decimation / LUT_BITS; d++) {
+        lut[c][d][s] = 0;
+        for (k = 0; k < LUT_BITS; k++)
+          lut[c][d][s] += ((c >> (LUT_BITS - 1 - k)) & 0x01) * coef_p[d * LUT_BITS + k];
+      }
   }
 #endif
 }
@@ -228,7 +302,7 @@ void Open_PDM_Filter_48(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMF
   OldZ = Filter->OldZ;
 
   for (i = 0, data_out_index = 0; i < Filter->Fs / 1000; i++, data_out_index += channels) {
-#ifdef USE_LUT
+#if defined(USE_LUT) && LUT_HAS(48)
     Z0 = filter_table_mono_48(data, 0);
     Z1 = filter_table_mono_48(data, 1);
     Z2 = filter_table_mono_48(data, 2);
@@ -272,12 +346,12 @@ void Open_PDM_Filter_64(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDMF
   OldIn = Filter->OldIn;
   OldZ = Filter->OldZ;
 
-#ifdef USE_LUT
+#if defined(USE_LUT) && LUT_HAS(64)
   uint8_t j = channels - 1;
 #endif
 
   for (i = 0, data_out_index = 0; i < Filter->Fs / 1000; i++, data_out_index += channels) {
-#ifdef USE_LUT
+#if defined(USE_LUT) && LUT_HAS(64)
     Z0 = filter_tables_64[j](data, 0);
     Z1 = filter_tables_64[j](data, 1);
     Z2 = filter_tables_64[j](data, 2);
@@ -321,12 +395,12 @@ void Open_PDM_Filter_128(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDM
   OldIn = Filter->OldIn;
   OldZ = Filter->OldZ;
 
-#ifdef USE_LUT
+#if defined(USE_LUT) && LUT_HAS(128)
   uint8_t j = channels - 1;
 #endif
 
   for (i = 0, data_out_index = 0; i < Filter->Fs / 1000; i++, data_out_index += channels) {
-#ifdef USE_LUT
+#if defined(USE_LUT) && LUT_HAS(128)
     Z0 = filter_tables_128[j](data, 0);
     Z1 = filter_tables_128[j](data, 1);
     Z2 = filter_tables_128[j](data, 2);
@@ -356,3 +430,436 @@ void Open_PDM_Filter_128(uint8_t* data, uint16_t* dataOut, uint16_t volume, TPDM
   Filter->OldIn = OldIn;
   Filter->OldZ = OldZ;
 }
+
+uint8_t pdm_deinterleave_2[256];
+uint8_t pdm_deinterleave_4[256];
+
+void Open_PDM_Deinterleave_Init(void) {
+  uint16_t c, k;
+
+  for (c = 0; c < 256; c++) {
+    uint32_t w2 = 0, w4 = 0;
+    for (k = 0; k < 8; k++) {
+      if (c & (1 << k)) {
+        w2 |= 1u << (2 * k);
+        w4 |= 1u << (4 * k);
+      }
+    }
+    pdm_deinterleave_2[pdm_fold_bits2(w2, 0)] = c;
+    pdm_deinterleave_4[pdm_fold_bits4(w4, 0)] = c;
+  }
+}
+
+#ifdef USE_LUT
+/*
+ * Coefficient n (0 <= n < SINCN * decimation) of the sinc^3 kernel, i.e. the
+ * value that convolve() leaves in sinc[n] in Open_PDM_Filter_Init(). Closed
+ * form of a box filter convolved with itself three times, so the filter bank
+ * needs neither the sinc/sinc1/sinc2/coef scratch arrays nor the O(n^2)
+ * convolution.
+ */
+static uint32_t sinc_coef(uint16_t n, uint8_t decimation) {
+  uint32_t D = decimation;
+  uint32_t m;
+
+  if (n == 0 || n >= SINCN * D - 1)
+    return 0;
+
+  m = n - 1;
+  if (m < D)
+    return (m + 1) * (m + 2) / 2;
+  if (m < 2 * D)
+    return (m + 1) * (m + 2) / 2 - 3 * (m - D + 1) * (m - D + 2) / 2;
+  return (3 * D - 2 - m) * (3 * D - 1 - m) / 2;
+}
+
+void Open_PDM_FilterBank_Init(TPDMFilterBank_InitStruct *Bank) {
+  uint16_t i;
+  int64_t sum = 0;
+  uint8_t decimation = Bank->Decimation;
+
+  for (i = 0; i < FILTER_BANK_CHANNELS_MAX; i++) {
+    Bank->State[i].Coef[0] = Bank->State[i].Coef[1] = 0;
+    Bank->State[i].OldOut = Bank->State[i].OldIn = Bank->State[i].OldZ = 0;
+  }
+#ifdef FILTER_BANK_FIXED32
+  Bank->vol_mult = 0;
+#endif
+  Bank->div_const32 = 0;
+
+  Bank->LP_ALFA = (Bank->LP_HZ != 0 ? (uint16_t) (Bank->LP_HZ * 256 / (Bank->LP_HZ + Bank->Fs / (2 * 3.14159))) : 0);
+  Bank->HP_ALFA = (Bank->HP_HZ != 0 ? (uint16_t) (Bank->Fs * 256 / (2 * 3.14159 * Bank->HP_HZ + Bank->Fs)) : 0);
+
+  for (i = 0; i < decimation * SINCN; i++)
+    sum += sinc_coef(i, decimation);
+
+  Bank->sub_const = sum >> 1;
+  Bank->div_const = Bank->sub_const * Bank->MaxVolume / 32768 / Bank->Gain;
+  Bank->div_const = (Bank->div_const == 0 ? 1 : Bank->div_const);
+
+  Open_PDM_Deinterleave_Init();
+
+#ifndef LUT_PRECOMPUTED
+  /*
+   * One Look-Up Table for every channel of the bank. Each entry is the entry
+   * without its lowest set bit plus that bit's coefficient.
+   */
+  if (decimation <= LUT_DECIMATION) {
+    uint32_t c;
+    uint16_t s, d, k;
+
+    for (s = 0; s < SINCN; s++)
+      for (d = 0; d < decimation / LUT_BITS; d++) {
+        lut[0][d][s] = 0;
+        for (c = 1; c < LUT_SIZE; c++) {
+          for (k = 0; !(c & (1u << k)); k++);
+          lut[c][d][s] = lut[c & (c - 1)][d][s] + sinc_coef(s * decimation + d * LUT_BITS + LUT_BITS - 1 - k, decimation);
+        }
+      }
+  }
+#endif
+}
+
+/*
+ * Compares the Look-Up Table with the sinc^3 kernel for the given decimation
+ * (after Open_PDM_FilterBank_Init() when it is built at run time) and returns
+ * the number of entries that differ.
+ */
+uint32_t Open_PDM_FilterBank_CheckLUT(uint8_t decimation) {
+  uint32_t c, errors = 0;
+  uint16_t s, d, k;
+
+  if (decimation > LUT_DECIMATION || decimation % LUT_BITS)
+    return LUT_SIZE;
+#ifdef LUT_PRECOMPUTED
+  if (decimation != LUT_DECIMATION)
+    return LUT_SIZE;
+#endif
+
+  for (s = 0; s < SINCN; s++)
+    for (c = 0; c < LUT_SIZE; c++)
+      for (d = 0; d < decimation / LUT_BITS; d++) {
+        int32_t v = 0;
+        for (k = 0; k < LUT_BITS; k++)
+          if (c & (1u << (LUT_BITS - 1 - k)))
+            v += sinc_coef(s * decimation + d * LUT_BITS + k, decimation);
+        errors += (lut[c][d][s] != v);
+      }
+  return errors;
+}
+
+/*
+ * Bank kernels: compute the three sinc partial sums for one output sample of
+ * channel ch. The mono kernels read de-interleaved bytes, the bits2/bits4
+ * kernels read the raw bit-interleaved PIO words of a 2 or 4 microphone
+ * stream in place.
+ */
+typedef void (*filter_bank_table_t)(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z);
+
+#if LUT_HAS(48)
+static void filter_bank_table_mono_48(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  Z[0] = filter_table_mono_48(data, 0);
+  Z[1] = filter_table_mono_48(data, 1);
+  Z[2] = filter_table_mono_48(data, 2);
+}
+#endif
+
+#if LUT_HAS(64)
+static void filter_bank_table_mono_64(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  Z[0] = filter_table_mono_64(data, 0);
+  Z[1] = filter_table_mono_64(data, 1);
+  Z[2] = filter_table_mono_64(data, 2);
+}
+#endif
+
+#if LUT_HAS(128)
+static void filter_bank_table_mono_128(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  Z[0] = filter_table_mono_128(data, 0);
+  Z[1] = filter_table_mono_128(data, 1);
+  Z[2] = filter_table_mono_128(data, 2);
+}
+#endif
+
+#if LUT_BITS == 8
+/* 2 channels: each 32-bit word holds 16 PDM bits per channel (2 LUT bytes). */
+static void filter_bank_table_bits2(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  uint32_t *words = (uint32_t *)data;
+  int32_t Z0 = 0, Z1 = 0, Z2 = 0;
+  uint8_t d, b;
+
+  for (d = 0; d < decimation / 8; d += 2) {
+    uint32_t w = *words++;
+    b = pdm_deinterleave_2[pdm_fold_bits2(w, ch)];
+    Z0 += lut[b][d][0];
+    Z1 += lut[b][d][1];
+    Z2 += lut[b][d][2];
+    b = pdm_deinterleave_2[pdm_fold_bits2(w >> 16, ch)];
+    Z0 += lut[b][d + 1][0];
+    Z1 += lut[b][d + 1][1];
+    Z2 += lut[b][d + 1][2];
+  }
+  Z[0] = Z0;
+  Z[1] = Z1;
+  Z[2] = Z2;
+}
+
+/* 4 channels: each 32-bit word holds 8 PDM bits per channel (1 LUT byte). */
+static void filter_bank_table_bits4(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  uint32_t *words = (uint32_t *)data;
+  int32_t Z0 = 0, Z1 = 0, Z2 = 0;
+  uint8_t d, b;
+
+  for (d = 0; d < decimation / 8; d++) {
+    b = pdm_deinterleave_4[pdm_fold_bits4(*words++, ch)];
+    Z0 += lut[b][d][0];
+    Z1 += lut[b][d][1];
+    Z2 += lut[b][d][2];
+  }
+  Z[0] = Z0;
+  Z[1] = Z1;
+  Z[2] = Z2;
+}
+
+#else
+/* Other LUT widths: de-interleave one output sample's bytes, then look up. */
+static void filter_bank_table_bits2(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  uint32_t *words = (uint32_t *)data;
+  uint8_t bytes[LUT_DECIMATION / 8];
+  uint8_t d;
+
+  for (d = 0; d < decimation / 8; d += 2) {
+    uint32_t w = *words++;
+    bytes[d] = pdm_deinterleave_2[pdm_fold_bits2(w, ch)];
+    bytes[d + 1] = pdm_deinterleave_2[pdm_fold_bits2(w >> 16, ch)];
+  }
+  Z[0] = filter_table_lut(bytes, 0, decimation, 1);
+  Z[1] = filter_table_lut(bytes, 1, decimation, 1);
+  Z[2] = filter_table_lut(bytes, 2, decimation, 1);
+}
+
+static void filter_bank_table_bits4(uint8_t *data, uint8_t ch, uint8_t decimation, int32_t *Z) {
+  uint32_t *words = (uint32_t *)data;
+  uint8_t bytes[LUT_DECIMATION / 8];
+  uint8_t d;
+
+  for (d = 0; d < decimation / 8; d++)
+    bytes[d] = pdm_deinterleave_4[pdm_fold_bits4(*words++, ch)];
+  Z[0] = filter_table_lut(bytes, 0, decimation, 1);
+  Z[1] = filter_table_lut(bytes, 1, decimation, 1);
+  Z[2] = filter_table_lut(bytes, 2, decimation, 1);
+}
+#endif
+
+#ifdef FILTER_BANK_FIXED32
+/*
+ * Replaces RoundDiv(OldZ * volume, div_const) by a multiply and shift with
+ * a reciprocal computed once per volume change, in unsigned 32 bits. |OldZ|
+ * is first clamped to the smallest magnitude that already saturates the
+ * output, then rounded to a multiple of 2^vol_pre, at most one output LSB,
+ * so that the product fits with a reciprocal of 15 bits or more. The two
+ * roundings are each off by at most 1/2 LSB and together by less than 3/4,
+ * so the output stays within 1 LSB of the division.
+ */
+static void Open_PDM_FilterBank_SetVolume(TPDMFilterBank_InitStruct *Bank, uint16_t volume) {
+  uint16_t v = (volume == 0 ? 1 : volume);
+  uint8_t pre = 0, shift = 31;
+  int64_t limit, mult;
+
+  if (Bank->vol_mult && volume == Bank->volume)
+    return;
+
+  limit = (int64_t) 32701 * Bank->div_const / v + 1;
+  while (((int64_t) v << (pre + 1)) <= Bank->div_const)
+    pre++;
+  do {
+    shift--;
+    mult = (((int64_t) v << (pre + shift)) + Bank->div_const / 2) / Bank->div_const;
+  } while (shift > 1 && ((limit >> pre) + 1) * mult + (1 << (shift - 1)) > UINT32_MAX);
+
+  Bank->volume = volume;
+  Bank->vol_pre = pre;
+  Bank->vol_shift = shift;
+  Bank->vol_limit = limit;
+  Bank->vol_mult = mult;
+}
+#endif
+
+/*
+ * Filters one channel into dataOut (16 bits), or into dataOut32 (Q31, with
+ * the same full scale shifted up by 16 bits) when that is not NULL.
+ */
+static void Open_PDM_FilterBank_Channel(uint8_t* data, uint8_t data_inc, uint8_t ch, uint16_t* dataOut, int32_t* dataOut32,
+                                        uint16_t n_samples, uint16_t volume, TPDMFilterBank_InitStruct *Bank, filter_bank_table_t filter_table) {
+  TPDMFilter_State *State = &Bank->State[ch];
+  uint16_t i;
+  int32_t Zs[SINCN];
+  filter_acc_t Z;
+  filter_acc_t OldOut, OldIn, OldZ;
+  filter_acc_t sub_const = Bank->sub_const;
+#ifdef FILTER_BANK_FIXED32
+  uint32_t vol_limit = Bank->vol_limit;
+  uint32_t vol_mult = Bank->vol_mult;
+  uint8_t vol_pre = Bank->vol_pre;
+  uint32_t vol_pre_round = (1u << vol_pre) >> 1;
+  uint8_t vol_shift = Bank->vol_shift;
+  uint32_t vol_round = 1u << (vol_shift - 1);
+  uint32_t A;
+#endif
+
+  OldOut = State->OldOut;
+  OldIn = State->OldIn;
+  OldZ = State->OldZ;
+
+  for (i = 0; i < n_samples; i++) {
+    filter_table(data, ch, Bank->Decimation, Zs);
+
+    Z = (filter_acc_t) (State->Coef[1] + Zs[2]) - sub_const;
+    State->Coef[1] = State->Coef[0] + Zs[1];
+    State->Coef[0] = Zs[0];
+
+    OldOut = (Bank->HP_ALFA * (OldOut + Z - OldIn)) >> 8;
+    OldIn = Z;
+    OldZ = ((256 - Bank->LP_ALFA) * OldZ + Bank->LP_ALFA * OldOut) >> 8;
+
+    if (dataOut32) {
+      int64_t Z32 = ((int64_t) OldZ * Bank->vol_mult32 + (1 << 15)) >> 16;
+      dataOut32[i] = SaturaLH(Z32, -INT32_MAX, INT32_MAX);
+    } else {
+#ifdef FILTER_BANK_FIXED32
+      A = (OldZ < 0) ? -(uint32_t) OldZ : (uint32_t) OldZ;
+      A = (A > vol_limit) ? vol_limit : A;
+      A = (((A + vol_pre_round) >> vol_pre) * vol_mult + vol_round) >> vol_shift;
+      Z = (OldZ < 0) ? -(int32_t) A : (int32_t) A;
+#else
+      Z = OldZ * volume;
+      Z = RoundDiv(Z, Bank->div_const);
+#endif
+      Z = SaturaLH(Z, -32700, 32700);
+
+      dataOut[i] = Z;
+    }
+    data += data_inc;
+  }
+
+  State->OldOut = OldOut;
+  State->OldIn = OldIn;
+  State->OldZ = OldZ;
+}
+
+static filter_bank_table_t Open_PDM_FilterBank_MonoTable(uint8_t decimation) {
+  if (decimation % LUT_BITS || (LUT_BITS == 12 && decimation % 24))
+    return 0;
+
+  switch (decimation) {
+#if LUT_HAS(48)
+    case 48:  return filter_bank_table_mono_48;
+#endif
+#if LUT_HAS(64)
+    case 64:  return filter_bank_table_mono_64;
+#endif
+#if LUT_HAS(128)
+    case 128: return filter_bank_table_mono_128;
+#endif
+    default:  return 0;
+  }
+}
+
+/*
+ * OldZ * volume / div_const, 16 bits further up; a 64-bit division, so only
+ * when the volume or div_const (i.e. an Init with another Gain or MaxVolume)
+ * changed since the last call.
+ */
+static void Open_PDM_FilterBank_SetVolume32(TPDMFilterBank_InitStruct *Bank, uint16_t volume) {
+  if (Bank->div_const32 == Bank->div_const && volume == Bank->volume32)
+    return;
+
+  Bank->vol_mult32 = (((int64_t) volume << 32) + Bank->div_const / 2) / Bank->div_const;
+  Bank->volume32 = volume;
+  Bank->div_const32 = Bank->div_const;
+}
+
+static void Open_PDM_FilterBank_Planar(uint8_t* data[], uint16_t* dataOut[], int32_t* dataOut32[], uint16_t n_samples,
+                                       uint16_t volume, TPDMFilterBank_InitStruct *Bank) {
+  uint8_t ch;
+  filter_bank_table_t filter_table = Open_PDM_FilterBank_MonoTable(Bank->Decimation);
+
+  if (!filter_table)
+    return;
+
+  if (dataOut32)
+    Open_PDM_FilterBank_SetVolume32(Bank, volume);
+#ifdef FILTER_BANK_FIXED32
+  else
+    Open_PDM_FilterBank_SetVolume(Bank, volume);
+#endif
+
+  for (ch = 0; ch < Bank->Channels; ch++)
+    if ((dataOut && dataOut[ch]) || (dataOut32 && dataOut32[ch]))
+      Open_PDM_FilterBank_Channel(data[ch], Bank->Decimation >> 3, ch, dataOut ? dataOut[ch] : 0, dataOut32 ? dataOut32[ch] : 0,
+                                  n_samples, volume, Bank, filter_table);
+}
+
+static void Open_PDM_FilterBank_Interleaved(uint8_t* data, uint16_t* dataOut[], int32_t* dataOut32[], uint16_t n_samples,
+                                            uint16_t volume, TPDMFilterBank_InitStruct *Bank) {
+  uint8_t ch;
+  uint8_t data_inc = (Bank->Decimation >> 3) * Bank->Channels;
+  filter_bank_table_t filter_table;
+
+  if (!Open_PDM_FilterBank_MonoTable(Bank->Decimation))
+    return;
+
+  switch (Bank->Channels) {
+    case 1:  filter_table = Open_PDM_FilterBank_MonoTable(Bank->Decimation); break;
+    case 2:  filter_table = filter_bank_table_bits2; break;
+    case 4:  filter_table = filter_bank_table_bits4; break;
+    default: return;
+  }
+
+  if (dataOut32)
+    Open_PDM_FilterBank_SetVolume32(Bank, volume);
+#ifdef FILTER_BANK_FIXED32
+  else
+    Open_PDM_FilterBank_SetVolume(Bank, volume);
+#endif
+
+  for (ch = 0; ch < Bank->Channels; ch++)
+    if ((dataOut && dataOut[ch]) || (dataOut32 && dataOut32[ch]))
+      Open_PDM_FilterBank_Channel(data, data_inc, ch, dataOut ? dataOut[ch] : 0, dataOut32 ? dataOut32[ch] : 0,
+                                  n_samples, volume, Bank, filter_table);
+}
+
+/*
+ * Filters n_samples output samples of every channel in the bank. data[ch]
+ * points to that channel's de-interleaved PDM bytes (n_samples * Decimation / 8
+ * of them) and dataOut[ch] receives its PCM samples. The filter state carries
+ * over between calls, so a stream may be split into blocks of any length. A
+ * NULL dataOut[ch] skips channel ch, leaving its state as it was.
+ */
+void Open_PDM_FilterBank_Process(uint8_t* data[], uint16_t* dataOut[], uint16_t n_samples, uint16_t volume, TPDMFilterBank_InitStruct *Bank) {
+  Open_PDM_FilterBank_Planar(data, dataOut, 0, n_samples, volume, Bank);
+}
+
+/*
+ * Same as Open_PDM_FilterBank_Process(), but data is the raw PIO stream with
+ * the bits of Channels (1, 2 or 4) microphones interleaved, as captured by the
+ * pdm_microphone_data_n1/n2/n4 programs. No de-interleaving pass or scratch
+ * buffer is needed; data must be 32-bit aligned for 2 and 4 channels.
+ */
+void Open_PDM_FilterBank_ProcessInterleaved(uint8_t* data, uint16_t* dataOut[], uint16_t n_samples, uint16_t volume, TPDMFilterBank_InitStruct *Bank) {
+  Open_PDM_FilterBank_Interleaved(data, dataOut, 0, n_samples, volume, Bank);
+}
+
+/*
+ * 32-bit variants: dataOut[ch] receives Q31 samples, i.e. the 16-bit output
+ * scaled by 65536 but without dropping the fractional bits of the filter, and
+ * saturated at the int32_t range instead of +/-32700. Take the upper 24 bits
+ * for 24-bit PCM.
+ */
+void Open_PDM_FilterBank_Process32(uint8_t* data[], int32_t* dataOut[], uint16_t n_samples, uint16_t volume, TPDMFilterBank_InitStruct *Bank) {
+  Open_PDM_FilterBank_Planar(data, 0, dataOut, n_samples, volume, Bank);
+}
+
+void Open_PDM_FilterBank_ProcessInterleaved32(uint8_t* data, int32_t* dataOut[], uint16_t n_samples, uint16_t volume, TPDMFilterBank_InitStruct *Bank) {
+  Open_PDM_FilterBank_Interleaved(data, 0, dataOut, n_samples, volume, Bank);
+}
+#endif
@@ -51,8 +51,48 @@
  */
 #define USE_LUT
  
+/*
+ * Number of PDM bits that index one Look-Up Table entry (4, 8, 12 or 16).
+ * Each output sample costs SINCN * (Decimation / LUT_BITS) lookups, while the
+ * table takes 2^LUT_BITS * (LUT_DECIMATION / LUT_BITS) * SINCN entries. The
+ * decimation must be a multiple of LUT_BITS (and of 24 for 12 bits).
+ */
+#ifndef LUT_BITS
+#define LUT_BITS         8
+#endif
+#if LUT_BITS != 4 && LUT_BITS != 8 && LUT_BITS != 12 && LUT_BITS != 16
+#error "Unsupported LUT_BITS value!"
+#endif
+#define LUT_SIZE         (1 << LUT_BITS)
+ 
 #define SINCN            3
 #define DECIMATION_MAX 128
+
+/*
+ * Largest decimation the Look-Up Table is sized for. With LUT_PRECOMPUTED the
+ * table is the generated pdm_lut.h (see pdm_lut_gen.py) and only serves
+ * exactly LUT_DECIMATION; otherwise it is built at init time for any
+ * decimation up to LUT_DECIMATION. Placement of a precomputed table:
+ * LUT_IN_FLASH, LUT_IN_SCRATCH_X, LUT_IN_SCRATCH_Y or (default) RAM.
+ */
+#ifndef LUT_DECIMATION
+#define LUT_DECIMATION   DECIMATION_MAX
+#endif
+#ifdef LUT_PRECOMPUTED
+#define LUT_HAS(d)       (LUT_DECIMATION == (d))
+#else
+#define LUT_HAS(d)       (LUT_DECIMATION >= (d))
+#endif
+
+/*
+ * An entry is the sum of up to LUT_BITS sinc^3 coefficients, each at most
+ * 3 * D^2 / 4, so 16 bits are enough up to decimation 64 with 8-bit lookups.
+ */
+#if LUT_BITS * (3 * LUT_DECIMATION * LUT_DECIMATION / 4 + 1) <= 0xFFFF
+typedef uint16_t lut_entry_t;
+#else
+typedef int32_t lut_entry_t;
+#endif
 #ifdef PICO_BUILD
 #define FILTER_GAIN     Filter->Gain
 #else
@@ -94,7 +134,59 @@ typedef struct {
   uint16_t bit[5];
   uint16_t byte;
 } TPDMFilter_InitStruct;
- 
+
+/*
+ * Filter bank: one shared coefficient set (and LUT) for all channels, plus a
+ * compact per-channel state block. All channels must share the same sample
+ * rate, decimation and volume settings.
+ */
+#define FILTER_BANK_CHANNELS_MAX 4
+
+/*
+ * Enable to run the filter bank on 32-bit state with a reciprocal multiply
+ * instead of a 64-bit multiply and division per sample. Output stays within
+ * 1 LSB of the 64-bit datapath for decimation up to DECIMATION_MAX.
+ */
+/* #define FILTER_BANK_FIXED32 */
+
+#ifdef FILTER_BANK_FIXED32
+typedef int32_t filter_acc_t;
+#else
+typedef int64_t filter_acc_t;
+#endif
+
+typedef struct {
+  uint32_t Coef[SINCN - 1];
+  filter_acc_t OldOut, OldIn, OldZ;
+} TPDMFilter_State;
+
+typedef struct {
+  /* Public */
+  float LP_HZ;
+  float HP_HZ;
+  uint16_t Fs;
+  uint8_t Channels;
+  uint8_t Decimation;
+  uint8_t MaxVolume;
+  uint8_t Gain;
+  /* Private */
+  uint32_t div_const;
+  int64_t sub_const;
+  uint16_t LP_ALFA;
+  uint16_t HP_ALFA;
+#ifdef FILTER_BANK_FIXED32
+  uint16_t volume;
+  uint8_t vol_pre;
+  uint8_t vol_shift;
+  uint32_t vol_limit;
+  uint32_t vol_mult;
+#endif
+  uint16_t volume32;
+  uint32_t div_const32;
+  int64_t vol_mult32;
+  TPDMFilter_State State[FILTER_BANK_CHANNELS_MAX];
+} TPDMFilterBank_InitStruct;
+
  
 /* Exported functions ------------------------------------------------------- */
  
@@ -102,7 +194,39 @@ void Open_PDM_Filter_Init(TPDMFilter_InitStruct *init_struct);
 void Open_PDM_Filter_48(uint8_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
 void Open_PDM_Filter_64(uint8_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
 void Open_PDM_Filter_128(uint8_t* data, uint16_t* data_out, uint16_t mic_gain, TPDMFilter_InitStruct *init_struct);
- 
+
+/*
+ * Raw 2 and 4 microphone PIO words are folded with a couple of shifts so that
+ * the bits of one channel land in one byte (in a scrambled order), which the
+ * pdm_deinterleave_2/4 tables then map back to natural MSB-first order.
+ * pdm_fold_bits2() yields the first 8 of the 16 bits per channel in a word;
+ * shift the word right by 16 for the other 8.
+ */
+extern uint8_t pdm_deinterleave_2[256];
+extern uint8_t pdm_deinterleave_4[256];
+
+static inline uint8_t pdm_fold_bits2(uint32_t w, uint8_t ch) {
+  w = (w >> ch) & 0x55555555;
+  w |= w >> 7;
+  return w & 0xFF;
+}
+
+static inline uint8_t pdm_fold_bits4(uint32_t w, uint8_t ch) {
+  w = (w >> ch) & 0x11111111;
+  w |= w >> 14;
+  w |= w >> 7;
+  return w & 0xFF;
+}
+
+void Open_PDM_Deinterleave_Init(void);
+
+void Open_PDM_FilterBank_Init(TPDMFilterBank_InitStruct *init_struct);
+uint32_t Open_PDM_FilterBank_CheckLUT(uint8_t decimation);
+void Open_PDM_FilterBank_Process(uint8_t* data[], uint16_t* data_out[], uint16_t n_samples, uint16_t mic_gain, TPDMFilterBank_InitStruct *init_struct);
+void Open_PDM_FilterBank_ProcessInterleaved(uint8_t* data, uint16_t* data_out[], uint16_t n_samples, uint16_t mic_gain, TPDMFilterBank_InitStruct *init_struct);
+void Open_PDM_FilterBank_Process32(uint8_t* data[], int32_t* data_out[], uint16_t n_samples, uint16_t mic_gain, TPDMFilterBank_InitStruct *init_struct);
+void Open_PDM_FilterBank_ProcessInterleaved32(uint8_t* data, int32_t* data_out[], uint16_t n_samples, uint16_t mic_gain, TPDMFilterBank_InitStruct *init_struct);
+
 #ifdef __cplusplus
 }
 #endif
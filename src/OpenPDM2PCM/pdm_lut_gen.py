@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+
+# Generates the OpenPDMFilter sinc^3 Look-Up Table for one decimation, as a C
+# initializer that OpenPDMFilter.c includes when LUT_PRECOMPUTED is defined:
+#
+#   pdm_lut_gen.py <decimation> <lut_bits> <output.h>
+#
+# The values must match what Open_PDM_FilterBank_Init() builds at run time,
+# Open_PDM_FilterBank_CheckLUT() compares the two.
+
+import os
+import sys
+
+SINCN = 3
+
+
+# same closed form as sinc_coef() in OpenPDMFilter.c
+def sinc_coef(n, decimation):
+    d = decimation
+    if n == 0 or n >= SINCN * d - 1:
+        return 0
+    m = n - 1
+    if m < d:
+        return (m + 1) * (m + 2) // 2
+    if m < 2 * d:
+        return (m + 1) * (m + 2) // 2 - 3 * (m - d + 1) * (m - d + 2) // 2
+    return (3 * d - 2 - m) * (3 * d - 1 - m) // 2
+
+
+def main():
+    if len(sys.argv) != 4:
+        sys.exit("usage: %s <decimation> <lut_bits> <output.h>" % sys.argv[0])
+
+    decimation = int(sys.argv[1])
+    lut_bits = int(sys.argv[2])
+    output = sys.argv[3]
+
+    if lut_bits not in (4, 8, 12, 16):
+        sys.exit("lut_bits must be 4, 8, 12 or 16")
+    if decimation % lut_bits or (lut_bits == 12 and decimation % 24):
+        sys.exit("decimation %d is not a multiple of the %d-bit LUT" % (decimation, lut_bits))
+
+    groups = decimation // lut_bits
+    rows = []
+    for c in range(1 << lut_bits):
+        cells = []
+        for d in range(groups):
+            v = [0] * SINCN
+            for s in range(SINCN):
+                for k in range(lut_bits):
+                    if c & (1 << (lut_bits - 1 - k)):
+                        v[s] += sinc_coef(s * decimation + d * lut_bits + k, decimation)
+            cells.append("{%s}" % ", ".join(str(x) for x in v))
+        rows.append("  {%s}" % ", ".join(cells))
+
+    text = []
+    text.append("/* Generated by pdm_lut_gen.py %d %d, do not edit. */" % (decimation, lut_bits))
+    text.append("")
+    text.append("#if LUT_DECIMATION != %d || LUT_BITS != %d" % (decimation, lut_bits))
+    text.append("#error \"pdm_lut.h was generated for another LUT_DECIMATION or LUT_BITS\"")
+    text.append("#endif")
+    text.append("")
+    text.append("LUT_STORAGE lut_entry_t lut[LUT_SIZE][LUT_DECIMATION / LUT_BITS][SINCN] = {")
+    text.append(",\n".join(rows))
+    text.append("};")
+    text.append("")
+
+    text = "\n".join(text)
+
+    # leave the file alone when nothing changed, so that reconfiguring does
+    # not rebuild OpenPDMFilter.c
+    if os.path.exists(output):
+        with open(output) as f:
+            if f.read() == text:
+                return
+
+    os.makedirs(os.path.dirname(os.path.abspath(output)), exist_ok=True)
+    with open(output, "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
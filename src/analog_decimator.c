@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <string.h>
+
+#include "pico/types.h"
+
+#include "analog_decimator.h"
+
+#define CIC_ORDER 4
+
+// the PDM decimator's: half-band coefficients (Q14) of the taps at odd
+// distance 1, 3, 5, ... from the center tap, which is 0.5
+static const int16_t hb1_coefs[(ANALOG_DECIMATOR_HB1_TAPS + 1) / 4] = {
+    4892, -952, 159 // ~68 dB stopband from 0.79 (at the input rate of 4 fs)
+};
+static const int16_t hb2_coefs[(ANALOG_DECIMATOR_HB2_TAPS + 1) / 4] = {
+    5180, -1634, 877, -528, 324, -195, 111, -58, 27, -10 // ~68 dB from 0.6 fs
+};
+
+// symmetric CIC droop compensation (Q13), center tap first, for a CIC
+// running at 4 times the output rate
+static const int16_t comp_coefs[(ANALOG_DECIMATOR_COMP_TAPS + 1) / 2] = {
+    8471, -167, 36, -12, 4
+};
+
+int analog_decimator_init(struct analog_decimator* dec, uint8_t channels, uint8_t oversample, int16_t bias, uint32_t sample_rate) {
+    memset(dec, 0x00, sizeof(*dec));
+
+    if (channels < 1 || channels > ANALOG_DECIMATOR_CHANNELS_MAX) {
+        return -1;
+    }
+    // the CIC's gain, r^4, must leave the 32-bit integrators room for the
+    // 16-bit input
+    if (oversample < 4 || oversample > 32 || (oversample & (oversample - 1))) {
+        return -1;
+    }
+
+    dec->channels = channels;
+    dec->oversample = oversample;
+    dec->cic_decimation = oversample / 4;
+    dec->cic_shift = CIC_ORDER * __builtin_ctz(dec->cic_decimation);
+    dec->bias = bias;
+
+    // one pole DC blocker around 10 Hz
+    dec->dc_shift = 1;
+    while (dec->dc_shift < 16 && (sample_rate >> dec->dc_shift) > 63) {
+        dec->dc_shift++;
+    }
+
+    return 0;
+}
+
+void analog_decimator_reset(struct analog_decimator* dec) {
+    memset(dec->channel, 0x00, sizeof(dec->channel));
+}
+
+// appends x to a delay line stored twice in a row, and returns its last taps
+// samples, oldest first, as one contiguous window
+static inline const int32_t* analog_decimator_push(int32_t* line, uint8_t* index, uint8_t taps, int32_t x) {
+    line[*index] = line[*index + taps] = x;
+    if (++(*index) == taps) {
+        *index = 0;
+    }
+
+    return &line[*index];
+}
+
+static inline int32_t analog_decimator_halfband(const int32_t* window, const int16_t* coefs, uint8_t n_coefs) {
+    const int32_t* center = window + 2 * n_coefs - 1;
+    int32_t acc = center[0] * 8192 + 8192;
+
+    for (int i = 0; i < n_coefs; i++) {
+        acc += coefs[i] * (center[-(2 * i + 1)] + center[2 * i + 1]);
+    }
+
+    return acc >> 14;
+}
+
+static inline int32_t analog_decimator_comp(const int32_t* window) {
+    const int32_t* center = window + ANALOG_DECIMATOR_COMP_TAPS / 2;
+    int32_t acc = center[0] * comp_coefs[0] + 4096;
+
+    for (int i = 1; i <= ANALOG_DECIMATOR_COMP_TAPS / 2; i++) {
+        acc += comp_coefs[i] * (center[-i] + center[i]);
+    }
+
+    return acc >> 13;
+}
+
+// one CIC output from the next r conversions of a channel, channels apart,
+// scaled to 16 times the ADC code; the integrators wrap, which the combs undo
+// as long as the output fits
+static inline int32_t analog_decimator_cic(const struct analog_decimator* dec, struct analog_decimator_channel* state, const uint16_t* data) {
+    const uint channels = dec->channels;
+    const int32_t bias = dec->bias;
+    uint32_t i0 = state->integrator[0], i1 = state->integrator[1], i2 = state->integrator[2], i3 = state->integrator[3];
+
+    for (uint k = 0; k < dec->cic_decimation; k++) {
+        i0 += ((int32_t)data[k * channels] - bias) * 16;
+        i1 += i0;
+        i2 += i1;
+        i3 += i2;
+    }
+
+    state->integrator[0] = i0;
+    state->integrator[1] = i1;
+    state->integrator[2] = i2;
+    state->integrator[3] = i3;
+
+    uint32_t y = i3;
+    for (uint s = 0; s < CIC_ORDER; s++) {
+        const uint32_t c = y - state->comb[s];
+
+        state->comb[s] = y;
+        y = c;
+    }
+
+    return ((int32_t)y + ((1 << dec->cic_shift) >> 1)) >> dec->cic_shift;
+}
+
+void analog_decimator_process(struct analog_decimator* dec, const uint16_t* data, int16_t* out[], size_t n_samples) {
+    const uint channels = dec->channels;
+    const uint cic_step = dec->cic_decimation * channels;
+    const uint8_t n_hb1 = sizeof(hb1_coefs) / sizeof(hb1_coefs[0]);
+    const uint8_t n_hb2 = sizeof(hb2_coefs) / sizeof(hb2_coefs[0]);
+
+    for (uint ch = 0; ch < channels; ch++) {
+        struct analog_decimator_channel* state = &dec->channel[ch];
+        const uint16_t* in = data + ch;
+
+        for (size_t i = 0; i < n_samples; i++) {
+            int32_t x[2];
+
+            for (uint m = 0; m < 2; m++) {
+                analog_decimator_push(state->hb1, &state->hb1_index, ANALOG_DECIMATOR_HB1_TAPS, analog_decimator_cic(dec, state, in));
+                x[m] = analog_decimator_halfband(
+                    analog_decimator_push(state->hb1, &state->hb1_index, ANALOG_DECIMATOR_HB1_TAPS, analog_decimator_cic(dec, state, in + cic_step)),
+                    hb1_coefs, n_hb1
+                );
+                in += 2 * cic_step;
+            }
+
+            analog_decimator_push(state->hb2, &state->hb2_index, ANALOG_DECIMATOR_HB2_TAPS, x[0]);
+            int32_t y = analog_decimator_halfband(
+                analog_decimator_push(state->hb2, &state->hb2_index, ANALOG_DECIMATOR_HB2_TAPS, x[1]),
+                hb2_coefs, n_hb2
+            );
+
+            // a CIC of r = 1 passes everything, with no droop to compensate
+            if (dec->cic_decimation > 1) {
+                y = analog_decimator_comp(analog_decimator_push(state->comp, &state->comp_index, ANALOG_DECIMATOR_COMP_TAPS, y));
+            }
+
+            // the bias in volts is only nominal: track what is left of it
+            state->dc += (y * 256 - state->dc) >> dec->dc_shift;
+            y -= state->dc >> 8;
+
+            out[ch][i] = (y < -32768) ? -32768 : (y > 32767) ? 32767 : y;
+        }
+    }
+}
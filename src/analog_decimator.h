@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _ANALOG_DECIMATOR_H_
+#define _ANALOG_DECIMATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Oversampled ADC to PCM decimator:
+//
+//   ADC - bias -> CIC (order 4, / oversample / 4) -> half-band 11 taps, / 2
+//       -> half-band 39 taps, / 2 -> CIC droop compensation (9 taps)
+//       -> DC blocker
+//
+// in one pass per channel over the round robin conversions, the same chain
+// as the PDM decimator's with 2 half-band stages. The output is the ADC code
+// minus the bias, times 16 (with the extra bits the oversampling gains), so
+// that the ADC's range spans the 16-bit range.
+
+#define ANALOG_DECIMATOR_CHANNELS_MAX 4
+#define ANALOG_DECIMATOR_HB1_TAPS     11
+#define ANALOG_DECIMATOR_HB2_TAPS     39
+#define ANALOG_DECIMATOR_COMP_TAPS    9
+
+struct analog_decimator_channel {
+    uint32_t integrator[4];
+    uint32_t comb[4];
+    int32_t hb1[2 * ANALOG_DECIMATOR_HB1_TAPS];
+    int32_t hb2[2 * ANALOG_DECIMATOR_HB2_TAPS];
+    int32_t comp[2 * ANALOG_DECIMATOR_COMP_TAPS];
+    uint8_t hb1_index;
+    uint8_t hb2_index;
+    uint8_t comp_index;
+    int32_t dc;
+};
+
+struct analog_decimator {
+    uint8_t channels;
+    uint8_t oversample;
+    uint8_t cic_decimation;
+    uint8_t cic_shift;
+    uint8_t dc_shift;
+    int16_t bias;
+    struct analog_decimator_channel channel[ANALOG_DECIMATOR_CHANNELS_MAX];
+};
+
+// oversample is 4, 8, 16 or 32, bias the ADC code at 0 V of signal
+int analog_decimator_init(struct analog_decimator* dec, uint8_t channels, uint8_t oversample, int16_t bias, uint32_t sample_rate);
+void analog_decimator_reset(struct analog_decimator* dec);
+
+// data holds n_samples * oversample conversions of each of the channels, in
+// round robin order, and out[ch] receives n_samples PCM samples of channel
+// ch; the filter state carries over between calls
+void analog_decimator_process(struct analog_decimator* dec, const uint16_t* data, int16_t* out[], size_t n_samples);
+
+#endif
@@ -15,75 +15,128 @@
 
 #include "pico/analog_microphone.h"
 
-#define ANALOG_RAW_BUFFER_COUNT 2
+#include "analog_decimator.h"
 
 static struct {
-    struct analog_microphone_config config;
-    int dma_channel;
-    uint16_t* raw_buffer[ANALOG_RAW_BUFFER_COUNT];
-    volatile int raw_buffer_write_index;
-    volatile int raw_buffer_read_index;
-    uint buffer_size;
+    struct analog_microphone_config config; // with the defaults filled in
+    // a fills one DMA block, then chains to b, which writes the next block's
+    // address from the table (read as a ring) to a's write address trigger
+    int dma_channel_a;
+    int dma_channel_b;
+    dma_channel_config dma_channel_a_cfg;
+    dma_channel_config dma_channel_b_cfg;
+    uint16_t* raw_buffer; // raw_buffer_count blocks of sample_buffer_size * oversample * channels conversions, round robin order
+    uint32_t* write_addr_table;
+    void* write_addr_table_alloc;
+    uint block_size; // conversions per DMA block
+    uint oversample; // conversions per channel per sample read
+    struct analog_decimator decimator;
+    // DMA blocks completed (counted by the IRQ) and read, as free-running
+    // sequence numbers
+    volatile uint32_t written;
+    uint32_t read;
+    uint read_offset; // samples per channel already read from the read block
+    uint32_t overruns;
+    uint32_t dropped;
+    bool running;
     int16_t bias;
     uint dma_irq;
     analog_samples_ready_handler_t samples_ready_handler;
-} analog_mic;
+} analog_mic = { .dma_channel_a = -1, .dma_channel_b = -1 };
 
 static void analog_dma_handler();
 
 int analog_microphone_init(const struct analog_microphone_config* config) {
     memset(&analog_mic, 0x00, sizeof(analog_mic));
     memcpy(&analog_mic.config, config, sizeof(analog_mic.config));
+    config = &analog_mic.config;
 
-    if (config->gpio < 26 || config->gpio > 29) {
+    analog_mic.dma_channel_a = -1;
+    analog_mic.dma_channel_b = -1;
+
+    analog_mic.config.channels = config->channels ? config->channels : ANALOG_CHANNELS;
+    analog_mic.config.raw_buffer_count = config->raw_buffer_count ? config->raw_buffer_count : ANALOG_RAW_BUFFER_COUNT;
+
+    const uint channels = config->channels;
+    const uint count = config->raw_buffer_count;
+
+    analog_mic.oversample = config->oversample ? config->oversample : 1;
+
+    if (config->gpio < 26 || config->gpio - 26 + channels > ANALOG_CHANNELS_MAX) {
+        return -1;
+    }
+    if (config->sample_rate == 0 || config->sample_rate * analog_mic.oversample * channels > ANALOG_ADC_RATE_MAX ||
+        config->sample_buffer_size == 0) {
+        return -1;
+    }
+    // the control channel's read ring wraps with the table (at most 2^15 bytes)
+    if (count < 4 || (count & (count - 1)) || count * sizeof(uint32_t) > (1u << 15)) {
         return -1;
     }
 
-    size_t raw_buffer_size = config->sample_buffer_size * sizeof(analog_mic.raw_buffer[0][0]);
-
-    analog_mic.buffer_size = config->sample_buffer_size;
+    analog_mic.block_size = config->sample_buffer_size * analog_mic.oversample * channels;
     analog_mic.bias = ((int16_t)((config->bias_voltage * 4095) / 3.3));
 
-    for (int i = 0; i < ANALOG_RAW_BUFFER_COUNT; i++) {
-        analog_mic.raw_buffer[i] = malloc(raw_buffer_size);
-        if (analog_mic.raw_buffer[i] == NULL) {
-            analog_microphone_deinit();
+    if (analog_mic.oversample > 1 &&
+        analog_decimator_init(&analog_mic.decimator, channels, analog_mic.oversample, analog_mic.bias, config->sample_rate) < 0) {
+        return -1;
+    }
+
+    analog_mic.raw_buffer = malloc(count * analog_mic.block_size * sizeof(analog_mic.raw_buffer[0]));
+    if (analog_mic.raw_buffer == NULL) {
+        analog_microphone_deinit();
 
-            return -1;   
-        }
+        return -1;
     }
 
-    analog_mic.dma_channel = dma_claim_unused_channel(true);
-    if (analog_mic.dma_channel < 0) {
+    // aligned to its size for the ring
+    const uint table_size = count * sizeof(uint32_t);
+
+    analog_mic.write_addr_table_alloc = malloc(2 * table_size);
+    if (analog_mic.write_addr_table_alloc == NULL) {
         analog_microphone_deinit();
 
         return -1;
     }
+    analog_mic.write_addr_table = (uint32_t*)(((uintptr_t)analog_mic.write_addr_table_alloc + table_size - 1) & ~(uintptr_t)(table_size - 1));
 
-    float clk_div = (clock_get_hz(clk_adc) / (1.0 * config->sample_rate)) - 1;
+    for (uint i = 0; i < count; i++) {
+        analog_mic.write_addr_table[i] = (uint32_t)(uintptr_t)(analog_mic.raw_buffer + i * analog_mic.block_size);
+    }
 
-    dma_channel_config dma_channel_cfg = dma_channel_get_default_config(analog_mic.dma_channel);
+    analog_mic.dma_channel_a = dma_claim_unused_channel(false);
+    analog_mic.dma_channel_b = dma_claim_unused_channel(false);
+    if (analog_mic.dma_channel_a < 0 || analog_mic.dma_channel_b < 0) {
+        analog_microphone_deinit();
 
-    channel_config_set_transfer_data_size(&dma_channel_cfg, DMA_SIZE_16);
-    channel_config_set_read_increment(&dma_channel_cfg, false);
-    channel_config_set_write_increment(&dma_channel_cfg, true);
-    channel_config_set_dreq(&dma_channel_cfg, DREQ_ADC);
+        return -1;
+    }
 
-    analog_mic.dma_irq = DMA_IRQ_0;
+    float clk_div = (clock_get_hz(clk_adc) / (1.0 * config->sample_rate * analog_mic.oversample * channels)) - 1;
 
-    dma_channel_configure(
-        analog_mic.dma_channel,
-        &dma_channel_cfg,
-        analog_mic.raw_buffer[0],
-        &adc_hw->fifo,
-        analog_mic.buffer_size,
-        false
-    );
+    dma_channel_config* cfg_a = &analog_mic.dma_channel_a_cfg;
+    dma_channel_config* cfg_b = &analog_mic.dma_channel_b_cfg;
 
-    adc_gpio_init(config->gpio);
+    *cfg_a = dma_channel_get_default_config(analog_mic.dma_channel_a);
+    channel_config_set_transfer_data_size(cfg_a, DMA_SIZE_16);
+    channel_config_set_read_increment(cfg_a, false);
+    channel_config_set_write_increment(cfg_a, true);
+    channel_config_set_dreq(cfg_a, DREQ_ADC);
+    channel_config_set_chain_to(cfg_a, analog_mic.dma_channel_b);
+
+    *cfg_b = dma_channel_get_default_config(analog_mic.dma_channel_b);
+    channel_config_set_transfer_data_size(cfg_b, DMA_SIZE_32);
+    channel_config_set_read_increment(cfg_b, true);
+    channel_config_set_write_increment(cfg_b, false);
+    channel_config_set_ring(cfg_b, false, __builtin_ctz(table_size));
+
+    analog_mic.dma_irq = DMA_IRQ_0;
+
+    for (uint i = 0; i < channels; i++) {
+        adc_gpio_init(config->gpio + i);
+    }
 
     adc_init();
-    adc_select_input(config->gpio - 26);
     adc_fifo_setup(
         true,    // Write each completed conversion to the sample FIFO
         true,    // Enable DMA data request (DREQ)
@@ -93,82 +146,145 @@ int analog_microphone_init(const struct analog_microphone_config* config) {
     );
 
     adc_set_clkdiv(clk_div);
+
+    return 0;
 }
 
 void analog_microphone_deinit() {
-    for (int i = 0; i < ANALOG_RAW_BUFFER_COUNT; i++) {
-        if (analog_mic.raw_buffer[i]) {
-            free(analog_mic.raw_buffer[i]);
+    if (analog_mic.running) {
+        analog_microphone_stop();
+    }
 
-            analog_mic.raw_buffer[i] = NULL;
-        }
+    if (analog_mic.raw_buffer) {
+        free(analog_mic.raw_buffer);
+
+        analog_mic.raw_buffer = NULL;
+    }
+
+    if (analog_mic.write_addr_table_alloc) {
+        free(analog_mic.write_addr_table_alloc);
+
+        analog_mic.write_addr_table_alloc = NULL;
+        analog_mic.write_addr_table = NULL;
+    }
+
+    if (analog_mic.dma_channel_a > -1) {
+        dma_channel_unclaim(analog_mic.dma_channel_a);
+
+        analog_mic.dma_channel_a = -1;
     }
 
-    if (analog_mic.dma_channel > -1) {
-        dma_channel_unclaim(analog_mic.dma_channel);
+    if (analog_mic.dma_channel_b > -1) {
+        dma_channel_unclaim(analog_mic.dma_channel_b);
 
-        analog_mic.dma_channel = -1;
+        analog_mic.dma_channel_b = -1;
     }
 }
 
 int analog_microphone_start() {
-    irq_set_enabled(analog_mic.dma_irq, true);
-    irq_set_exclusive_handler(analog_mic.dma_irq, analog_dma_handler);
+    if (analog_mic.running) {
+        return 0;
+    }
 
     if (analog_mic.dma_irq == DMA_IRQ_0) {
-        dma_channel_set_irq0_enabled(analog_mic.dma_channel, true);
+        dma_channel_set_irq0_enabled(analog_mic.dma_channel_a, true);
     } else if (analog_mic.dma_irq == DMA_IRQ_1) {
-        dma_channel_set_irq1_enabled(analog_mic.dma_channel, true);
+        dma_channel_set_irq1_enabled(analog_mic.dma_channel_a, true);
     } else {
         return -1;
     }
 
-    analog_mic.raw_buffer_write_index = 0;
-    analog_mic.raw_buffer_read_index = 0;
+    // shared with the PDM driver's handler, if both are in use
+    irq_add_shared_handler(analog_mic.dma_irq, analog_dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(analog_mic.dma_irq, true);
+
+    analog_mic.written = 0;
+    analog_mic.read = 0;
+    analog_mic.read_offset = 0;
+    analog_mic.overruns = 0;
+    analog_mic.dropped = 0;
+    analog_mic.running = true;
+
+    analog_decimator_reset(&analog_mic.decimator);
 
-    dma_channel_transfer_to_buffer_now(
-        analog_mic.dma_channel,
-        analog_mic.raw_buffer[0],
-        analog_mic.buffer_size
+    // a fills block 0 now, then b points it at block 1 and so on
+    dma_channel_configure(
+        analog_mic.dma_channel_b,
+        &analog_mic.dma_channel_b_cfg,
+        &dma_hw->ch[analog_mic.dma_channel_a].al2_write_addr_trig,
+        &analog_mic.write_addr_table[1],
+        1,
+        false
+    );
+    dma_channel_configure(
+        analog_mic.dma_channel_a,
+        &analog_mic.dma_channel_a_cfg,
+        analog_mic.raw_buffer,
+        &adc_hw->fifo,
+        analog_mic.block_size,
+        true
     );
 
+    // round robin from the first input, so every block starts with channel 0
+    adc_select_input(analog_mic.config.gpio - 26);
+    adc_set_round_robin((analog_mic.config.channels > 1) ? ((1u << analog_mic.config.channels) - 1) << (analog_mic.config.gpio - 26) : 0);
+    adc_fifo_drain();
+
     adc_run(true); // start running the adc
+
+    return 0;
 }
 
 void analog_microphone_stop() {
+    if (!analog_mic.running) {
+        return;
+    }
+
     adc_run(false); // stop running the adc
 
-    dma_channel_abort(analog_mic.dma_channel);
+    dma_channel_config cfg_a = analog_mic.dma_channel_a_cfg;
+
+    // unchain first, so that aborting a cannot restart it through b
+    channel_config_set_chain_to(&cfg_a, analog_mic.dma_channel_a);
+    dma_channel_abort(analog_mic.dma_channel_b);
+    dma_channel_set_config(analog_mic.dma_channel_a, &cfg_a, false);
+    dma_channel_abort(analog_mic.dma_channel_a);
+    dma_channel_abort(analog_mic.dma_channel_b);
 
     if (analog_mic.dma_irq == DMA_IRQ_0) {
-        dma_channel_set_irq0_enabled(analog_mic.dma_channel, false);
+        dma_channel_set_irq0_enabled(analog_mic.dma_channel_a, false);
+        dma_hw->ints0 = (1u << analog_mic.dma_channel_a);
     } else if (analog_mic.dma_irq == DMA_IRQ_1) {
-        dma_channel_set_irq1_enabled(analog_mic.dma_channel, false);
+        dma_channel_set_irq1_enabled(analog_mic.dma_channel_a, false);
+        dma_hw->ints1 = (1u << analog_mic.dma_channel_a);
     }
 
-    irq_set_enabled(analog_mic.dma_irq, false);
+    irq_remove_handler(analog_mic.dma_irq, analog_dma_handler);
+
+    adc_set_round_robin(0);
+    adc_fifo_drain();
+
+    analog_mic.running = false;
 }
 
 static void analog_dma_handler() {
-    // clear IRQ
+    const uint32_t mask = (1u << analog_mic.dma_channel_a);
+
+    // the IRQ may be another DMA channel's
     if (analog_mic.dma_irq == DMA_IRQ_0) {
-        dma_hw->ints0 = (1u << analog_mic.dma_channel);
+        if (!(dma_hw->ints0 & mask)) {
+            return;
+        }
+        dma_hw->ints0 = mask;
     } else if (analog_mic.dma_irq == DMA_IRQ_1) {
-        dma_hw->ints1 = (1u << analog_mic.dma_channel);
+        if (!(dma_hw->ints1 & mask)) {
+            return;
+        }
+        dma_hw->ints1 = mask;
     }
 
-    // get the current buffer index
-    analog_mic.raw_buffer_read_index = analog_mic.raw_buffer_write_index;
-
-    // get the next capture index to send the dma to start
-    analog_mic.raw_buffer_write_index = (analog_mic.raw_buffer_write_index + 1) % ANALOG_RAW_BUFFER_COUNT;
-
-    // give the channel a new buffer to write to and re-trigger it
-    dma_channel_transfer_to_buffer_now(
-        analog_mic.dma_channel,
-        analog_mic.raw_buffer[analog_mic.raw_buffer_write_index],
-        analog_mic.buffer_size
-    );
+    // b has already pointed a at the next block; this one is complete
+    analog_mic.written++;
 
     if (analog_mic.samples_ready_handler) {
         analog_mic.samples_ready_handler();
@@ -179,24 +295,72 @@ void analog_microphone_set_samples_ready_handler(analog_samples_ready_handler_t
     analog_mic.samples_ready_handler = handler;
 }
 
+void analog_microphone_get_stats(struct analog_microphone_stats* stats) {
+    stats->blocks_written = analog_mic.written;
+    stats->blocks_read = analog_mic.read;
+    stats->overruns = analog_mic.overruns;
+    stats->blocks_dropped = analog_mic.dropped;
+}
+
 int analog_microphone_read(int16_t* buffer, size_t samples) {
-    if (samples > analog_mic.config.sample_buffer_size) {
-        samples = analog_mic.config.sample_buffer_size;
-    }
+    const uint channels = analog_mic.config.channels;
+    const uint count = analog_mic.config.raw_buffer_count;
+    const int16_t bias = analog_mic.bias;
+    size_t done = 0;
+
+    while (done < samples) {
+        const uint32_t written = analog_mic.written;
+
+        // the DMA is writing block written (and the IRQ may not have counted
+        // the one before yet), so the reader lost the blocks it lapped:
+        // restart half a ring behind
+        if (written - analog_mic.read > count - 2) {
+            const uint32_t read = written - count / 2;
+
+            analog_mic.overruns++;
+            analog_mic.dropped += read - analog_mic.read;
+            analog_mic.read = read;
+            analog_mic.read_offset = 0;
+        }
 
-    if (analog_mic.raw_buffer_write_index == analog_mic.raw_buffer_read_index) {
-        return 0;
-    }
+        if (written == analog_mic.read) {
+            break;
+        }
+
+        size_t chunk = analog_mic.config.sample_buffer_size - analog_mic.read_offset;
+        if (chunk > samples - done) {
+            chunk = samples - done;
+        }
+
+        // de-interleave (and decimate) the round robin conversions, channel j to buffer + j*samples
+        const uint16_t* in = analog_mic.raw_buffer + (analog_mic.read % count) * analog_mic.block_size +
+                             analog_mic.read_offset * analog_mic.oversample * channels;
 
-    uint16_t* in = analog_mic.raw_buffer[analog_mic.raw_buffer_read_index];
-    int16_t* out = buffer;
-    int16_t bias = analog_mic.bias;
+        if (analog_mic.oversample > 1) {
+            int16_t* out[ANALOG_CHANNELS_MAX];
 
-    analog_mic.raw_buffer_read_index++;
+            for (uint j = 0; j < channels; j++) {
+                out[j] = buffer + j * samples + done;
+            }
 
-    for (int i = 0; i < samples; i++) {
-        *out++ = *in++ - bias;
+            analog_decimator_process(&analog_mic.decimator, in, out, chunk);
+        } else {
+            for (uint j = 0; j < channels; j++) {
+                int16_t* out = buffer + j * samples + done;
+
+                for (size_t i = 0; i < chunk; i++) {
+                    out[i] = in[i * channels + j] - bias;
+                }
+            }
+        }
+
+        done += chunk;
+        analog_mic.read_offset += chunk;
+        if (analog_mic.read_offset == analog_mic.config.sample_buffer_size) {
+            analog_mic.read_offset = 0;
+            analog_mic.read++;
+        }
     }
 
-    return samples;
+    return done;
 }
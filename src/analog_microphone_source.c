@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "pico/analog_microphone.h"
+
+static uint32_t analog_microphone_source_underruns;
+static bool analog_microphone_source_primed;
+
+static int analog_microphone_source_start(struct audio_source* source) {
+    (void)source;
+
+    analog_microphone_source_underruns = 0;
+    analog_microphone_source_primed = false;
+
+    return analog_microphone_start();
+}
+
+static void analog_microphone_source_stop(struct audio_source* source) {
+    (void)source;
+
+    analog_microphone_stop();
+}
+
+// reads nothing until a read's worth of DMA blocks and one more are there, then
+// stays that block behind the DMA: reads as often as the blocks come (e.g. a
+// USB frame of 4 blocks every 4 blocks) then find all they ask for, however
+// the two line up; after an underrun, the cushion builds up again
+static int analog_microphone_source_read(struct audio_source* source, int16_t* buffer, size_t n_samples) {
+    if (!analog_microphone_source_primed) {
+        struct analog_microphone_stats stats;
+        const uint32_t blocks = (n_samples + source->sample_buffer_size - 1) / source->sample_buffer_size + 1;
+
+        analog_microphone_get_stats(&stats);
+        if (stats.blocks_written - stats.blocks_read < blocks) {
+            return 0;
+        }
+        analog_microphone_source_primed = true;
+    }
+
+    const int n = analog_microphone_read(buffer, n_samples);
+
+    if (n < (int)n_samples) {
+        analog_microphone_source_underruns++;
+        analog_microphone_source_primed = false;
+    }
+
+    return n;
+}
+
+// reads the 16-bit samples into the upper half of buffer, then widens them in
+// place from the front (each 32-bit sample only overwrites 16-bit ones
+// already widened)
+static int analog_microphone_source_read32(struct audio_source* source, int32_t* buffer, size_t n_samples) {
+    const size_t size = source->channels * n_samples;
+    const int16_t* in = (const int16_t*)buffer + size;
+    const int n = analog_microphone_source_read(source, (int16_t*)in, n_samples);
+
+    for (uint j = 0; j < source->channels; j++) {
+        for (int i = 0; i < n; i++) {
+            buffer[j * n_samples + i] = (int32_t)in[j * n_samples + i] << 16;
+        }
+    }
+
+    return n;
+}
+
+static uint32_t analog_microphone_source_latency_us(struct audio_source* source) {
+    struct analog_microphone_stats stats;
+
+    analog_microphone_get_stats(&stats);
+
+    const uint64_t samples = (uint64_t)(stats.blocks_written - stats.blocks_read + 1) * source->sample_buffer_size;
+
+    return (samples * 1000000) / source->sample_rate;
+}
+
+static void analog_microphone_source_get_stats(struct audio_source* source, struct audio_source_stats* stats) {
+    struct analog_microphone_stats analog_stats;
+
+    (void)source;
+    analog_microphone_get_stats(&analog_stats);
+
+    stats->blocks_written = analog_stats.blocks_written;
+    stats->blocks_read = analog_stats.blocks_read;
+    stats->overruns = analog_stats.overruns;
+    stats->underruns = analog_microphone_source_underruns;
+    stats->blocks_dropped = analog_stats.blocks_dropped;
+    stats->blocks_repeated = 0;
+    stats->saturated = 0;
+}
+
+static void analog_microphone_source_deinit(struct audio_source* source) {
+    (void)source;
+
+    analog_microphone_deinit();
+}
+
+static const struct audio_source_ops analog_microphone_source_ops = {
+    .start = analog_microphone_source_start,
+    .stop = analog_microphone_source_stop,
+    .read = analog_microphone_source_read,
+    .read32 = analog_microphone_source_read32,
+    .latency_us = analog_microphone_source_latency_us,
+    .get_stats = analog_microphone_source_get_stats,
+    .deinit = analog_microphone_source_deinit,
+};
+
+int analog_microphone_source_init(struct audio_source* source, const struct analog_microphone_config* config) {
+    if (analog_microphone_init(config) < 0) {
+        return -1;
+    }
+
+    source->ops = &analog_microphone_source_ops;
+    source->context = NULL;
+    source->name = "analog";
+    source->channels = config->channels ? config->channels : ANALOG_CHANNELS;
+    source->sample_rate = config->sample_rate;
+    source->sample_buffer_size = config->sample_buffer_size;
+
+    return 0;
+}
@@ -8,13 +8,36 @@
 #ifndef _PICO_ANALOG_MICROPHONE_H_
 #define _PICO_ANALOG_MICROPHONE_H_
 
+#include "pico/audio_source.h"
+
+#define ANALOG_CHANNELS_MAX 4 // ADC inputs 0 - 3 (GPIO 26 - 29)
+#define ANALOG_ADC_RATE_MAX 500000 // conversions per second, shared by all channels
+
+// defaults for the analog_microphone_config fields left at 0
+#define ANALOG_CHANNELS 1
+#ifndef ANALOG_RAW_BUFFER_COUNT
+#define ANALOG_RAW_BUFFER_COUNT 8 // # of DMA blocks in the ring
+#endif
+
 typedef void (*analog_samples_ready_handler_t)(void);
 
 struct analog_microphone_config {
-    uint gpio;
+    uint gpio; // first ADC input (GPIO 26 - 29)
     float bias_voltage;
-    uint sample_rate;
-    uint sample_buffer_size;
+    uint sample_rate; // per channel
+    uint sample_buffer_size; // samples per channel in each DMA block
+    uint channels; // 1 - 4 mics on consecutive ADC inputs from gpio, converted round robin (0: ANALOG_CHANNELS)
+    uint raw_buffer_count; // DMA blocks in the ring, a power of 2, >= 4 (0: ANALOG_RAW_BUFFER_COUNT)
+    uint oversample; // 0: convert at sample_rate; 4, 8, 16 or 32: convert at oversample * sample_rate and
+                     // decimate (CIC + FIR, removing the DC), reading the ADC code - bias times 16
+};
+
+// DMA block ring accounting since the last start
+struct analog_microphone_stats {
+    uint32_t blocks_written; // DMA blocks completed
+    uint32_t blocks_read; // read position, in DMA blocks
+    uint32_t overruns; // times the DMA caught up with the reader
+    uint32_t blocks_dropped; // DMA blocks skipped to recover from overruns
 };
 
 int analog_microphone_init(const struct analog_microphone_config* config);
@@ -25,6 +48,18 @@ void analog_microphone_stop();
 
 void analog_microphone_set_samples_ready_handler(analog_samples_ready_handler_t handler);
 
+void analog_microphone_get_stats(struct analog_microphone_stats* stats);
+
+// returns the # of samples per channel read from the completed DMA blocks, at
+// most samples (0 if none completed since the last read); channel j starts at
+// buffer + j * samples
 int analog_microphone_read(int16_t* buffer, size_t samples);
 
+// an audio source (see audio_source.h) on the analog microphones, which
+// audio_source_deinit() deinitializes; reads return 0 samples until the ADC
+// completed a read's worth of DMA blocks and one more (again after an
+// underrun), and reads that find fewer samples than asked for count as
+// underruns
+int analog_microphone_source_init(struct audio_source* source, const struct analog_microphone_config* config);
+
 #endif
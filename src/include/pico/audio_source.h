@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PICO_AUDIO_SOURCE_H_
+#define _PICO_AUDIO_SOURCE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/types.h"
+
+// Common interface of the capture sources, so that a consumer (e.g. the
+// usb_microphone example) streams from a PDM group, the analog microphones or
+// the synthetic generator alike. Each source has its own init function taking
+// its own config (pdm_microphone_source_init(), analog_microphone_source_init(),
+// synth_source_init()); everything after that goes through the calls below.
+//
+// Reads are planar as in pdm_microphone_read(): channel j starts at
+// buffer + j * n_samples, and they return the # of samples per channel read.
+
+// since the last start, in blocks of sample_buffer_size samples per channel
+struct audio_source_stats {
+    uint32_t blocks_written; // blocks captured (or generated)
+    uint32_t blocks_read; // read position, in blocks
+    uint32_t overruns; // times the capture caught up with the reader
+    uint32_t underruns; // times the reader caught up with the capture
+    uint32_t blocks_dropped; // blocks skipped to recover from overruns
+    uint32_t blocks_repeated; // blocks replayed to recover from underruns
+    uint32_t saturated; // samples clipped at full scale (0 where not tracked)
+};
+
+struct audio_source;
+
+struct audio_source_ops {
+    int (*start)(struct audio_source* source);
+    void (*stop)(struct audio_source* source);
+    int (*read)(struct audio_source* source, int16_t* buffer, size_t n_samples);
+    int (*read32)(struct audio_source* source, int32_t* buffer, size_t n_samples); // Q31
+    uint32_t (*latency_us)(struct audio_source* source);
+    void (*get_stats)(struct audio_source* source, struct audio_source_stats* stats);
+    void (*deinit)(struct audio_source* source);
+};
+
+struct audio_source {
+    const struct audio_source_ops* ops;
+    void* context; // the source's own state
+    const char* name;
+    uint channels;
+    uint sample_rate;
+    uint sample_buffer_size;
+};
+
+static inline int audio_source_start(struct audio_source* source) {
+    return source->ops->start(source);
+}
+
+static inline void audio_source_stop(struct audio_source* source) {
+    source->ops->stop(source);
+}
+
+static inline int audio_source_read(struct audio_source* source, int16_t* buffer, size_t n_samples) {
+    return source->ops->read(source, buffer, n_samples);
+}
+
+static inline int audio_source_read32(struct audio_source* source, int32_t* buffer, size_t n_samples) {
+    return source->ops->read32(source, buffer, n_samples);
+}
+
+// how far the next read trails the capture: the samples buffered ahead of it
+// plus the block being captured, in microseconds (to within a block)
+static inline uint32_t audio_source_latency_us(struct audio_source* source) {
+    return source->ops->latency_us(source);
+}
+
+static inline void audio_source_get_stats(struct audio_source* source, struct audio_source_stats* stats) {
+    source->ops->get_stats(source, stats);
+}
+
+// stops the source if running and releases it
+static inline void audio_source_deinit(struct audio_source* source) {
+    source->ops->deinit(source);
+}
+
+#endif
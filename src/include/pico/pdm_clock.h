@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PICO_PDM_CLOCK_H_
+#define _PICO_PDM_CLOCK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// PDM clock planning: picks a clk_sys the RP2040 PLL can produce, and per
+// output sample rate a decimation and PIO clock divider, such that the PDM
+// clock is as exact and jitter-free as possible. Independent of the SDK, so it
+// also builds on the host (see tools/pdm_clock_planner.c).
+//
+//   PDM clock   = clk_sys / (clkdiv * cycles_per_bit)
+//   sample rate = PDM clock / decimation
+//
+// A fractional PIO divider stretches some PIO cycles by one clk_sys period,
+// which shows up as that much peak-to-peak jitter on the PDM clock edges.
+
+#define PDM_CLOCK_XOSC_KHZ   12000
+#define PDM_CLOCK_RATES_MAX  8
+
+struct pdm_clock_request {
+    const uint32_t* sample_rates;   // output rates that must all work from one clk_sys
+    uint8_t n_sample_rates;
+    const uint8_t* decimations;     // allowed decimations, e.g. {48, 64, 128}
+    uint8_t n_decimations;
+    uint8_t cycles_per_bit;         // PIO cycles per PDM bit of the capture program
+    uint32_t sys_clock_min_khz;     // e.g. what the application needs
+    uint32_t sys_clock_max_khz;
+    uint32_t pdm_clock_min_hz;      // microphone limits, e.g. 1000000 - 4800000
+    uint32_t pdm_clock_max_hz;
+    double tolerance_ppm;           // rate error that is as good as exact
+};
+
+struct pdm_clock_config {
+    uint32_t sample_rate;           // requested
+    uint8_t decimation;
+    uint16_t clkdiv_int;
+    uint8_t clkdiv_frac;            // 1/256ths
+    uint32_t pdm_clock_hz;          // achieved, rounded
+    double achieved_rate;
+    double rate_error_ppm;
+    double jitter_ns;               // peak-to-peak on the PDM clock, 0 with an integer divider
+};
+
+struct pdm_clock_plan {
+    uint32_t sys_clock_khz;         // for set_sys_clock_khz()
+    uint8_t n_configs;
+    struct pdm_clock_config config[PDM_CLOCK_RATES_MAX];
+};
+
+// PIO divider for one rate at a given clk_sys, rounded to 1/256; false if it
+// is out of the divider's range
+bool pdm_clock_divider(uint32_t sys_clock_hz, uint32_t sample_rate, uint8_t decimation, uint8_t cycles_per_bit,
+                       struct pdm_clock_config* config);
+
+bool pdm_clock_sys_clock_valid(uint32_t sys_clock_khz);
+
+// best plan: fewest rates off by more than tolerance_ppm; when all are within,
+// fewest rates with jitter; then smallest rate error, then the lowest clk_sys.
+// Returns -1 if no clk_sys in range works for every rate.
+int pdm_clock_plan(const struct pdm_clock_request* request, struct pdm_clock_plan* plan);
+
+#endif
@@ -10,13 +10,97 @@
 
 #include "hardware/pio.h"
 
+#include "pico/audio_source.h"
+#include "pico/pdm_clock.h"
+
+// where reads without resample restart after skipping raw buffers; resample
+// follows the reader's rate instead and ignores it
 #define USB_IS_SLOWER true // this seems to be the preference, but if unsure, leave undefined!
-#define N_CHANNELS 1 // # of channels to process (will register as 4-channel device regardless)
+#define PDM_CHANNELS_MAX 4 // # of channels one microphone group can process (1, 2 or 4)
+
+// defaults for the pdm_microphone_config fields left at 0
+#define PDM_CHANNELS         1 // # of channels to process (will register as 4-channel device regardless)
+#ifndef PDM_DECIMATION
 #define PDM_DECIMATION       48 // # of PDM samples per PCM samples
-#define PDM_RAW_BUFFER_COUNT 64 // # of buffer sections (> 16 to avoid frequent pops)
+#endif
+#ifndef PDM_RAW_BUFFER_COUNT
+#define PDM_RAW_BUFFER_COUNT 64 // # of buffer sections (> 16 to avoid frequent pops, 8 is enough with resample)
+#endif
+#ifndef PDM_PCM_BUFFER_COUNT
+#define PDM_PCM_BUFFER_COUNT 8 // # of PCM frames filtered ahead of the reader when eager (>= 8 with resample)
+#endif
+#ifndef PDM_GATE_HOLD
+#define PDM_GATE_HOLD        16 // # of quiet raw buffers in a row before the activity gate skips a channel
+#endif
+
+// one DMA channel pair each (at least), so at most 6 groups of up to 4 mics
+#define PDM_MICROPHONE_INSTANCES_MAX (NUM_DMA_CHANNELS / 2)
 
 typedef void (*pdm_samples_ready_handler_t)(void);
 
+// what a read does when it catches up with the DMA (without resample)
+enum pdm_microphone_read_mode {
+    PDM_MICROPHONE_READ_REPEAT = 0, // never waits: steps back and replays raw buffers (silence before the first)
+    PDM_MICROPHONE_READ_NONBLOCKING, // returns only the samples already captured
+    PDM_MICROPHONE_READ_BLOCKING, // waits for the DMA (not from a samples ready handler)
+};
+
+// where the PDM to PCM filtering runs
+enum pdm_microphone_placement {
+    PDM_MICROPHONE_PLACEMENT_READ = 0, // lazily, in the read calls, straight from the raw buffers
+    PDM_MICROPHONE_PLACEMENT_IRQ, // eagerly, in the DMA IRQ, into a ring of PCM frames reads copy from (not free running)
+    PDM_MICROPHONE_PLACEMENT_CORE1, // eagerly, on core1 (taking it over, needs pico_multicore), into the same ring
+};
+
+// measured since the last start (or pdm_microphone_reset_timing())
+struct pdm_microphone_timing {
+    uint32_t read_max_us; // longest read call
+    uint32_t process_max_us; // longest filtering burst: a read call, an IRQ or a core1 pass, by placement
+    uint32_t latency_min_us; // from a raw buffer's completion to the read returning its last samples
+    uint32_t latency_max_us;
+};
+
+// latched when the DMA completes a raw buffer, carried over to its PCM frame
+struct pdm_microphone_block_info {
+    uint64_t sample; // capture position of the block's first sample per channel, counted from the start
+    uint64_t time_us; // time_us_64() at completion (at the poll that found it, when free running)
+};
+
+// where a read's samples came from
+struct pdm_microphone_read_info {
+    uint64_t sample; // capture position of the first sample read (with resample: the first input sample)
+    uint64_t time_us; // completion time of the raw buffer holding it
+    bool discontinuous; // the samples do not continue the previous read's: blocks were skipped or
+                        // repeated in between or within, or none were captured yet (silence)
+};
+
+// raw buffer ring accounting since the last start
+struct pdm_microphone_ring_stats {
+    uint32_t blocks_written; // raw buffers the DMA completed on all lanes
+    uint32_t blocks_read; // read position, in raw buffers
+    uint32_t overruns; // times the DMA caught up with the reader
+    uint32_t underruns; // times the reader caught up with the DMA
+    uint32_t blocks_dropped; // raw buffers skipped to recover from overruns
+    uint32_t blocks_repeated; // raw buffers replayed to recover from underruns
+};
+
+#define PDM_MICROPHONE_DISTANCE_BUCKETS 16
+
+// capture health since the last start
+struct pdm_microphone_health {
+    struct pdm_microphone_ring_stats ring; // raw buffers: read index jumps and their cause
+    struct pdm_microphone_ring_stats pcm_ring; // PCM frames, when eager
+    uint32_t saturated; // filtered samples clipped at full scale (+/-32700, or +/-INT32_MAX for Q31)
+    uint32_t late_irqs; // DMA IRQs serviced after the next raw buffer completed too, stalling the capture
+    uint32_t gated; // raw buffers' worth of channels the activity gate did not filter
+    // reads by how far they trailed the writer when they started, in 1/16ths of
+    // the ring they read (the last bucket also counts overruns)
+    uint32_t distance[PDM_MICROPHONE_DISTANCE_BUCKETS];
+};
+
+typedef struct pdm_microphone pdm_microphone_t;
+typedef void (*pdm_microphone_samples_ready_handler_t)(pdm_microphone_t* mic, void* context);
+
 struct pdm_microphone_config {
     uint gpio_data;
     uint gpio_clk;
@@ -24,9 +108,28 @@ struct pdm_microphone_config {
     uint pio_sm;
     uint sample_rate;
     uint sample_buffer_size;
+    uint filter_stages; // 0: single-stage sinc filter, 1 or 2: CIC + 1 or 2 half-band stages
+    bool resample; // follow the reader's sample rate (ASRC) instead of skipping raw buffers
+    bool planar; // one state machine and DMA pair per mic (pio_sm + i reads gpio_data + i), no de-interleaving
+    uint channels; // 1, 2 or 4 mics on consecutive data pins (0: PDM_CHANNELS)
+    uint decimation; // 48, 64 or 128, within what the filter LUT was built for (0: PDM_DECIMATION)
+    uint raw_buffer_count; // even, >= 4 (0: PDM_RAW_BUFFER_COUNT)
+    enum pdm_microphone_read_mode read_mode;
+    bool free_running; // the DMA cycles through the raw buffers on its own, without IRQs (raw_buffer_count
+                       // a power of 2, no samples ready handler, reads at least every raw_buffer_count buffers)
+    enum pdm_microphone_placement placement; // eager placements filter every raw buffer into a PCM frame,
+                                             // reads only copy them out (int16_t reads round the Q31 samples)
+    uint pcm_buffer_count; // eager: PCM frames of sample_buffer_size, even, >= 4 (0: PDM_PCM_BUFFER_COUNT)
+    // activity gate: channels that stay quiet are not filtered and read as 0 until active again. A
+    // channel's activity in a raw buffer is the mean squared deviation of its 1s per output sample,
+    // at 4 samples spread over the buffer, from their running mean, in 1/16ths of a bit^2: a
+    // full-scale tone reads about 2 * decimation^2 (4608 at 48), idle microphones much less
+    uint gate_open_level; // 0: off, else activity at which a gated channel is filtered again
+    uint gate_close_level; // activity below which a raw buffer counts as quiet (0: gate_open_level / 2)
+    uint gate_hold; // quiet raw buffers in a row before a channel is gated (0: PDM_GATE_HOLD)
 };
 
-static void pdm_dma_handler();
+// Single microphone group API, on a built-in instance
 
 int pdm_microphone_init(const struct pdm_microphone_config* config);
 void pdm_microphone_deinit();
@@ -34,11 +137,78 @@ void pdm_microphone_deinit();
 int pdm_microphone_start();
 void pdm_microphone_stop();
 
+uint pdm_microphone_cycles_per_bit();
+const struct pdm_clock_config* pdm_microphone_get_clock();
+
 void pdm_microphone_set_samples_ready_handler(pdm_samples_ready_handler_t handler);
 void pdm_microphone_set_filter_max_volume(uint8_t max_volume);
 void pdm_microphone_set_filter_gain(uint8_t gain);
 void pdm_microphone_set_filter_volume(uint16_t volume);
+void pdm_microphone_set_read_mode(enum pdm_microphone_read_mode read_mode);
+
+uint pdm_microphone_blocks_available();
+void pdm_microphone_get_ring_stats(struct pdm_microphone_ring_stats* stats);
+void pdm_microphone_get_pcm_ring_stats(struct pdm_microphone_ring_stats* stats);
+void pdm_microphone_get_timing(struct pdm_microphone_timing* timing);
+void pdm_microphone_get_health(struct pdm_microphone_health* health);
+void pdm_microphone_reset_timing();
 
+// return the # of samples per channel read, fewer than n_samples only in
+// PDM_MICROPHONE_READ_NONBLOCKING mode or, for pdm_microphone_read(), beyond
+// sample_buffer_size (channel j still starts at j * n_samples)
 int pdm_microphone_read(int16_t* buffer, size_t n_samples);
+int pdm_microphone_read_samples(int16_t* buffer, size_t n_samples);
+
+// Q31 samples (the 16-bit scale shifted up by 16 bits, without the 16-bit
+// truncation); take the upper 24 bits for 24-bit PCM. With filter_stages 1 or
+// 2 they resolve about 20 bits of PDM full scale before the volume, so use
+// filter_stages 0 where the low bits of 24-bit PCM matter
+int pdm_microphone_read32(int32_t* buffer, size_t n_samples);
+int pdm_microphone_read_samples32(int32_t* buffer, size_t n_samples);
+
+// the same, also describing the samples read (if any)
+int pdm_microphone_read_samples_info(int16_t* buffer, size_t n_samples, struct pdm_microphone_read_info* info);
+int pdm_microphone_read_samples32_info(int32_t* buffer, size_t n_samples, struct pdm_microphone_read_info* info);
+
+// Instance API: independent groups on either PIO block, each with its own
+// state machines (pio_sm ... pio_sm + channels - 1 when planar), DMA channels
+// and buffers. Groups that use the single-stage filter share its LUT, so they
+// must use the same decimation. The DMA IRQ handlers are shared, and samples
+// ready handlers run in IRQ context.
+
+pdm_microphone_t* pdm_microphone_create(const struct pdm_microphone_config* config);
+void pdm_microphone_destroy(pdm_microphone_t* mic);
+pdm_microphone_t* pdm_microphone_get_default(); // the instance behind pdm_microphone_init()
+
+int pdm_microphone_instance_start(pdm_microphone_t* mic);
+void pdm_microphone_instance_stop(pdm_microphone_t* mic);
+
+const struct pdm_clock_config* pdm_microphone_instance_get_clock(pdm_microphone_t* mic);
+
+void pdm_microphone_instance_set_samples_ready_handler(pdm_microphone_t* mic, pdm_microphone_samples_ready_handler_t handler, void* context);
+void pdm_microphone_instance_set_filter_max_volume(pdm_microphone_t* mic, uint8_t max_volume);
+void pdm_microphone_instance_set_filter_gain(pdm_microphone_t* mic, uint8_t gain);
+void pdm_microphone_instance_set_filter_volume(pdm_microphone_t* mic, uint16_t volume);
+void pdm_microphone_instance_set_read_mode(pdm_microphone_t* mic, enum pdm_microphone_read_mode read_mode);
+
+uint pdm_microphone_instance_blocks_available(pdm_microphone_t* mic);
+void pdm_microphone_instance_get_ring_stats(pdm_microphone_t* mic, struct pdm_microphone_ring_stats* stats);
+void pdm_microphone_instance_get_pcm_ring_stats(pdm_microphone_t* mic, struct pdm_microphone_ring_stats* stats);
+void pdm_microphone_instance_get_timing(pdm_microphone_t* mic, struct pdm_microphone_timing* timing);
+void pdm_microphone_instance_get_health(pdm_microphone_t* mic, struct pdm_microphone_health* health);
+void pdm_microphone_instance_reset_timing(pdm_microphone_t* mic);
+
+int pdm_microphone_instance_read(pdm_microphone_t* mic, int16_t* buffer, size_t n_samples);
+int pdm_microphone_instance_read_samples(pdm_microphone_t* mic, int16_t* buffer, size_t n_samples);
+int pdm_microphone_instance_read32(pdm_microphone_t* mic, int32_t* buffer, size_t n_samples);
+int pdm_microphone_instance_read_samples32(pdm_microphone_t* mic, int32_t* buffer, size_t n_samples);
+int pdm_microphone_instance_read_samples_info(pdm_microphone_t* mic, int16_t* buffer, size_t n_samples,
+                                              struct pdm_microphone_read_info* info);
+int pdm_microphone_instance_read_samples32_info(pdm_microphone_t* mic, int32_t* buffer, size_t n_samples,
+                                                struct pdm_microphone_read_info* info);
+
+// an audio source (see audio_source.h) on a new instance, its context, which
+// audio_source_deinit() destroys
+int pdm_microphone_source_init(struct audio_source* source, const struct pdm_microphone_config* config);
 
 #endif
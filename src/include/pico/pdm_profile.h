@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PICO_PDM_PROFILE_H_
+#define _PICO_PDM_PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Optional per-stage profiling of the capture pipeline, compiled in with
+// PDM_PROFILE=1 (the PDM_PROFILE CMake option). Every pass through a stage
+// adds its duration in ticks to the stage's histogram: clk_sys cycles from
+// SysTick on the device (enabled on each core that records, so unavailable
+// to the application, and passes over 2^24 cycles wrap), nanoseconds from
+// CLOCK_MONOTONIC in host builds. Without PDM_PROFILE the stage markers
+// compile to nothing and the queries report no passes.
+//
+// Histogram buckets are log-linear, 4 per power of two, so percentiles are
+// within 25% (rounded up to the bucket's end, but never above the maximum).
+
+#ifndef PDM_PROFILE
+#define PDM_PROFILE 0
+#endif
+
+enum pdm_profile_stage {
+    PDM_PROFILE_DMA_IRQ = 0, // the shared DMA IRQ handler, including IRQ placement filtering and samples ready handlers
+    PDM_PROFILE_FILTER, // each filter kernel call (which de-interleaves bit-interleaved streams on the fly)
+    PDM_PROFILE_RESAMPLE, // each ASRC call
+    PDM_PROFILE_READ, // each read call, including any filtering, resampling and blocking
+    // marked by the application (e.g. usb_microphone)
+    PDM_PROFILE_INTERLEAVE, // packing the channels into the output format
+    PDM_PROFILE_WRITE, // handing the samples on (e.g. usb_microphone_write())
+    PDM_PROFILE_STAGES
+};
+
+#define PDM_PROFILE_BUCKETS 96
+
+struct pdm_profile_stats {
+    uint32_t count; // passes since the last reset
+    uint32_t min; // ticks
+    uint32_t mean;
+    uint32_t max;
+    uint32_t p50;
+    uint32_t p90;
+    uint32_t p99;
+};
+
+#if PDM_PROFILE
+// brackets one pass through stage, within one function
+#define PDM_PROFILE_BEGIN(name) const uint32_t name = pdm_profile_now()
+#define PDM_PROFILE_END(stage, name) pdm_profile_end(stage, name)
+#else
+#define PDM_PROFILE_BEGIN(name)
+#define PDM_PROFILE_END(stage, name)
+#endif
+
+void pdm_profile_init(); // on each core that records, before it does
+uint32_t pdm_profile_now();
+void pdm_profile_end(enum pdm_profile_stage stage, uint32_t start);
+
+void pdm_profile_reset();
+uint32_t pdm_profile_tick_hz();
+const char* pdm_profile_stage_name(enum pdm_profile_stage stage);
+
+// false if stage saw no passes (or PDM_PROFILE is off)
+bool pdm_profile_get_stats(enum pdm_profile_stage stage, struct pdm_profile_stats* stats);
+uint32_t pdm_profile_percentile(enum pdm_profile_stage stage, uint32_t percent);
+
+// the raw histogram: PDM_PROFILE_BUCKETS counts, bucket b holding passes of
+// pdm_profile_bucket_min(b) to pdm_profile_bucket_min(b + 1) - 1 ticks (the
+// last one also everything longer)
+const uint32_t* pdm_profile_get_histogram(enum pdm_profile_stage stage);
+uint32_t pdm_profile_bucket_min(uint32_t bucket);
+
+#endif
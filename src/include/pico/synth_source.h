@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PICO_SYNTH_SOURCE_H_
+#define _PICO_SYNTH_SOURCE_H_
+
+#include "pico/audio_source.h"
+
+// Deterministic audio source for testing and benchmarking without a
+// microphone: every read generates the next n_samples on the spot, so it
+// never overruns or underruns and reports no latency. The same config gives
+// the same samples on every run (and on the device and a host build alike, up
+// to the floating point sine table).
+
+#define SYNTH_SOURCE_CHANNELS_MAX 4
+
+// defaults for the synth_source_config fields left at 0
+#define SYNTH_SOURCE_FREQUENCY 1000 // Hz
+#define SYNTH_SOURCE_AMPLITUDE 16384 // peak, of 32767
+#define SYNTH_SOURCE_DECIMATION 64 // PDM samples per PCM sample
+
+// largest amplitude the PDM modulator stays stable at
+#define SYNTH_SOURCE_PDM_AMPLITUDE_MAX 22937
+
+enum synth_source_signal {
+    SYNTH_SOURCE_TONE = 0, // a sine, channel j at (j + 1) * frequency
+    SYNTH_SOURCE_NOISE, // white noise, uniform within +/- amplitude, independent per channel
+    SYNTH_SOURCE_PDM, // the tone as a PDM bit stream (2nd order sigma-delta at decimation * sample_rate),
+                      // turned back into PCM by the multi-stage PDM decimator
+};
+
+struct synth_source_config {
+    enum synth_source_signal signal;
+    uint sample_rate;
+    uint sample_buffer_size; // samples per channel per block, the unit of the stats
+    uint channels; // 1 - SYNTH_SOURCE_CHANNELS_MAX (PDM: 1, 2 or 4)
+    uint frequency; // of channel 0 (0: SYNTH_SOURCE_FREQUENCY)
+    uint amplitude; // peak (0: SYNTH_SOURCE_AMPLITUDE), at most SYNTH_SOURCE_PDM_AMPLITUDE_MAX for PDM
+    uint32_t seed; // noise generator seed (0: 1)
+    uint decimation; // PDM: 64 or 128, or 48 with 1 filter stage (0: SYNTH_SOURCE_DECIMATION)
+    uint filter_stages; // PDM: 1 or 2 half-band stages (0: 2)
+};
+
+int synth_source_init(struct audio_source* source, const struct synth_source_config* config);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "pico/types.h"
+
+#include "pdm_asrc.h"
+
+#define PHASE_BITS 6 // log2(PDM_ASRC_PHASES)
+
+// loop gains: ratio trim (Q32) per Q8 sample of averaged fill error, and its
+// integral; slow enough (seconds) that the fill level steps of whole DMA
+// buffers landing at once do not audibly modulate the pitch
+#define KP_SHIFT      6
+#define KI_SHIFT      4
+#define AVERAGE_SHIFT 6
+
+#define ADJUST_MAX ((int32_t)(1 << (32 - PDM_ASRC_MAX_ADJUST_SHIFT)))
+
+// coefs[j][k]: tap k of the low-pass (0.45 fs) interpolating PDM_ASRC_TAPS
+// samples, oldest first, at PDM_ASRC_TAPS / 2 - 1 + j / PDM_ASRC_PHASES
+static int16_t coefs[PDM_ASRC_PHASES + 1][PDM_ASRC_TAPS];
+static bool coefs_ready = false;
+
+static void pdm_asrc_init_coefs() {
+    const float fc = 0.45f;
+
+    for (uint j = 0; j <= PDM_ASRC_PHASES; j++) {
+        float h[PDM_ASRC_TAPS];
+        float sum = 0;
+
+        for (uint k = 0; k < PDM_ASRC_TAPS; k++) {
+            float t = (float)k - (PDM_ASRC_TAPS / 2 - 1) - (float)j / PDM_ASRC_PHASES;
+            float x = 2 * (float)M_PI * t / PDM_ASRC_TAPS;
+            float w = 0.42f + 0.5f * cosf(x) + 0.08f * cosf(2 * x); // Blackman
+            float s = (t == 0) ? 1 : sinf((float)M_PI * 2 * fc * t) / ((float)M_PI * 2 * fc * t);
+
+            h[k] = s * w;
+            sum += h[k];
+        }
+
+        // unity DC gain in every phase, rounding error goes to the center tap
+        int32_t total = 0;
+        for (uint k = 0; k < PDM_ASRC_TAPS; k++) {
+            coefs[j][k] = lroundf(h[k] * 32768 / sum);
+            total += coefs[j][k];
+        }
+        coefs[j][PDM_ASRC_TAPS / 2 - 1 + (j >= PDM_ASRC_PHASES / 2)] += 32768 - total;
+    }
+
+    coefs_ready = true;
+}
+
+void pdm_asrc_init(struct pdm_asrc* asrc, uint8_t channels, int32_t target_fill) {
+    if (!coefs_ready) {
+        pdm_asrc_init_coefs();
+    }
+
+    asrc->channels = channels;
+    asrc->target_fill = target_fill;
+
+    pdm_asrc_reset(asrc);
+}
+
+void pdm_asrc_reset(struct pdm_asrc* asrc) {
+    asrc->fill_avg = asrc->target_fill << 8;
+    asrc->integral = 0;
+    asrc->adjust = 0;
+    asrc->phase = 0;
+    asrc->index = 0;
+    memset(asrc->history, 0x00, sizeof(asrc->history));
+}
+
+// the reader was moved back to the target fill level: restart the average
+// there, but keep the integral, the trim the two clocks need, which a resync
+// does not change; starting it over from 0 each time, a drift of a few
+// hundred ppm can move the fill level into the margins again before the loop
+// catches up, and it never locks
+void pdm_asrc_resync(struct pdm_asrc* asrc) {
+    asrc->fill_avg = asrc->target_fill << 8;
+    asrc->adjust = asrc->integral >> KI_SHIFT;
+}
+
+// fill: input samples the producer is ahead of the consumer, sampled once per
+// consumer block right before pdm_asrc_input_needed()
+void pdm_asrc_update(struct pdm_asrc* asrc, int32_t fill) {
+    asrc->fill_avg += ((fill << 8) - asrc->fill_avg) >> AVERAGE_SHIFT;
+
+    int32_t error = asrc->fill_avg - (asrc->target_fill << 8);
+    int64_t integral_max = (int64_t)ADJUST_MAX << KI_SHIFT;
+
+    asrc->integral += error;
+    asrc->integral = (asrc->integral < -integral_max) ? -integral_max : (asrc->integral > integral_max) ? integral_max : asrc->integral;
+
+    int64_t adjust = ((int64_t)error << KP_SHIFT) + (asrc->integral >> KI_SHIFT);
+    asrc->adjust = (adjust < -ADJUST_MAX) ? -ADJUST_MAX : (adjust > ADJUST_MAX) ? ADJUST_MAX : adjust;
+}
+
+// number of input samples (per channel) that the next n_out outputs consume
+size_t pdm_asrc_input_needed(const struct pdm_asrc* asrc, size_t n_out) {
+    int64_t step = ((int64_t)1 << 32) + asrc->adjust;
+
+    return (asrc->phase + n_out * step) >> 32;
+}
+
+static inline int16_t pdm_asrc_interpolate(const int32_t* window, uint32_t phase) {
+    const int16_t* c0 = coefs[phase >> (32 - PHASE_BITS)];
+    const int16_t* c1 = c0 + PDM_ASRC_TAPS;
+    int32_t f = (phase >> (32 - PHASE_BITS - 14)) & 0x3FFF;
+    int32_t y0 = 0, y1 = 0;
+
+    for (uint k = 0; k < PDM_ASRC_TAPS; k++) {
+        y0 += c0[k] * window[k];
+        y1 += c1[k] * window[k];
+    }
+
+    y0 >>= 15;
+    y1 >>= 15;
+    y0 += ((y1 - y0) * f) >> 14;
+
+    return (y0 < -32768) ? -32768 : (y0 > 32767) ? 32767 : y0;
+}
+
+// 32-bit samples: interpolate the coefficients first, so that only one dot
+// product needs a 64-bit accumulator
+static inline int32_t pdm_asrc_interpolate32(const int32_t* window, uint32_t phase) {
+    const int16_t* c0 = coefs[phase >> (32 - PHASE_BITS)];
+    const int16_t* c1 = c0 + PDM_ASRC_TAPS;
+    int32_t f = (phase >> (32 - PHASE_BITS - 14)) & 0x3FFF;
+    int64_t y = 0;
+
+    for (uint k = 0; k < PDM_ASRC_TAPS; k++) {
+        int32_t c = (c0[k] << 14) + (c1[k] - c0[k]) * f;
+        y += (int64_t)c * window[k];
+    }
+
+    y >>= 29;
+
+    return (y < -INT32_MAX) ? -INT32_MAX : (y > INT32_MAX) ? INT32_MAX : y;
+}
+
+static inline void pdm_asrc_push(int32_t* history, uint8_t* index, int32_t x) {
+    history[*index] = history[*index + PDM_ASRC_TAPS] = x;
+    if (++(*index) == PDM_ASRC_TAPS) {
+        *index = 0;
+    }
+}
+
+// in[ch] holds pdm_asrc_input_needed(n_out) samples, out[ch] receives n_out
+void pdm_asrc_process(struct pdm_asrc* asrc, int16_t* in[], int16_t* out[], size_t n_out) {
+    const uint64_t step = ((int64_t)1 << 32) + asrc->adjust;
+    uint32_t phase = asrc->phase;
+    uint8_t index = asrc->index;
+
+    for (uint ch = 0; ch < asrc->channels; ch++) {
+        int32_t* history = asrc->history[ch];
+        const int16_t* x = in[ch];
+
+        phase = asrc->phase;
+        index = asrc->index;
+
+        for (size_t i = 0; i < n_out; i++) {
+            out[ch][i] = pdm_asrc_interpolate(&history[index], phase);
+
+            uint64_t next = (uint64_t)phase + step;
+            for (uint m = next >> 32; m; m--) {
+                pdm_asrc_push(history, &index, *x++);
+            }
+            phase = (uint32_t)next;
+        }
+    }
+
+    asrc->phase = phase;
+    asrc->index = index;
+}
+
+void pdm_asrc_process32(struct pdm_asrc* asrc, int32_t* in[], int32_t* out[], size_t n_out) {
+    const uint64_t step = ((int64_t)1 << 32) + asrc->adjust;
+    uint32_t phase = asrc->phase;
+    uint8_t index = asrc->index;
+
+    for (uint ch = 0; ch < asrc->channels; ch++) {
+        int32_t* history = asrc->history[ch];
+        const int32_t* x = in[ch];
+
+        phase = asrc->phase;
+        index = asrc->index;
+
+        for (size_t i = 0; i < n_out; i++) {
+            out[ch][i] = pdm_asrc_interpolate32(&history[index], phase);
+
+            uint64_t next = (uint64_t)phase + step;
+            for (uint m = next >> 32; m; m--) {
+                pdm_asrc_push(history, &index, *x++);
+            }
+            phase = (uint32_t)next;
+        }
+    }
+
+    asrc->phase = phase;
+    asrc->index = index;
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PDM_ASRC_H_
+#define _PDM_ASRC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Asynchronous sample rate converter between the PDM clock domain (producer)
+// and whoever calls pdm_microphone_read() (consumer, e.g. USB frames).
+//
+// The producer's lead over the consumer (fill level, in input samples) is
+// averaged and fed to a PI loop that trims the resampling ratio around 1.0,
+// so the fill level settles on its target instead of drifting into the write
+// position. Resampling is a polyphase windowed-sinc FIR with linear
+// interpolation between neighbouring phases.
+
+#define PDM_ASRC_CHANNELS_MAX 4
+#define PDM_ASRC_TAPS         16
+#define PDM_ASRC_PHASES       64
+
+// the ratio is trimmed by at most 1 / 2^PDM_ASRC_MAX_ADJUST_SHIFT
+// (~ +/-4000 ppm), so n output samples need at most
+// n + (n >> PDM_ASRC_MAX_ADJUST_SHIFT) + 2 input samples
+#define PDM_ASRC_MAX_ADJUST_SHIFT 8
+#define PDM_ASRC_INPUT_MAX(n) ((n) + ((n) >> PDM_ASRC_MAX_ADJUST_SHIFT) + 2)
+
+struct pdm_asrc {
+    uint8_t channels;
+    int32_t target_fill;
+    int32_t fill_avg;       // Q8
+    int64_t integral;       // Q8
+    int32_t adjust;         // ratio - 1.0, Q32
+    uint32_t phase;         // fractional input position, Q32
+    uint8_t index;
+    int32_t history[PDM_ASRC_CHANNELS_MAX][2 * PDM_ASRC_TAPS];
+};
+
+void pdm_asrc_init(struct pdm_asrc* asrc, uint8_t channels, int32_t target_fill);
+void pdm_asrc_reset(struct pdm_asrc* asrc);
+void pdm_asrc_resync(struct pdm_asrc* asrc);
+
+void pdm_asrc_update(struct pdm_asrc* asrc, int32_t fill);
+size_t pdm_asrc_input_needed(const struct pdm_asrc* asrc, size_t n_out);
+void pdm_asrc_process(struct pdm_asrc* asrc, int16_t* in[], int16_t* out[], size_t n_out);
+void pdm_asrc_process32(struct pdm_asrc* asrc, int32_t* in[], int32_t* out[], size_t n_out);
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/pdm_clock.h"
+
+// RP2040 system PLL limits, as searched by the SDK's check_sys_clock_khz()
+#define PLL_FBDIV_MIN     16
+#define PLL_FBDIV_MAX     320
+#define PLL_VCO_MIN_KHZ   750000
+#define PLL_VCO_MAX_KHZ   1600000
+#define PLL_POSTDIV_MAX   7
+
+// upper bound of distinct fbdiv / postdiv1 / postdiv2 outputs
+#define SYS_CLOCKS_MAX    2048
+
+bool pdm_clock_sys_clock_valid(uint32_t sys_clock_khz) {
+    for (uint32_t fbdiv = PLL_FBDIV_MIN; fbdiv <= PLL_FBDIV_MAX; fbdiv++) {
+        const uint32_t vco_khz = fbdiv * PDM_CLOCK_XOSC_KHZ;
+
+        if (vco_khz < PLL_VCO_MIN_KHZ || vco_khz > PLL_VCO_MAX_KHZ) {
+            continue;
+        }
+
+        for (uint32_t postdiv1 = 1; postdiv1 <= PLL_POSTDIV_MAX; postdiv1++) {
+            for (uint32_t postdiv2 = 1; postdiv2 <= postdiv1; postdiv2++) {
+                if (vco_khz == sys_clock_khz * postdiv1 * postdiv2) {
+                    return true;
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+bool pdm_clock_divider(uint32_t sys_clock_hz, uint32_t sample_rate, uint8_t decimation, uint8_t cycles_per_bit,
+                       struct pdm_clock_config* config) {
+    const uint64_t pio_hz = (uint64_t)sample_rate * decimation * cycles_per_bit;
+
+    if (pio_hz == 0) {
+        return false;
+    }
+
+    // divider in 1/256ths, rounded to nearest
+    const uint64_t div = ((uint64_t)sys_clock_hz * 256 + pio_hz / 2) / pio_hz;
+    if (div < 256 || div > 0xFFFF * 256) {
+        return false;
+    }
+
+    // achieved - requested, exactly: sys * 256 / (div * cycles * decimation) - rate
+    const int64_t error = (int64_t)sys_clock_hz * 256 - (int64_t)(div * pio_hz);
+
+    memset(config, 0x00, sizeof(*config));
+    config->sample_rate = sample_rate;
+    config->decimation = decimation;
+    config->clkdiv_int = div >> 8;
+    config->clkdiv_frac = div & 0xFF;
+    config->pdm_clock_hz = ((uint64_t)sys_clock_hz * 256 + div * cycles_per_bit / 2) / (div * cycles_per_bit);
+    config->achieved_rate = (double)sys_clock_hz * 256 / ((double)div * cycles_per_bit * decimation);
+    config->rate_error_ppm = (double)error * 1e6 / (double)(div * pio_hz);
+    config->jitter_ns = config->clkdiv_frac ? 1e9 / sys_clock_hz : 0;
+
+    return true;
+}
+
+static int pdm_clock_compare_u32(const void* a, const void* b) {
+    const uint32_t x = *(const uint32_t*)a;
+    const uint32_t y = *(const uint32_t*)b;
+
+    return (x > y) - (x < y);
+}
+
+// all whole-kHz clk_sys values the PLL can produce in [min_khz, max_khz],
+// ascending and without duplicates
+static int pdm_clock_sys_clocks(uint32_t min_khz, uint32_t max_khz, uint32_t* sys_khz) {
+    int n = 0;
+
+    for (uint32_t fbdiv = PLL_FBDIV_MIN; fbdiv <= PLL_FBDIV_MAX; fbdiv++) {
+        const uint32_t vco_khz = fbdiv * PDM_CLOCK_XOSC_KHZ;
+
+        if (vco_khz < PLL_VCO_MIN_KHZ || vco_khz > PLL_VCO_MAX_KHZ) {
+            continue;
+        }
+
+        for (uint32_t postdiv1 = 1; postdiv1 <= PLL_POSTDIV_MAX; postdiv1++) {
+            for (uint32_t postdiv2 = 1; postdiv2 <= postdiv1; postdiv2++) {
+                const uint32_t khz = vco_khz / (postdiv1 * postdiv2);
+
+                if (vco_khz % (postdiv1 * postdiv2) == 0 && khz >= min_khz && khz <= max_khz && n < SYS_CLOCKS_MAX) {
+                    sys_khz[n++] = khz;
+                }
+            }
+        }
+    }
+
+    qsort(sys_khz, n, sizeof(sys_khz[0]), pdm_clock_compare_u32);
+
+    int m = 0;
+    for (int i = 0; i < n; i++) {
+        if (m == 0 || sys_khz[i] != sys_khz[m - 1]) {
+            sys_khz[m++] = sys_khz[i];
+        }
+    }
+
+    return m;
+}
+
+// true if a is a better choice than b for the same rate
+static bool pdm_clock_config_better(const struct pdm_clock_config* a, const struct pdm_clock_config* b, double tolerance_ppm) {
+    const bool a_off = fabs(a->rate_error_ppm) > tolerance_ppm;
+    const bool b_off = fabs(b->rate_error_ppm) > tolerance_ppm;
+
+    // jitter only matters between configurations that are close enough
+    if (a_off != b_off) {
+        return !a_off;
+    }
+    if (!a_off && (a->jitter_ns > 0) != (b->jitter_ns > 0)) {
+        return a->jitter_ns == 0;
+    }
+
+    return fabs(a->rate_error_ppm) < fabs(b->rate_error_ppm);
+}
+
+int pdm_clock_plan(const struct pdm_clock_request* request, struct pdm_clock_plan* plan) {
+    if (request->n_sample_rates == 0 || request->n_sample_rates > PDM_CLOCK_RATES_MAX || request->n_decimations == 0) {
+        return -1;
+    }
+
+    static uint32_t sys_clocks[SYS_CLOCKS_MAX];
+    const int n_sys_clocks = pdm_clock_sys_clocks(request->sys_clock_min_khz, request->sys_clock_max_khz, sys_clocks);
+    bool found = false;
+    unsigned best_off = 0;
+    unsigned best_jittery = 0;
+    double best_error = 0;
+
+    memset(plan, 0x00, sizeof(*plan));
+
+    // clk_sys candidates in ascending order, so ties go to the slowest clock
+    for (int i = 0; i < n_sys_clocks; i++) {
+        const uint32_t sys_khz = sys_clocks[i];
+        struct pdm_clock_plan candidate = { .sys_clock_khz = sys_khz, .n_configs = request->n_sample_rates };
+        unsigned off = 0;
+        unsigned jittery = 0;
+        double error = 0;
+        bool complete = true;
+
+        for (unsigned r = 0; r < request->n_sample_rates && complete; r++) {
+            struct pdm_clock_config* best = &candidate.config[r];
+            bool have = false;
+
+            // ties go to the decimation listed first
+            for (unsigned d = 0; d < request->n_decimations; d++) {
+                struct pdm_clock_config config;
+
+                if (!pdm_clock_divider(sys_khz * 1000, request->sample_rates[r], request->decimations[d],
+                                       request->cycles_per_bit, &config)) {
+                    continue;
+                }
+                if (config.pdm_clock_hz < request->pdm_clock_min_hz || config.pdm_clock_hz > request->pdm_clock_max_hz) {
+                    continue;
+                }
+
+                if (!have || pdm_clock_config_better(&config, best, request->tolerance_ppm)) {
+                    *best = config;
+                    have = true;
+                }
+            }
+
+            if (!have) {
+                complete = false;
+                break;
+            }
+
+            off += (fabs(best->rate_error_ppm) > request->tolerance_ppm);
+            jittery += (best->jitter_ns > 0);
+            error = (fabs(best->rate_error_ppm) > error) ? fabs(best->rate_error_ppm) : error;
+        }
+
+        if (!complete) {
+            continue;
+        }
+
+        if (!found || off < best_off || (off == best_off && off > 0 && error < best_error) ||
+            (off == best_off && off == 0 && (jittery < best_jittery || (jittery == best_jittery && error < best_error)))) {
+            *plan = candidate;
+            best_off = off;
+            best_jittery = jittery;
+            best_error = error;
+            found = true;
+        }
+    }
+
+    return found ? 0 : -1;
+}
@@ -0,0 +1,433 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/types.h"
+
+#include "OpenPDM2PCM/OpenPDMFilter.h"
+
+#include "pdm_decimator.h"
+
+#define CIC_ORDER 4
+
+// fractional bits below the 16-bit CIC scale kept from the droop compensation
+// on, so that the volume scales them up rather than a truncated value; the
+// half-bands before it still round to the 16-bit scale, which bounds what the
+// Q31 output resolves (see pdm_decimator_process32())
+#define FRAC_BITS 4
+
+// half-band coefficients (Q14) of the taps at odd distance 1, 3, 5, ... from
+// the center tap, which is 0.5; every tap at even distance is zero
+static const int16_t hb1_coefs[(PDM_DECIMATOR_HB1_TAPS + 1) / 4] = {
+    4892, -952, 159 // ~68 dB stopband from 0.79 (at the input rate of 4 fs)
+};
+static const int16_t hb2_coefs[(PDM_DECIMATOR_HB2_TAPS + 1) / 4] = {
+    5180, -1634, 877, -528, 324, -195, 111, -58, 27, -10 // ~68 dB from 0.6 fs
+};
+
+// symmetric CIC droop compensation (Q13), center tap first, for a CIC running
+// at 2 or 4 times the output rate; flat to ~0.04 dB up to 0.4 fs
+static const int16_t comp2_coefs[(PDM_DECIMATOR_COMP_TAPS + 1) / 2] = {
+    9424, -760, 190, -62, 20
+};
+static const int16_t comp4_coefs[(PDM_DECIMATOR_COMP_TAPS + 1) / 2] = {
+    8471, -167, 36, -12, 4
+};
+
+// box filter of length r convolved with itself CIC_ORDER - 1 times, in place;
+// h must hold CIC_ORDER * r zero-initialized entries
+static void pdm_decimator_cic_kernel(uint32_t* h, uint r) {
+    const uint len = CIC_ORDER * r;
+
+    for (uint n = 0; n < r; n++) {
+        h[n] = 1;
+    }
+
+    for (uint k = 1; k < CIC_ORDER; k++) {
+        // running sum of r entries: prefix sums, then differences from the top
+        for (uint n = 1; n < len; n++) {
+            h[n] += h[n - 1];
+        }
+        for (uint n = len - 1; n >= r; n--) {
+            h[n] -= h[n - r];
+        }
+    }
+}
+
+int pdm_decimator_init(struct pdm_decimator* dec, uint8_t channels, uint8_t decimation, uint8_t hb_stages, uint32_t sample_rate) {
+    memset(dec, 0x00, sizeof(*dec));
+
+    if (channels != 1 && channels != 2 && channels != 4) {
+        return -1;
+    }
+    if (hb_stages != 1 && hb_stages != 2) {
+        return -1;
+    }
+
+    // the CIC consumes whole bytes (one at least), and 2 channel words hold 2
+    // bytes per channel
+    uint r = decimation >> hb_stages;
+    if (decimation > DECIMATION_MAX || r == 0 || (r << hb_stages) != decimation || r % 8 || (channels == 2 && decimation % 16)) {
+        return -1;
+    }
+
+    dec->channels = channels;
+    dec->decimation = decimation;
+    dec->hb_stages = hb_stages;
+    dec->cic_decimation = r;
+    dec->comp_coefs = (hb_stages == 1) ? comp2_coefs : comp4_coefs;
+    dec->max_volume = 64;
+    dec->gain = 16;
+
+    // scale the CIC output (0 ... r^4) to signed 16 bits, which leaves the FIR
+    // stages enough headroom for 32-bit accumulators
+    dec->cic_offset = (r * r * r * r) / 2;
+    while ((dec->cic_offset >> dec->cic_shift) > 32768) {
+        dec->cic_shift++;
+    }
+
+    // one pole DC blocker around 10 Hz
+    dec->dc_shift = 1;
+    while (dec->dc_shift < 16 && (sample_rate >> dec->dc_shift) > 63) {
+        dec->dc_shift++;
+    }
+
+    // lut[byte][d][s]: contribution of byte d of a CIC input block to the CIC
+    // output s blocks later; the MSB of byte 0 is the earliest PDM bit
+    uint32_t* h = calloc(CIC_ORDER * r, sizeof(uint32_t));
+    dec->cic_lut = malloc(256 * (r / 8) * CIC_ORDER * sizeof(uint32_t));
+    if (h == NULL || dec->cic_lut == NULL) {
+        free(h);
+        pdm_decimator_deinit(dec);
+
+        return -1;
+    }
+
+    pdm_decimator_cic_kernel(h, r);
+
+    for (uint c = 0; c < 256; c++) {
+        for (uint d = 0; d < r / 8; d++) {
+            for (uint s = 0; s < CIC_ORDER; s++) {
+                uint32_t sum = 0;
+                for (uint k = 0; k < 8; k++) {
+                    if (c & (1 << k)) {
+                        sum += h[s * r + (r - 1) - (8 * d + (7 - k))];
+                    }
+                }
+                dec->cic_lut[(c * (r / 8) + d) * CIC_ORDER + s] = sum;
+            }
+        }
+    }
+
+    free(h);
+
+    Open_PDM_Deinterleave_Init();
+
+    return 0;
+}
+
+void pdm_decimator_deinit(struct pdm_decimator* dec) {
+    if (dec->cic_lut) {
+        free(dec->cic_lut);
+
+        dec->cic_lut = NULL;
+    }
+}
+
+void pdm_decimator_reset(struct pdm_decimator* dec) {
+    memset(dec->channel, 0x00, sizeof(dec->channel));
+    dec->vol_mult = 0;
+}
+
+// output = v * gain * volume / max_volume, normalized so that a full scale
+// PDM signal gives the same level as the single-stage filter; v is clamped
+// first to the smallest magnitude that saturates, so v * vol_mult fits 32 bits.
+// Factors of 32768 and up leave no fractional bits (vol_shift 0), and from
+// 65535 on every sample but 0 saturates, as it would at the exact factor.
+// Where vol_shift + FRAC_BITS exceeds 15, v first drops vol_pre of its
+// FRAC_BITS, for the same reason, which costs at most half an output LSB
+static void pdm_decimator_set_volume(struct pdm_decimator* dec, uint16_t volume) {
+    if (dec->vol_mult && volume == dec->volume && dec->gain == dec->vol_gain && dec->max_volume == dec->vol_max_volume) {
+        return;
+    }
+
+    int64_t num = ((int64_t)dec->gain * volume * 32768) << dec->cic_shift;
+    int64_t den = (int64_t)(dec->max_volume ? dec->max_volume : 1) * dec->cic_offset;
+    uint8_t shift = 15;
+    int64_t mult;
+
+    while ((mult = ((num << shift) + den / 2) / den) >= 32768 && shift > 0) {
+        shift--;
+    }
+    mult = (mult < 1) ? 1 : (mult > 65535) ? 65535 : mult;
+
+    dec->volume = volume;
+    dec->vol_gain = dec->gain;
+    dec->vol_max_volume = dec->max_volume;
+    dec->vol_shift = shift;
+    dec->vol_pre = (shift + FRAC_BITS > 15) ? shift + FRAC_BITS - 15 : 0;
+    dec->vol_mult = mult;
+    dec->vol_limit = (((int64_t)32701 << (shift + FRAC_BITS - dec->vol_pre)) / mult) + 1;
+}
+
+// one CIC output from r / 8 bytes, via the running partial sums in cic[]
+static inline int32_t pdm_decimator_cic(const struct pdm_decimator* dec, uint32_t* cic, const uint8_t* bytes) {
+    const uint n_bytes = dec->cic_decimation / 8;
+    uint32_t z0 = 0, z1 = 0, z2 = 0, z3 = 0;
+
+    for (uint d = 0; d < n_bytes; d++) {
+        const uint32_t* lut = &dec->cic_lut[(bytes[d] * n_bytes + d) * CIC_ORDER];
+        z0 += lut[0];
+        z1 += lut[1];
+        z2 += lut[2];
+        z3 += lut[3];
+    }
+
+    int32_t y = z0 + cic[0];
+    cic[0] = z1 + cic[1];
+    cic[1] = z2 + cic[2];
+    cic[2] = z3;
+
+    return (y - dec->cic_offset) >> dec->cic_shift;
+}
+
+// appends x to a delay line stored twice in a row, and returns its last taps
+// samples, oldest first, as one contiguous window
+static inline const int32_t* pdm_decimator_push(int32_t* line, uint8_t* index, uint8_t taps, int32_t x) {
+    line[*index] = line[*index + taps] = x;
+    if (++(*index) == taps) {
+        *index = 0;
+    }
+
+    return &line[*index];
+}
+
+static inline int32_t pdm_decimator_halfband(const int32_t* window, const int16_t* coefs, uint8_t n_coefs) {
+    const int32_t* center = window + 2 * n_coefs - 1;
+    int32_t acc = center[0] * 8192 + 8192;
+
+    for (int i = 0; i < n_coefs; i++) {
+        acc += coefs[i] * (center[-(2 * i + 1)] + center[2 * i + 1]);
+    }
+
+    return acc >> 14;
+}
+
+static inline int32_t pdm_decimator_comp(const int32_t* window, const int16_t* coefs) {
+    const int32_t* center = window + PDM_DECIMATOR_COMP_TAPS / 2;
+    int32_t acc = center[0] * coefs[0] + (1 << (12 - FRAC_BITS));
+
+    for (int i = 1; i <= PDM_DECIMATOR_COMP_TAPS / 2; i++) {
+        acc += coefs[i] * (center[-i] + center[i]);
+    }
+
+    return acc >> (13 - FRAC_BITS);
+}
+
+// data holds the bits of channels (1, 2 or 4) mics interleaved; inlined into
+// pdm_decimator_channel() once per channel count, so that the de-interleave
+// step is resolved at compile time rather than for every sample
+static inline __attribute__((always_inline)) void pdm_decimator_channel_n(struct pdm_decimator* dec, const uint8_t* data, const uint channels,
+                                                                          uint8_t ch, int16_t* out, int32_t* out32, size_t n_samples) {
+    struct pdm_decimator_channel* state = &dec->channel[ch];
+    const uint data_inc = (dec->decimation / 8) * channels;
+    const uint cic_bytes = dec->cic_decimation / 8;
+    const uint n_cic = 1 << dec->hb_stages;
+    uint8_t bytes[DECIMATION_MAX / 8];
+    int32_t x[4];
+
+    for (size_t i = 0; i < n_samples; i++) {
+        const uint8_t* in = data;
+
+        // de-interleave this channel's PDM bits of one output sample
+        if (channels == 2) {
+            const uint32_t* words = (const uint32_t*)data;
+            for (uint d = 0; d < dec->decimation / 8; d += 2) {
+                uint32_t w = *words++;
+                bytes[d] = pdm_deinterleave_2[pdm_fold_bits2(w, ch)];
+                bytes[d + 1] = pdm_deinterleave_2[pdm_fold_bits2(w >> 16, ch)];
+            }
+            in = bytes;
+        } else if (channels == 4) {
+            const uint32_t* words = (const uint32_t*)data;
+            for (uint d = 0; d < dec->decimation / 8; d++) {
+                bytes[d] = pdm_deinterleave_4[pdm_fold_bits4(*words++, ch)];
+            }
+            in = bytes;
+        }
+
+        for (uint m = 0; m < n_cic; m++) {
+            x[m] = pdm_decimator_cic(dec, state->cic, in + m * cic_bytes);
+        }
+
+        if (dec->hb_stages == 2) {
+            pdm_decimator_push(state->hb1, &state->hb1_index, PDM_DECIMATOR_HB1_TAPS, x[0]);
+            x[0] = pdm_decimator_halfband(
+                pdm_decimator_push(state->hb1, &state->hb1_index, PDM_DECIMATOR_HB1_TAPS, x[1]),
+                hb1_coefs, sizeof(hb1_coefs) / sizeof(hb1_coefs[0])
+            );
+            pdm_decimator_push(state->hb1, &state->hb1_index, PDM_DECIMATOR_HB1_TAPS, x[2]);
+            x[1] = pdm_decimator_halfband(
+                pdm_decimator_push(state->hb1, &state->hb1_index, PDM_DECIMATOR_HB1_TAPS, x[3]),
+                hb1_coefs, sizeof(hb1_coefs) / sizeof(hb1_coefs[0])
+            );
+        }
+
+        pdm_decimator_push(state->hb2, &state->hb2_index, PDM_DECIMATOR_HB2_TAPS, x[0]);
+        int32_t y = pdm_decimator_halfband(
+            pdm_decimator_push(state->hb2, &state->hb2_index, PDM_DECIMATOR_HB2_TAPS, x[1]),
+            hb2_coefs, sizeof(hb2_coefs) / sizeof(hb2_coefs[0])
+        );
+
+        y = pdm_decimator_comp(
+            pdm_decimator_push(state->comp, &state->comp_index, PDM_DECIMATOR_COMP_TAPS, y),
+            dec->comp_coefs
+        );
+
+        state->dc += (y * 256 - state->dc) >> dec->dc_shift;
+        y -= state->dc >> 8;
+
+        if (out32) {
+            // same scale as the 16-bit output, 16 bits further up
+            const int s = 16 - FRAC_BITS - dec->vol_shift;
+            int64_t y32 = (int64_t)y * dec->vol_mult;
+            y32 = (s >= 0) ? y32 * (1 << s) : (y32 + (1 << (-s - 1))) >> -s;
+            out32[i] = (y32 < -INT32_MAX) ? -INT32_MAX : (y32 > INT32_MAX) ? INT32_MAX : y32;
+        } else {
+            const uint8_t shift = dec->vol_shift + FRAC_BITS - dec->vol_pre;
+            y = (y + ((1 << dec->vol_pre) >> 1)) >> dec->vol_pre;
+            y = (y < -dec->vol_limit) ? -dec->vol_limit : (y > dec->vol_limit) ? dec->vol_limit : y;
+            y = (y * dec->vol_mult + (1 << (shift - 1))) >> shift;
+            out[i] = (y < -32700) ? -32700 : (y > 32700) ? 32700 : y;
+        }
+
+        data += data_inc;
+    }
+}
+
+// data is the raw PIO stream when interleaved, else this channel's PDM bytes
+static void pdm_decimator_channel(struct pdm_decimator* dec, const uint8_t* data, bool interleaved, uint8_t ch, int16_t* out, int32_t* out32, size_t n_samples) {
+    switch (interleaved ? dec->channels : 1) {
+        case 2:
+            pdm_decimator_channel_n(dec, data, 2, ch, out, out32, n_samples);
+            break;
+        case 4:
+            pdm_decimator_channel_n(dec, data, 4, ch, out, out32, n_samples);
+            break;
+        default:
+            pdm_decimator_channel_n(dec, data, 1, ch, out, out32, n_samples);
+            break;
+    }
+}
+
+// data is the raw PIO stream (n_samples * decimation / 8 bytes per channel,
+// 32-bit aligned for 2 and 4 channels) and out[ch] receives n_samples PCM
+// samples of channel ch; the filter state carries over between calls, and a
+// NULL out[ch] skips channel ch, leaving its state as it was
+void pdm_decimator_process_interleaved(struct pdm_decimator* dec, const uint8_t* data, int16_t* out[], size_t n_samples, uint16_t volume) {
+    if (dec->cic_lut == NULL) {
+        return;
+    }
+
+    pdm_decimator_set_volume(dec, volume);
+
+    for (uint ch = 0; ch < dec->channels; ch++) {
+        if (out[ch]) {
+            pdm_decimator_channel(dec, data, true, ch, out[ch], NULL, n_samples);
+        }
+    }
+}
+
+// same, with Q31 output (the 16-bit output scaled by 65536, saturated at the
+// int32_t range)
+void pdm_decimator_process_interleaved32(struct pdm_decimator* dec, const uint8_t* data, int32_t* out[], size_t n_samples, uint16_t volume) {
+    if (dec->cic_lut == NULL) {
+        return;
+    }
+
+    pdm_decimator_set_volume(dec, volume);
+
+    for (uint ch = 0; ch < dec->channels; ch++) {
+        if (out[ch]) {
+            pdm_decimator_channel(dec, data, true, ch, NULL, out[ch], n_samples);
+        }
+    }
+}
+
+// same, with data[ch] holding channel ch's PDM bytes (MSB first), as captured
+// by one state machine per microphone
+void pdm_decimator_process(struct pdm_decimator* dec, const uint8_t* data[], int16_t* out[], size_t n_samples, uint16_t volume) {
+    if (dec->cic_lut == NULL) {
+        return;
+    }
+
+    pdm_decimator_set_volume(dec, volume);
+
+    for (uint ch = 0; ch < dec->channels; ch++) {
+        if (out[ch]) {
+            pdm_decimator_channel(dec, data[ch], false, ch, out[ch], NULL, n_samples);
+        }
+    }
+}
+
+// Q31 output: the half-bands round to the 16-bit CIC scale and only the last
+// FRAC_BITS below it survive, so the resolution is about 20 bits at PDM full
+// scale, and the volume scales the rounding noise up with the signal; for
+// 24-bit PCM at high gains, the single-stage sinc filter (filter_stages 0,
+// Open_PDM_FilterBank_Process32()) scales its unrounded sinc sum instead
+void pdm_decimator_process32(struct pdm_decimator* dec, const uint8_t* data[], int32_t* out[], size_t n_samples, uint16_t volume) {
+    if (dec->cic_lut == NULL) {
+        return;
+    }
+
+    pdm_decimator_set_volume(dec, volume);
+
+    for (uint ch = 0; ch < dec->channels; ch++) {
+        if (out[ch]) {
+            pdm_decimator_channel(dec, data[ch], false, ch, NULL, out[ch], n_samples);
+        }
+    }
+}
+
+static int pdm_decimator_add_cost(struct pdm_decimator_stage_cost* costs, int n, int max_costs,
+                                  const char* name, uint8_t rate, uint16_t lookups, uint16_t mults, uint16_t adds) {
+    if (n < max_costs) {
+        costs[n].name = name;
+        costs[n].rate = rate;
+        costs[n].lookups = lookups;
+        costs[n].mults = mults;
+        costs[n].adds = adds;
+    }
+
+    return n + 1;
+}
+
+// fills in the work per output sample and channel of each stage and returns
+// the number of stages (which may exceed max_costs)
+int pdm_decimator_get_stage_costs(const struct pdm_decimator* dec, struct pdm_decimator_stage_cost* costs, int max_costs) {
+    const uint n_cic = 1 << dec->hb_stages;
+    const uint cic_bytes = dec->cic_decimation / 8;
+    const uint hb1 = sizeof(hb1_coefs) / sizeof(hb1_coefs[0]);
+    const uint hb2 = sizeof(hb2_coefs) / sizeof(hb2_coefs[0]);
+    int n = 0;
+
+    if (dec->channels > 1) {
+        n = pdm_decimator_add_cost(costs, n, max_costs, "deinterleave", 1, dec->decimation / 8, 0, 0);
+    }
+    n = pdm_decimator_add_cost(costs, n, max_costs, "cic", n_cic,
+                               n_cic * cic_bytes * CIC_ORDER, 0, n_cic * (cic_bytes * CIC_ORDER + CIC_ORDER));
+    if (dec->hb_stages == 2) {
+        n = pdm_decimator_add_cost(costs, n, max_costs, "halfband1", 2, 0, 2 * (hb1 + 1), 2 * (2 * hb1 + 1));
+    }
+    n = pdm_decimator_add_cost(costs, n, max_costs, "halfband2", 1, 0, hb2 + 1, 2 * hb2 + 1);
+    n = pdm_decimator_add_cost(costs, n, max_costs, "droop", 1, 0, PDM_DECIMATOR_COMP_TAPS / 2 + 1, PDM_DECIMATOR_COMP_TAPS);
+    n = pdm_decimator_add_cost(costs, n, max_costs, "dc+volume", 1, 0, 1, 4);
+
+    return n;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PDM_DECIMATOR_H_
+#define _PDM_DECIMATOR_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Multi-stage PDM to PCM decimator:
+//
+//   PDM -> CIC (order 4, / decimation >> hb_stages) -> [half-band 11 taps, / 2]
+//       -> half-band 39 taps, / 2 -> CIC droop compensation (9 taps)
+//       -> DC blocker -> volume
+//
+// The CIC runs from a byte Look-Up Table, the FIR stages are polyphase
+// half-bands that only evaluate their non-zero taps at the output rate.
+
+#define PDM_DECIMATOR_CHANNELS_MAX 4
+#define PDM_DECIMATOR_HB1_TAPS     11
+#define PDM_DECIMATOR_HB2_TAPS     39
+#define PDM_DECIMATOR_COMP_TAPS    9
+
+struct pdm_decimator_channel {
+    uint32_t cic[3];
+    int32_t hb1[2 * PDM_DECIMATOR_HB1_TAPS];
+    int32_t hb2[2 * PDM_DECIMATOR_HB2_TAPS];
+    int32_t comp[2 * PDM_DECIMATOR_COMP_TAPS];
+    uint8_t hb1_index;
+    uint8_t hb2_index;
+    uint8_t comp_index;
+    int32_t dc;
+};
+
+struct pdm_decimator {
+    // public, same meaning as in the single-stage filter
+    uint8_t max_volume;
+    uint8_t gain;
+
+    // private
+    uint8_t channels;
+    uint8_t decimation;
+    uint8_t hb_stages;
+    uint8_t cic_decimation;
+    uint8_t cic_shift;
+    uint8_t dc_shift;
+    int32_t cic_offset;
+    const int16_t* comp_coefs;
+    uint32_t* cic_lut;
+    uint16_t volume;
+    uint8_t vol_gain;
+    uint8_t vol_max_volume;
+    uint8_t vol_shift;
+    uint8_t vol_pre;
+    int32_t vol_mult;
+    int32_t vol_limit;
+    struct pdm_decimator_channel channel[PDM_DECIMATOR_CHANNELS_MAX];
+};
+
+// work per output sample and channel of one stage, for cycle budgeting
+struct pdm_decimator_stage_cost {
+    const char* name;
+    uint8_t rate;       // stage output rate, in multiples of the output sample rate
+    uint16_t lookups;   // table reads
+    uint16_t mults;     // 32-bit multiplies
+    uint16_t adds;      // additions and subtractions
+};
+
+#define PDM_DECIMATOR_STAGES_MAX 6
+
+int pdm_decimator_init(struct pdm_decimator* dec, uint8_t channels, uint8_t decimation, uint8_t hb_stages, uint32_t sample_rate);
+void pdm_decimator_deinit(struct pdm_decimator* dec);
+void pdm_decimator_reset(struct pdm_decimator* dec);
+
+void pdm_decimator_process_interleaved(struct pdm_decimator* dec, const uint8_t* data, int16_t* out[], size_t n_samples, uint16_t volume);
+void pdm_decimator_process_interleaved32(struct pdm_decimator* dec, const uint8_t* data, int32_t* out[], size_t n_samples, uint16_t volume);
+void pdm_decimator_process(struct pdm_decimator* dec, const uint8_t* data[], int16_t* out[], size_t n_samples, uint16_t volume);
+void pdm_decimator_process32(struct pdm_decimator* dec, const uint8_t* data[], int32_t* out[], size_t n_samples, uint16_t volume);
+
+int pdm_decimator_get_stage_costs(const struct pdm_decimator* dec, struct pdm_decimator_stage_cost* costs, int max_costs);
+
+#endif
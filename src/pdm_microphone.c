@@ -11,411 +11,1678 @@
 #include "hardware/clocks.h"
 #include "hardware/dma.h"
 #include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pico/multicore.h"
+#include "pico/time.h"
 
 #include "OpenPDM2PCM/OpenPDMFilter.h"
 
+#include "pdm_asrc.h"
+#include "pdm_decimator.h"
+#include "pdm_ring.h"
 #include "pdm_microphone.pio.h"
 
+#include "pico/pdm_clock.h"
 #include "pico/pdm_microphone.h"
+#include "pico/pdm_profile.h"
 
-static struct {
-    struct pdm_microphone_config config;
-    int dma_channel_a;
-    int dma_channel_b;
-    dma_channel_config dma_channel_a_cfg;
-    dma_channel_config dma_channel_b_cfg;
+// PIO program and DMA transfer size that capture one raw stream layout
+struct pdm_microphone_capture {
+    const pio_program_t* program;
+    enum dma_channel_transfer_size dma_size;
+};
+
+typedef void (*pdm_microphone_filter_t)(pdm_microphone_t* mic, uint8_t* in[], int16_t* out[], size_t n_samples, uint16_t volume);
+typedef void (*pdm_microphone_filter32_t)(pdm_microphone_t* mic, uint8_t* in[], int32_t* out[], size_t n_samples, uint16_t volume);
+
+struct pdm_microphone {
+    struct pdm_microphone_config config; // with the defaults filled in
+    // kernels for the configured layout and filter, bound at init
+    const struct pdm_microphone_capture* capture;
+    pdm_microphone_filter_t filter_kernel;
+    pdm_microphone_filter32_t filter32_kernel;
+    int program_slot; // in pdm_microphone_programs, -1 if none
+    bool sm_claimed;
+    bool lut_user; // holds the shared single-stage filter LUT
+    bool running;
+    // one DMA lane (channel pair) for the interleaved stream, or one per
+    // microphone when capturing planar
+    uint n_lanes;
+    int dma_channel_a[PDM_CHANNELS_MAX];
+    int dma_channel_b[PDM_CHANNELS_MAX];
+    dma_channel_config dma_channel_a_cfg[PDM_CHANNELS_MAX];
+    dma_channel_config dma_channel_b_cfg[PDM_CHANNELS_MAX];
+    uint dma_transfer_count;
     uint8_t* raw_buffer;
-    volatile int raw_buffer_write_index_a;
-    volatile int raw_buffer_write_index_b;
+    volatile int raw_buffer_write_index_a[PDM_CHANNELS_MAX];
+    volatile int raw_buffer_write_index_b[PDM_CHANNELS_MAX];
+    uint32_t lane_written[PDM_CHANNELS_MAX]; // raw buffers completed per lane
+    // free running: channel b reloads channel a's write address from the
+    // lane's table of raw buffers, read through a ring of the table's size
+    uint32_t* write_addr_table; // raw_buffer_count entries per lane
+    void* write_addr_table_alloc;
     uint raw_buffer_size;
-    uint dma_irq_a;
-    uint dma_irq_b;
-    TPDMFilter_InitStruct filters[N_CHANNELS];
+    uint raw_buffer_count;
+    uint lane_size; // bytes of one lane in each raw buffer
+    uint lane_sample_size; // bytes of one lane per output sample
+    struct pdm_ring ring; // raw buffers completed on all lanes vs. read
+    uint raw_buffer_read_offset; // sample offset of the next read within the ring's read raw buffer
+    struct pdm_microphone_block_info* block_info; // per raw buffer
+    uint64_t samples_captured; // capture position of the next raw buffer to complete
+    // eager: frames of sample_buffer_size Q31 samples per channel, filled by the IRQ or core1
+    struct pdm_ring pcm_ring;
+    int32_t* pcm_buffer;
+    struct pdm_microphone_block_info* pcm_info; // per frame, its raw buffer's
+    uint pcm_read_offset;
+    uint64_t next_sample; // capture position the reader expects next, to spot skips and repeats
+    struct pdm_microphone_timing timing;
+    // see struct pdm_microphone_health
+    uint32_t saturated;
+    uint32_t late_irqs;
+    uint32_t distance[PDM_MICROPHONE_DISTANCE_BUCKETS];
+    uint32_t gated;
+    // activity gate: channels not filtered in the current raw buffer, and per
+    // channel the running mean density of 1s (Q4) and quiet raw buffers in a row
+    uint8_t gate_closed;
+    int32_t gate_mean[PDM_CHANNELS_MAX];
+    uint gate_quiet[PDM_CHANNELS_MAX];
+    struct pdm_clock_config clock;
+    TPDMFilterBank_InitStruct filter;
+    struct pdm_decimator decimator;
+    struct pdm_asrc asrc;
+    int32_t* asrc_buffer; // also used as int16_t* with the same stride
+    uint asrc_buffer_size;
     uint16_t filter_volume;
-    pdm_samples_ready_handler_t samples_ready_handler;
-} pdm_mic;
+    pdm_microphone_samples_ready_handler_t samples_ready_handler;
+    void* samples_ready_context;
+};
+
+// the instance behind the single-microphone API (pdm_microphone_init() etc.)
+static struct pdm_microphone pdm_mic = { .program_slot = -1 };
+static pdm_samples_ready_handler_t pdm_mic_samples_ready_handler;
+
+// started instances, served by one shared handler on each DMA IRQ
+static pdm_microphone_t* volatile pdm_microphone_running[PDM_MICROPHONE_INSTANCES_MAX];
+static uint pdm_microphone_n_running;
+
+// capture programs loaded per PIO block, shared by the instances using them
+static struct {
+    PIO pio;
+    const pio_program_t* program;
+    uint offset;
+    uint users;
+} pdm_microphone_programs[NUM_PIOS * 3];
+
+// instances filtered on core1, and core1's loop count to tell when it let go of one
+static pdm_microphone_t* volatile pdm_microphone_core1[PDM_MICROPHONE_INSTANCES_MAX];
+static uint pdm_microphone_n_core1;
+static volatile uint32_t pdm_microphone_core1_passes;
+
+// the single-stage filter LUT is global, so all its users share one decimation
+static uint pdm_microphone_lut_users;
+static uint pdm_microphone_lut_decimation;
+
+// raw buffer index's part written by DMA lane
+static inline uint8_t* pdm_microphone_lane_buffer(pdm_microphone_t* mic, uint lane, int index) {
+    return mic->raw_buffer + mic->raw_buffer_size*index + mic->lane_size*lane;
+}
+
+// filtered ahead of the reader, into PCM frames
+static inline bool pdm_microphone_eager(pdm_microphone_t* mic) {
+    return mic->config.placement != PDM_MICROPHONE_PLACEMENT_READ;
+}
+
+// PCM frame index's channel j, when eager
+static inline int32_t* pdm_microphone_pcm_frame(pdm_microphone_t* mic, int index, uint j) {
+    return mic->pcm_buffer + (index*mic->config.channels + j)*mic->config.sample_buffer_size;
+}
+
+// how far behind the writer a reader restarts after an overrun or underrun:
+// close if it reads slower (most time until the next overrun), far if faster;
+// a resampling reader follows the writer's rate, so it restarts half way
+static uint pdm_microphone_resync_fill(const struct pdm_microphone_config* config, uint count) {
+    if (config->resample) {
+        return count/2;
+    }
+#ifndef USB_IS_SLOWER
+    return count/2;
+#elif   USB_IS_SLOWER == true
+    return 2;
+#elif   USB_IS_SLOWER == false
+    return count-2;
+#endif
+}
+
+// capture kernels: the bit-interleaved stream of 1, 2 or 4 mics, and planar
+static const struct pdm_microphone_capture pdm_microphone_captures[] = {
+    { &pdm_microphone_data_n1_program, DMA_SIZE_8 },
+    { &pdm_microphone_data_n2_program, DMA_SIZE_16 },
+    { &pdm_microphone_data_n4_program, DMA_SIZE_32 },
+    // whole 32-bit pushes, byte-swapped into stream order
+    { &pdm_microphone_data_n1_program, DMA_SIZE_32 },
+};
+
+// filter kernels, one indirect call per chunk of samples; the filters in
+// turn pick their per-channel-count inner loops once per call
+static void pdm_microphone_filter_bank_interleaved(pdm_microphone_t* mic, uint8_t* in[], int16_t* out[], size_t n_samples, uint16_t volume) {
+    Open_PDM_FilterBank_ProcessInterleaved(in[0], (uint16_t**)out, n_samples, volume, &mic->filter);
+}
+
+static void pdm_microphone_filter_bank_planar(pdm_microphone_t* mic, uint8_t* in[], int16_t* out[], size_t n_samples, uint16_t volume) {
+    Open_PDM_FilterBank_Process(in, (uint16_t**)out, n_samples, volume, &mic->filter);
+}
+
+static void pdm_microphone_filter_decimator_interleaved(pdm_microphone_t* mic, uint8_t* in[], int16_t* out[], size_t n_samples, uint16_t volume) {
+    pdm_decimator_process_interleaved(&mic->decimator, in[0], out, n_samples, volume);
+}
+
+static void pdm_microphone_filter_decimator_planar(pdm_microphone_t* mic, uint8_t* in[], int16_t* out[], size_t n_samples, uint16_t volume) {
+    pdm_decimator_process(&mic->decimator, (const uint8_t**)in, out, n_samples, volume);
+}
+
+static void pdm_microphone_filter32_bank_interleaved(pdm_microphone_t* mic, uint8_t* in[], int32_t* out[], size_t n_samples, uint16_t volume) {
+    Open_PDM_FilterBank_ProcessInterleaved32(in[0], out, n_samples, volume, &mic->filter);
+}
+
+static void pdm_microphone_filter32_bank_planar(pdm_microphone_t* mic, uint8_t* in[], int32_t* out[], size_t n_samples, uint16_t volume) {
+    Open_PDM_FilterBank_Process32(in, out, n_samples, volume, &mic->filter);
+}
+
+static void pdm_microphone_filter32_decimator_interleaved(pdm_microphone_t* mic, uint8_t* in[], int32_t* out[], size_t n_samples, uint16_t volume) {
+    pdm_decimator_process_interleaved32(&mic->decimator, in[0], out, n_samples, volume);
+}
+
+static void pdm_microphone_filter32_decimator_planar(pdm_microphone_t* mic, uint8_t* in[], int32_t* out[], size_t n_samples, uint16_t volume) {
+    pdm_decimator_process32(&mic->decimator, (const uint8_t**)in, out, n_samples, volume);
+}
+
+// [multi-stage decimator][planar]
+static const pdm_microphone_filter_t pdm_microphone_filters[2][2] = {
+    { pdm_microphone_filter_bank_interleaved, pdm_microphone_filter_bank_planar },
+    { pdm_microphone_filter_decimator_interleaved, pdm_microphone_filter_decimator_planar },
+};
+static const pdm_microphone_filter32_t pdm_microphone_filters32[2][2] = {
+    { pdm_microphone_filter32_bank_interleaved, pdm_microphone_filter32_bank_planar },
+    { pdm_microphone_filter32_decimator_interleaved, pdm_microphone_filter32_decimator_planar },
+};
+
+// fills in the defaults and rejects what no kernel (or filter LUT) supports
+static bool pdm_microphone_config_resolve(struct pdm_microphone_config* config) {
+    config->channels = config->channels ? config->channels : PDM_CHANNELS;
+    config->decimation = config->decimation ? config->decimation : PDM_DECIMATION;
+    config->raw_buffer_count = config->raw_buffer_count ? config->raw_buffer_count : PDM_RAW_BUFFER_COUNT;
+    config->pcm_buffer_count = config->pcm_buffer_count ? config->pcm_buffer_count : PDM_PCM_BUFFER_COUNT;
+
+    if (config->channels != 1 && config->channels != 2 && config->channels != 4) {
+        return false;
+    }
+    if (config->decimation != 48 && config->decimation != 64 && config->decimation != 128) {
+        return false;
+    }
+    // the single-stage filter only runs from a LUT built for this decimation
+    if (!config->filter_stages && (config->decimation % LUT_BITS || (LUT_BITS == 12 && config->decimation % 24) ||
+                                   !LUT_HAS(config->decimation))) {
+        return false;
+    }
+    // the DMA channel pair alternates between even and odd raw buffers
+    if (config->raw_buffer_count < 4 || config->raw_buffer_count % 2) {
+        return false;
+    }
+    if (config->gate_open_level) {
+        config->gate_close_level = config->gate_close_level ? config->gate_close_level : config->gate_open_level / 2;
+        config->gate_hold = config->gate_hold ? config->gate_hold : PDM_GATE_HOLD;
+
+        if (config->gate_close_level > config->gate_open_level) {
+            return false;
+        }
+    }
+    if (config->placement > PDM_MICROPHONE_PLACEMENT_CORE1 ||
+        (config->placement != PDM_MICROPHONE_PLACEMENT_READ && (config->pcm_buffer_count < 4 || config->pcm_buffer_count % 2))) {
+        return false;
+    }
+    // without IRQs, nothing would filter eagerly
+    if (config->placement == PDM_MICROPHONE_PLACEMENT_IRQ && config->free_running) {
+        return false;
+    }
+    // the write address table wraps with the DMA read ring (at most 2^15 bytes)
+    if (config->free_running && ((config->raw_buffer_count & (config->raw_buffer_count - 1)) ||
+                                 config->raw_buffer_count * sizeof(uint32_t) > (1u << 15))) {
+        return false;
+    }
+
+    return true;
+}
+
+// loads program into pio, or shares the copy another instance loaded there
+static int pdm_microphone_program_get(PIO pio, const pio_program_t* program) {
+    int free_slot = -1;
+
+    for (int i = 0; i < (int)count_of(pdm_microphone_programs); i++) {
+        if (pdm_microphone_programs[i].users && pdm_microphone_programs[i].pio == pio && pdm_microphone_programs[i].program == program) {
+            pdm_microphone_programs[i].users++;
+
+            return i;
+        }
+        if (!pdm_microphone_programs[i].users && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+
+    if (free_slot < 0 || !pio_can_add_program(pio, program)) {
+        return -1;
+    }
+
+    pdm_microphone_programs[free_slot].pio = pio;
+    pdm_microphone_programs[free_slot].program = program;
+    pdm_microphone_programs[free_slot].offset = pio_add_program(pio, program);
+    pdm_microphone_programs[free_slot].users = 1;
+
+    return free_slot;
+}
+
+static void pdm_microphone_program_put(int slot) {
+    if (--pdm_microphone_programs[slot].users == 0) {
+        pio_remove_program(pdm_microphone_programs[slot].pio, pdm_microphone_programs[slot].program, pdm_microphone_programs[slot].offset);
+    }
+}
+
+// state machines of all lanes
+static uint32_t pdm_microphone_sm_mask(pdm_microphone_t* mic) {
+    return ((1u << mic->n_lanes) - 1) << mic->config.pio_sm;
+}
+
+static void pdm_microphone_instance_deinit(pdm_microphone_t* mic) {
+    if (mic->running) {
+        pdm_microphone_instance_stop(mic);
+    }
+
+    if (mic->raw_buffer) {
+        free(mic->raw_buffer);
+
+        mic->raw_buffer = NULL;
+    }
+
+    if (mic->block_info) {
+        free(mic->block_info);
+
+        mic->block_info = NULL;
+    }
+
+    if (mic->pcm_buffer) {
+        free(mic->pcm_buffer);
+
+        mic->pcm_buffer = NULL;
+    }
+
+    if (mic->pcm_info) {
+        free(mic->pcm_info);
+
+        mic->pcm_info = NULL;
+    }
+
+    if (mic->write_addr_table_alloc) {
+        free(mic->write_addr_table_alloc);
+
+        mic->write_addr_table_alloc = NULL;
+        mic->write_addr_table = NULL;
+    }
+
+    for (uint lane = 0; lane < PDM_CHANNELS_MAX; lane++) {
+        if (mic->dma_channel_a[lane] > -1) {
+            dma_channel_unclaim(mic->dma_channel_a[lane]);
+            mic->dma_channel_a[lane] = -1;
+        }
+        if (mic->dma_channel_b[lane] > -1) {
+            dma_channel_unclaim(mic->dma_channel_b[lane]);
+            mic->dma_channel_b[lane] = -1;
+        }
+    }
+
+    if (mic->program_slot > -1) {
+        pdm_microphone_program_put(mic->program_slot);
+        mic->program_slot = -1;
+    }
+
+    if (mic->sm_claimed) {
+        for (uint lane = 0; lane < mic->n_lanes; lane++) {
+            pio_sm_unclaim(mic->config.pio, mic->config.pio_sm + lane);
+        }
+        mic->sm_claimed = false;
+    }
+
+    if (mic->lut_user) {
+        pdm_microphone_lut_users--;
+        mic->lut_user = false;
+    }
+
+    pdm_decimator_deinit(&mic->decimator);
+
+    if (mic->asrc_buffer) {
+        free(mic->asrc_buffer);
+
+        mic->asrc_buffer = NULL;
+    }
+}
+
+static int pdm_microphone_instance_init(pdm_microphone_t* mic, const struct pdm_microphone_config* config) {
+    memset(mic, 0x00, sizeof(*mic));
+    memcpy(&mic->config, config, sizeof(mic->config));
+    config = &mic->config;
+
+    mic->program_slot = -1;
+    for (uint lane = 0; lane < PDM_CHANNELS_MAX; lane++) {
+        mic->dma_channel_a[lane] = -1;
+        mic->dma_channel_b[lane] = -1;
+    }
+
+    if (!pdm_microphone_config_resolve(&mic->config)) {
+        return -1;
+    }
+
+    const uint channels = config->channels;
+    const uint decimation = config->decimation;
+
+    mic->capture = &pdm_microphone_captures[config->planar ? 3 : (channels == 4) ? 2 : channels - 1];
+    mic->filter_kernel = pdm_microphone_filters[config->filter_stages != 0][config->planar];
+    mic->filter32_kernel = pdm_microphone_filters32[config->filter_stages != 0][config->planar];
+
+    mic->n_lanes = config->planar ? channels : 1;
+    mic->raw_buffer_count = config->raw_buffer_count;
+    mic->raw_buffer_size = config->sample_buffer_size * (decimation / 8) * channels;
+    mic->lane_size = mic->raw_buffer_size / mic->n_lanes;
+    mic->lane_sample_size = (decimation / 8) * channels / mic->n_lanes;
+
+    pdm_ring_init(&mic->ring, mic->raw_buffer_count, pdm_microphone_resync_fill(config, mic->raw_buffer_count));
+    pdm_ring_init(&mic->pcm_ring, config->pcm_buffer_count, pdm_microphone_resync_fill(config, config->pcm_buffer_count));
+
+    // planar lanes are filled with 32-bit words, by consecutive state machines
+    if (config->planar && (mic->lane_size % 4 || config->pio_sm + channels > NUM_PIO_STATE_MACHINES)) {
+        return -1;
+    }
+
+    // another instance may already run the state machines, or the LUT at another decimation
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        if (pio_sm_is_claimed(config->pio, config->pio_sm + lane)) {
+            return -1;
+        }
+    }
+    if (!config->filter_stages && pdm_microphone_lut_users && pdm_microphone_lut_decimation != decimation) {
+        return -1;
+    }
+
+    pio_claim_sm_mask(config->pio, pdm_microphone_sm_mask(mic));
+    mic->sm_claimed = true;
+
+    if (!config->filter_stages) {
+        pdm_microphone_lut_users++;
+        pdm_microphone_lut_decimation = decimation;
+        mic->lut_user = true;
+    }
+
+    mic->raw_buffer = malloc(mic->raw_buffer_count * mic->raw_buffer_size);
+    if (mic->raw_buffer == NULL) {
+        pdm_microphone_instance_deinit(mic);
+        return -1;
+    }
+
+    mic->block_info = malloc(mic->raw_buffer_count * sizeof(struct pdm_microphone_block_info));
+    if (mic->block_info == NULL) {
+        pdm_microphone_instance_deinit(mic);
+        return -1;
+    }
+
+    if (pdm_microphone_eager(mic)) {
+        mic->pcm_buffer = malloc(config->pcm_buffer_count * channels * config->sample_buffer_size * sizeof(int32_t));
+        mic->pcm_info = malloc(config->pcm_buffer_count * sizeof(struct pdm_microphone_block_info));
+        if (mic->pcm_buffer == NULL || mic->pcm_info == NULL) {
+            pdm_microphone_instance_deinit(mic);
+            return -1;
+        }
+    }
+
+    if (config->free_running) {
+        const uint table_size = mic->raw_buffer_count * sizeof(uint32_t);
+
+        // aligned to its size for the ring, each lane's table in turn
+        mic->write_addr_table_alloc = malloc(mic->n_lanes * table_size + table_size);
+        if (mic->write_addr_table_alloc == NULL) {
+            pdm_microphone_instance_deinit(mic);
+            return -1;
+        }
+        mic->write_addr_table = (uint32_t*)(((uintptr_t)mic->write_addr_table_alloc + table_size - 1) & ~(uintptr_t)(table_size - 1));
+
+        for (uint lane = 0; lane < mic->n_lanes; lane++) {
+            for (uint i = 0; i < mic->raw_buffer_count; i++) {
+                mic->write_addr_table[lane*mic->raw_buffer_count + i] = (uint32_t)(uintptr_t)pdm_microphone_lane_buffer(mic, lane, i);
+            }
+        }
+    }
+
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        mic->dma_channel_a[lane] = dma_claim_unused_channel(false);
+        mic->dma_channel_b[lane] = dma_claim_unused_channel(false);
+        if (mic->dma_channel_a[lane] < 0 || mic->dma_channel_b[lane] < 0) {
+            pdm_microphone_instance_deinit(mic);
+
+            return -1;
+        }
+    }
+
+    const pio_program_t* pdm_microphone_program = mic->capture->program;
+
+    // one PDM bit per program loop (no delays), divider in 1/256 steps as the PIO takes it
+    if (!pdm_clock_divider(clock_get_hz(clk_sys), config->sample_rate, decimation, pdm_microphone_program->length, &mic->clock)) {
+        pdm_microphone_instance_deinit(mic);
+
+        return -1;
+    }
+    float clk_div = mic->clock.clkdiv_int + mic->clock.clkdiv_frac / 256.0f;
+
+    mic->program_slot = pdm_microphone_program_get(config->pio, pdm_microphone_program);
+    if (mic->program_slot < 0) {
+        pdm_microphone_instance_deinit(mic);
+
+        return -1;
+    }
+    uint pio_sm_offset = pdm_microphone_programs[mic->program_slot].offset;
+
+    if (config->planar) {
+        for (uint lane = 0; lane < channels; lane++) {
+            pdm_microphone_data_planar_init(
+                config->pio,
+                config->pio_sm + lane,
+                pio_sm_offset,
+                clk_div,
+                config->gpio_data + lane,
+                config->gpio_clk
+            );
+        }
+    } else {
+        pdm_microphone_data_init(
+            config->pio,
+            config->pio_sm,
+            pio_sm_offset,
+            clk_div,
+            config->gpio_data,
+            config->gpio_clk,
+            channels
+        );
+    }
+
+    const enum dma_channel_transfer_size dma_size = mic->capture->dma_size;
+    mic->dma_transfer_count = mic->lane_size >> dma_size;
+
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        dma_channel_config* cfg_a = &mic->dma_channel_a_cfg[lane];
+        dma_channel_config* cfg_b = &mic->dma_channel_b_cfg[lane];
+        const uint dreq = pio_get_dreq(config->pio, config->pio_sm + lane, false);
+
+        *cfg_a = dma_channel_get_default_config(mic->dma_channel_a[lane]);
+        *cfg_b = dma_channel_get_default_config(mic->dma_channel_b[lane]);
+
+        channel_config_set_transfer_data_size(cfg_a, dma_size);
+        channel_config_set_transfer_data_size(cfg_b, dma_size);
+        channel_config_set_bswap(cfg_a, config->planar);
+        channel_config_set_bswap(cfg_b, config->planar);
+        channel_config_set_read_increment(cfg_a, false);
+        channel_config_set_read_increment(cfg_b, false);
+        channel_config_set_write_increment(cfg_a, true);
+        channel_config_set_write_increment(cfg_b, true);
+        channel_config_set_dreq(cfg_a, dreq);
+        channel_config_set_dreq(cfg_b, dreq);
+        channel_config_set_chain_to(cfg_a, mic->dma_channel_b[lane]);
+        channel_config_set_chain_to(cfg_b, mic->dma_channel_a[lane]);
+        // example code: https://forums.raspberrypi.com/viewtopic.php?t=311306#p1861895
+
+        // free running: b is the control channel, one table entry into a's
+        // write address trigger each time a finishes a raw buffer
+        if (config->free_running) {
+            *cfg_b = dma_channel_get_default_config(mic->dma_channel_b[lane]);
+            channel_config_set_transfer_data_size(cfg_b, DMA_SIZE_32);
+            channel_config_set_read_increment(cfg_b, true);
+            channel_config_set_write_increment(cfg_b, false);
+            channel_config_set_ring(cfg_b, false, __builtin_ctz(mic->raw_buffer_count * sizeof(uint32_t)));
+        }
+    }
+
+    mic->filter.Fs = config->sample_rate;
+    mic->filter.LP_HZ = config->sample_rate / 2;
+    mic->filter.HP_HZ = 10;
+    mic->filter.Channels = channels;
+    mic->filter.Decimation = decimation;
+    mic->filter.MaxVolume = 64;
+    mic->filter.Gain = 16;
+
+    mic->filter_volume = mic->filter.MaxVolume;
+
+    if (!config->filter_stages) {
+        Open_PDM_FilterBank_Init(&mic->filter);
+
+#ifdef PDM_CHECK_LUT
+        // generated at build time or built above, the LUT must match the filter
+        // (tests/test_pdm_lut.c checks the same on the host, without the
+        // start-up cost of walking the whole table here)
+        if (Open_PDM_FilterBank_CheckLUT(decimation)) {
+            pdm_microphone_instance_deinit(mic);
+
+            return -1;
+        }
+#endif
+    } else {
+        if (pdm_decimator_init(&mic->decimator, channels, decimation, config->filter_stages, config->sample_rate) < 0) {
+            pdm_microphone_instance_deinit(mic);
+
+            return -1;
+        }
+
+        mic->decimator.max_volume = mic->filter.MaxVolume;
+        mic->decimator.gain = mic->filter.Gain;
+    }
+
+    if (config->resample) {
+        mic->asrc_buffer_size = PDM_ASRC_INPUT_MAX(config->sample_buffer_size);
+        mic->asrc_buffer = malloc(mic->asrc_buffer_size * channels * sizeof(int32_t));
+        if (mic->asrc_buffer == NULL) {
+            pdm_microphone_instance_deinit(mic);
+
+            return -1;
+        }
+
+        // keep the reader half the raw buffers (or PCM frames) behind the writer
+        const uint count = pdm_microphone_eager(mic) ? config->pcm_buffer_count : mic->raw_buffer_count;
+        pdm_asrc_init(&mic->asrc, channels, count / 2 * config->sample_buffer_size);
+    }
+
+    return 0;
+}
+
+pdm_microphone_t* pdm_microphone_create(const struct pdm_microphone_config* config) {
+    pdm_microphone_t* mic = malloc(sizeof(*mic));
+
+    if (mic == NULL) {
+        return NULL;
+    }
+
+    if (pdm_microphone_instance_init(mic, config) < 0) {
+        free(mic);
+
+        return NULL;
+    }
+
+    return mic;
+}
+
+void pdm_microphone_destroy(pdm_microphone_t* mic) {
+    if (mic == NULL) {
+        return;
+    }
+
+    pdm_microphone_instance_deinit(mic);
+    free(mic);
+}
+
+int pdm_microphone_init(const struct pdm_microphone_config* config) {
+    if (pdm_mic.sm_claimed) {
+        pdm_microphone_instance_deinit(&pdm_mic);
+    }
+
+    return pdm_microphone_instance_init(&pdm_mic, config);
+}
+
+void pdm_microphone_deinit() {
+    pdm_microphone_instance_deinit(&pdm_mic);
+}
+
+pdm_microphone_t* pdm_microphone_get_default() {
+    return &pdm_mic;
+}
+
+// makes the raw buffers up to written readable, stamped with their capture
+// position and the time now
+static void pdm_microphone_publish(pdm_microphone_t* mic, uint32_t written) {
+    const uint64_t now = time_us_64();
+    const uint32_t published = mic->ring.written;
+    uint32_t seq = published;
+
+    if (written - seq > mic->raw_buffer_count) {
+        seq = written - mic->raw_buffer_count;
+    }
+    for (; seq != written; seq++) {
+        struct pdm_microphone_block_info* info = &mic->block_info[seq % mic->raw_buffer_count];
+
+        info->sample = mic->samples_captured + (uint64_t)(seq - published) * mic->config.sample_buffer_size;
+        info->time_us = now;
+    }
+    mic->samples_captured += (uint64_t)(written - published) * mic->config.sample_buffer_size;
+
+    pdm_ring_publish(&mic->ring, written);
+}
+
+static void pdm_microphone_process(pdm_microphone_t* mic);
+
+// gives every channel of mic that finished its next buffer (two ahead, its
+// partner is already writing the one in between), and publishes the raw
+// buffers all lanes have completed
+static void pdm_microphone_dma_handler(pdm_microphone_t* mic) {
+    uint32_t written = UINT32_MAX;
+
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        const int channel_a = mic->dma_channel_a[lane];
+        const int channel_b = mic->dma_channel_b[lane];
+        const volatile void* rxf = &mic->config.pio->rxf[mic->config.pio_sm + lane];
+        uint done = 0;
+
+        if (dma_hw->ints0 & (1u << channel_a)) {
+            dma_hw->ints0 = (1u << channel_a);
+
+            mic->raw_buffer_write_index_a[lane] = (mic->raw_buffer_write_index_a[lane] + 2) % mic->raw_buffer_count;
+            dma_channel_configure(
+                channel_a,
+                &mic->dma_channel_a_cfg[lane],
+                pdm_microphone_lane_buffer(mic, lane, mic->raw_buffer_write_index_a[lane]),
+                rxf,
+                mic->dma_transfer_count,
+                false
+            );
+
+            mic->lane_written[lane]++;
+            done++;
+        }
+
+        if (dma_hw->ints1 & (1u << channel_b)) {
+            dma_hw->ints1 = (1u << channel_b);
+
+            mic->raw_buffer_write_index_b[lane] = (mic->raw_buffer_write_index_b[lane] + 2) % mic->raw_buffer_count;
+            dma_channel_configure(
+                channel_b,
+                &mic->dma_channel_b_cfg[lane],
+                pdm_microphone_lane_buffer(mic, lane, mic->raw_buffer_write_index_b[lane]),
+                rxf,
+                mic->dma_transfer_count,
+                false
+            );
+
+            mic->lane_written[lane]++;
+            done++;
+        }
+
+        // both halves of the ping-pong finished before either was serviced
+        if (done == 2) {
+            mic->late_irqs++;
+        }
+
+        if ((int32_t)(mic->lane_written[lane] - written) < 0 || lane == 0) {
+            written = mic->lane_written[lane];
+        }
+    }
+
+    if (written == mic->ring.written) {
+        return;
+    }
+
+    pdm_microphone_publish(mic, written);
+
+    if (mic->config.placement == PDM_MICROPHONE_PLACEMENT_IRQ) {
+        pdm_microphone_process(mic);
+    }
+
+    if (mic->samples_ready_handler) {
+        mic->samples_ready_handler(mic, mic->samples_ready_context);
+    }
+}
+
+// shared on DMA_IRQ_0 (a channels) and DMA_IRQ_1 (b channels), other drivers
+// may use the same lines
+static void pdm_microphone_dma_irq_handler() {
+    PDM_PROFILE_BEGIN(start);
+
+    for (uint i = 0; i < PDM_MICROPHONE_INSTANCES_MAX; i++) {
+        pdm_microphone_t* mic = pdm_microphone_running[i];
+
+        if (mic) {
+            pdm_microphone_dma_handler(mic);
+        }
+    }
+
+    PDM_PROFILE_END(PDM_PROFILE_DMA_IRQ, start);
+}
+
+// free running: the raw buffers completed on all lanes, from where the DMA
+// is writing now; blocks wrapped around between two calls go unnoticed
+static void pdm_microphone_poll(pdm_microphone_t* mic) {
+    uint32_t written = UINT32_MAX;
+
+    // filtered on core1, the raw buffers are core1's alone
+    if (!mic->config.free_running || !mic->running ||
+        (mic->config.placement == PDM_MICROPHONE_PLACEMENT_CORE1 && get_core_num() != 1)) {
+        return;
+    }
+
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        const uint32_t pos = dma_hw->ch[mic->dma_channel_a[lane]].write_addr - (uint32_t)(uintptr_t)pdm_microphone_lane_buffer(mic, lane, 0);
+        // a planar lane that is complete points at the next lane's part of the same raw buffer
+        const uint32_t index = pos / mic->raw_buffer_size + (pos % mic->raw_buffer_size >= mic->lane_size);
+
+        mic->lane_written[lane] += (index - mic->lane_written[lane]) & (mic->raw_buffer_count - 1);
+
+        if ((int32_t)(mic->lane_written[lane] - written) < 0 || lane == 0) {
+            written = mic->lane_written[lane];
+        }
+    }
+
+    if (written != mic->ring.written) {
+        pdm_microphone_publish(mic, written);
+    }
+}
+
+static void pdm_microphone_core1_entry();
+
+// hands mic to core1, launching it with the first one
+static void pdm_microphone_core1_add(pdm_microphone_t* mic, uint slot) {
+    pdm_microphone_core1[slot] = mic;
+
+    if (pdm_microphone_n_core1++ == 0) {
+        multicore_launch_core1(pdm_microphone_core1_entry);
+    }
+}
+
+// takes mic back from core1 once it is done with it, stopping core1 with the last one
+static void pdm_microphone_core1_remove(pdm_microphone_t* mic) {
+    for (uint i = 0; i < PDM_MICROPHONE_INSTANCES_MAX; i++) {
+        if (pdm_microphone_core1[i] == mic) {
+            pdm_microphone_core1[i] = NULL;
+        }
+    }
+
+    // a pass that started after the removal no longer sees mic
+    const uint32_t passes = pdm_microphone_core1_passes;
+    while (pdm_microphone_core1_passes - passes < 2) {
+        tight_loop_contents();
+    }
+
+    if (--pdm_microphone_n_core1 == 0) {
+        multicore_reset_core1();
+    }
+}
+
+int pdm_microphone_instance_start(pdm_microphone_t* mic) {
+    uint slot;
+    uint core1_slot = 0;
+
+    if (mic->running) {
+        return 0;
+    }
+
+    if (mic->config.placement == PDM_MICROPHONE_PLACEMENT_CORE1) {
+        for (core1_slot = 0; core1_slot < PDM_MICROPHONE_INSTANCES_MAX && pdm_microphone_core1[core1_slot]; core1_slot++);
+        if (core1_slot == PDM_MICROPHONE_INSTANCES_MAX) {
+            return -1;
+        }
+    }
+
+    if (!mic->config.free_running) {
+        for (slot = 0; slot < PDM_MICROPHONE_INSTANCES_MAX && pdm_microphone_running[slot]; slot++);
+        if (slot == PDM_MICROPHONE_INSTANCES_MAX) {
+            return -1;
+        }
+
+        if (pdm_microphone_n_running++ == 0) {
+            irq_add_shared_handler(DMA_IRQ_0, pdm_microphone_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irq_add_shared_handler(DMA_IRQ_1, pdm_microphone_dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+            irq_set_enabled(DMA_IRQ_0, true);
+            irq_set_enabled(DMA_IRQ_1, true);
+        }
+        pdm_microphone_running[slot] = mic;
+
+        for (uint lane = 0; lane < mic->n_lanes; lane++) {
+            dma_channel_set_irq0_enabled(mic->dma_channel_a[lane], true);
+            dma_channel_set_irq1_enabled(mic->dma_channel_b[lane], true);
+        }
+    }
+    mic->running = true;
+
+    Open_PDM_FilterBank_Init(&mic->filter);
+    pdm_decimator_reset(&mic->decimator);
+
+    pdm_ring_reset(&mic->ring);
+    mic->raw_buffer_read_offset = 0;
+    mic->samples_captured = 0;
+    pdm_ring_reset(&mic->pcm_ring);
+    mic->pcm_read_offset = 0;
+    mic->next_sample = 0;
+    mic->saturated = 0;
+    mic->late_irqs = 0;
+    memset(mic->distance, 0x00, sizeof(mic->distance));
+    mic->gated = 0;
+    mic->gate_closed = 0;
+    for (uint j = 0; j < PDM_CHANNELS_MAX; j++) {
+        mic->gate_mean[j] = mic->config.decimation * 8; // half the bits
+        mic->gate_quiet[j] = 0;
+    }
+    pdm_microphone_instance_reset_timing(mic);
+    pdm_profile_init();
+
+    if (mic->config.resample) {
+        pdm_asrc_reset(&mic->asrc);
+    }
 
-int pdm_microphone_init(const struct pdm_microphone_config* config) {
-    memset(&pdm_mic, 0x00, sizeof(pdm_mic));
-    memcpy(&pdm_mic.config, config, sizeof(pdm_mic.config));
+    // channel a fills raw buffer 0 now, then hands over to b on buffer 1
+    // (or, free running, b points a at buffer 1 and so on)
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        const volatile void* rxf = &mic->config.pio->rxf[mic->config.pio_sm + lane];
 
-    if (config->sample_buffer_size % (config->sample_rate / 1000)) {
-        return -1;
+        mic->raw_buffer_write_index_a[lane] = 0;
+        mic->raw_buffer_write_index_b[lane] = 1;
+        mic->lane_written[lane] = 0;
+
+        if (mic->config.free_running) {
+            dma_channel_configure(
+                mic->dma_channel_b[lane],
+                &mic->dma_channel_b_cfg[lane],
+                &dma_hw->ch[mic->dma_channel_a[lane]].al2_write_addr_trig,
+                &mic->write_addr_table[lane*mic->raw_buffer_count + 1],
+                1,
+                false
+            );
+            dma_channel_configure(
+                mic->dma_channel_a[lane],
+                &mic->dma_channel_a_cfg[lane],
+                pdm_microphone_lane_buffer(mic, lane, 0),
+                rxf,
+                mic->dma_transfer_count,
+                true
+            );
+
+            continue;
+        }
+
+        dma_channel_configure(
+            mic->dma_channel_b[lane],
+            &mic->dma_channel_b_cfg[lane],
+            pdm_microphone_lane_buffer(mic, lane, mic->raw_buffer_write_index_b[lane]),
+            rxf,
+            mic->dma_transfer_count,
+            false
+        );
+        dma_channel_configure(
+            mic->dma_channel_a[lane],
+            &mic->dma_channel_a_cfg[lane],
+            pdm_microphone_lane_buffer(mic, lane, mic->raw_buffer_write_index_a[lane]),
+            rxf,
+            mic->dma_transfer_count,
+            true
+        );
     }
 
-    pdm_mic.raw_buffer_size = config->sample_buffer_size * (PDM_DECIMATION / 8) * N_CHANNELS;
+    // planar state machines share the first one's clock pin, so they must
+    // run in lockstep
+    pio_enable_sm_mask_in_sync(mic->config.pio, pdm_microphone_sm_mask(mic));
 
-    pdm_mic.raw_buffer = malloc(PDM_RAW_BUFFER_COUNT * pdm_mic.raw_buffer_size);
-    if (pdm_mic.raw_buffer == NULL) {
-        pdm_microphone_deinit();
-        return -1;
+    if (mic->config.placement == PDM_MICROPHONE_PLACEMENT_CORE1) {
+        pdm_microphone_core1_add(mic, core1_slot);
     }
 
-    pdm_mic.dma_channel_a = dma_claim_unused_channel(true);
-    pdm_mic.dma_channel_b = dma_claim_unused_channel(true);
-    if (pdm_mic.dma_channel_a < 0 || pdm_mic.dma_channel_b < 0) {
-        pdm_microphone_deinit();
+    return 0;
+}
 
-        return -1;
+void pdm_microphone_instance_stop(pdm_microphone_t* mic) {
+    if (!mic->running) {
+        return;
     }
 
-    const pio_program_t* pdm_microphone_program;
-#if N_CHANNELS == 1
-    pdm_microphone_program = &pdm_microphone_data_n1_program;
-#elif N_CHANNELS == 2
-    pdm_microphone_program = &pdm_microphone_data_n2_program;
-#elif N_CHANNELS == 4
-    pdm_microphone_program = &pdm_microphone_data_n4_program;
-#else
-    #error "Unsupported N_CHANNELS value!"
-#endif
-    uint pio_sm_offset = pio_add_program(config->pio, pdm_microphone_program);
+    if (mic->config.placement == PDM_MICROPHONE_PLACEMENT_CORE1) {
+        pdm_microphone_core1_remove(mic);
+    }
 
-    // TODO: PIO INSTRUCTION COUNT IS HARDCODED
-    float clk_div = clock_get_hz(clk_sys) / (config->sample_rate * PDM_DECIMATION * 4.0);
+    pio_set_sm_mask_enabled(mic->config.pio, pdm_microphone_sm_mask(mic), false);
 
-    pdm_microphone_data_init(
-        config->pio,
-        config->pio_sm,
-        pio_sm_offset,
-        clk_div,
-        config->gpio_data,
-        config->gpio_clk,
-        N_CHANNELS
-    );
+    for (uint lane = 0; lane < mic->n_lanes; lane++) {
+        if (mic->config.free_running) {
+            dma_channel_config cfg_a = mic->dma_channel_a_cfg[lane];
 
-    pdm_mic.dma_channel_a_cfg = dma_channel_get_default_config(pdm_mic.dma_channel_a);
-    pdm_mic.dma_channel_b_cfg = dma_channel_get_default_config(pdm_mic.dma_channel_b);
+            // unchain first, so that aborting a cannot restart it through b
+            channel_config_set_chain_to(&cfg_a, mic->dma_channel_a[lane]);
+            dma_channel_abort(mic->dma_channel_b[lane]);
+            dma_channel_set_config(mic->dma_channel_a[lane], &cfg_a, false);
+            dma_channel_abort(mic->dma_channel_a[lane]);
+            dma_channel_abort(mic->dma_channel_b[lane]);
 
-    enum dma_channel_transfer_size dma_size;
-#if N_CHANNELS == 1
-    dma_size = DMA_SIZE_8;
-#elif N_CHANNELS == 2
-    dma_size = DMA_SIZE_16;
-#elif N_CHANNELS == 4
-    dma_size = DMA_SIZE_32;
-#else
-    #error "Unsupported N_CHANNELS value!"
-#endif
+            continue;
+        }
 
-    channel_config_set_transfer_data_size(&pdm_mic.dma_channel_a_cfg, dma_size);
-    channel_config_set_transfer_data_size(&pdm_mic.dma_channel_b_cfg, dma_size);
-    channel_config_set_read_increment(&pdm_mic.dma_channel_a_cfg, false);
-    channel_config_set_read_increment(&pdm_mic.dma_channel_b_cfg, false);
-    channel_config_set_write_increment(&pdm_mic.dma_channel_a_cfg, true);
-    channel_config_set_write_increment(&pdm_mic.dma_channel_b_cfg, true);
-    channel_config_set_dreq(&pdm_mic.dma_channel_a_cfg, pio_get_dreq(config->pio, config->pio_sm, false));
-    channel_config_set_dreq(&pdm_mic.dma_channel_b_cfg, pio_get_dreq(config->pio, config->pio_sm, false));
-    channel_config_set_chain_to(&pdm_mic.dma_channel_a_cfg, pdm_mic.dma_channel_b);
-    channel_config_set_chain_to(&pdm_mic.dma_channel_b_cfg, pdm_mic.dma_channel_a);
-    // example code: https://forums.raspberrypi.com/viewtopic.php?t=311306#p1861895
-
-    pdm_mic.dma_irq_a = DMA_IRQ_0;
-    pdm_mic.dma_irq_b = DMA_IRQ_1;
-
-    dma_channel_configure(
-        pdm_mic.dma_channel_a,
-        &pdm_mic.dma_channel_a_cfg,
-        pdm_mic.raw_buffer,
-        &config->pio->rxf[config->pio_sm],
-        pdm_mic.raw_buffer_size/N_CHANNELS,
-        false
-    );
-    dma_channel_configure(
-        pdm_mic.dma_channel_b,
-        &pdm_mic.dma_channel_b_cfg,
-        pdm_mic.raw_buffer,
-        &config->pio->rxf[config->pio_sm],
-        pdm_mic.raw_buffer_size/N_CHANNELS,
-        false
-    );
-
-    // TODO: avoid four separate filters
-    for (uint i = 0; i < N_CHANNELS; i++) {
-        pdm_mic.filters[i].Fs = config->sample_rate;
-        pdm_mic.filters[i].LP_HZ = config->sample_rate / 2;
-        pdm_mic.filters[i].HP_HZ = 10;
-        pdm_mic.filters[i].In_MicChannels = 1;
-        pdm_mic.filters[i].Out_MicChannels = 1;
-        pdm_mic.filters[i].Decimation = PDM_DECIMATION;
-        pdm_mic.filters[i].MaxVolume = 64;
-        pdm_mic.filters[i].Gain = 16;
-    }
-
-    pdm_mic.filter_volume = pdm_mic.filters[0].MaxVolume;
-}
+        dma_channel_set_irq0_enabled(mic->dma_channel_a[lane], false);
+        dma_channel_set_irq1_enabled(mic->dma_channel_b[lane], false);
 
-void pdm_microphone_deinit() {
-    if (pdm_mic.raw_buffer) {
-        free(pdm_mic.raw_buffer);
+        dma_channel_abort(mic->dma_channel_a[lane]);
+        dma_channel_abort(mic->dma_channel_b[lane]);
+
+        // aborting may still raise a completion
+        dma_hw->ints0 = (1u << mic->dma_channel_a[lane]);
+        dma_hw->ints1 = (1u << mic->dma_channel_b[lane]);
+    }
+
+    mic->running = false;
 
-        pdm_mic.raw_buffer = NULL;
+    if (mic->config.free_running) {
+        return;
     }
 
-    if (pdm_mic.dma_channel_a > -1) {
-        dma_channel_unclaim(pdm_mic.dma_channel_a);
-        pdm_mic.dma_channel_a = -1;
+    for (uint i = 0; i < PDM_MICROPHONE_INSTANCES_MAX; i++) {
+        if (pdm_microphone_running[i] == mic) {
+            pdm_microphone_running[i] = NULL;
+        }
     }
-    if (pdm_mic.dma_channel_b > -1) {
-        dma_channel_unclaim(pdm_mic.dma_channel_b);
-        pdm_mic.dma_channel_b = -1;
+
+    // the IRQ lines stay enabled, they may be shared with other drivers
+    if (--pdm_microphone_n_running == 0) {
+        irq_remove_handler(DMA_IRQ_0, pdm_microphone_dma_irq_handler);
+        irq_remove_handler(DMA_IRQ_1, pdm_microphone_dma_irq_handler);
     }
 }
 
 int pdm_microphone_start() {
-    irq_set_enabled(pdm_mic.dma_irq_a, true);
-    irq_set_exclusive_handler(pdm_mic.dma_irq_a, pdm_dma_handler);
-    irq_set_enabled(pdm_mic.dma_irq_b, true);
-    irq_set_exclusive_handler(pdm_mic.dma_irq_b, pdm_dma_handler);
-
-    dma_channel_set_irq0_enabled(pdm_mic.dma_channel_a, true);
-    dma_channel_set_irq1_enabled(pdm_mic.dma_channel_b, true);
-
-    // TODO: avoid four separate filters
-    for (uint i = 0; i < N_CHANNELS; i++) {
-        Open_PDM_Filter_Init(&pdm_mic.filters[i]);
-    }
-
-    pio_sm_set_enabled(
-        pdm_mic.config.pio,
-        pdm_mic.config.pio_sm,
-        true
-    );
-
-    pdm_mic.raw_buffer_write_index_a = 0;
-    pdm_mic.raw_buffer_write_index_b = 1;
-
-    dma_channel_transfer_to_buffer_now(
-        pdm_mic.dma_channel_a,
-        pdm_mic.raw_buffer + pdm_mic.raw_buffer_size*pdm_mic.raw_buffer_write_index_a,
-        pdm_mic.raw_buffer_size/N_CHANNELS
-    );
-    // dma_channel_transfer_to_buffer_now(
-    //     pdm_mic.dma_channel_b,
-    //     pdm_mic.raw_buffers[pdm_mic.raw_buffer_write_index_b],
-    //     pdm_mic.raw_buffer_size/N_CHANNELS
-    // );
-
-    pio_sm_set_enabled(
-        pdm_mic.config.pio,
-        pdm_mic.config.pio_sm,
-        true
-    );
+    return pdm_microphone_instance_start(&pdm_mic);
 }
 
 void pdm_microphone_stop() {
-    pio_sm_set_enabled(
-        pdm_mic.config.pio,
-        pdm_mic.config.pio_sm,
-        false
-    );
-
-    dma_channel_abort(pdm_mic.dma_channel_a);
-    dma_channel_abort(pdm_mic.dma_channel_b);
-
-    dma_channel_set_irq0_enabled(pdm_mic.dma_channel_a, false);
-    dma_channel_set_irq1_enabled(pdm_mic.dma_channel_b, false);
-
-    irq_set_enabled(pdm_mic.dma_irq_a, false);
-    irq_set_enabled(pdm_mic.dma_irq_b, false);
-}
-
-static void pdm_dma_handler() {
-    // identify channel
-    int channel;
-    if (dma_hw->ints0 & (1u << pdm_mic.dma_channel_a))
-        channel = pdm_mic.dma_channel_a;
-    else if (dma_hw->ints1 & (1u << pdm_mic.dma_channel_b))
-        channel = pdm_mic.dma_channel_b;
-    else __breakpoint();
-
-    // clear IRQ
-    if (channel == pdm_mic.dma_channel_a) {
-        dma_hw->ints0 = (1u << channel);
-    } else if (channel == pdm_mic.dma_channel_b) {
-        dma_hw->ints1 = (1u << channel);
-    } else __breakpoint();
-
-    // get the next capture index to send the dma to start
-    if (channel == pdm_mic.dma_channel_a)
-        pdm_mic.raw_buffer_write_index_a = (pdm_mic.raw_buffer_write_index_a + 2) % PDM_RAW_BUFFER_COUNT;
-    else if (channel == pdm_mic.dma_channel_b)
-        pdm_mic.raw_buffer_write_index_b = (pdm_mic.raw_buffer_write_index_b + 2) % PDM_RAW_BUFFER_COUNT;
-
-    // // give the channel a new buffer to write to and re-trigger it
-    // dma_channel_transfer_to_buffer_now(
-    //     channel,
-    //     pdm_mic.raw_buffers[raw_buffer_write_index],
-    //     pdm_mic.raw_buffer_size/N_CHANNELS
-    // );
-    if (channel == pdm_mic.dma_channel_a)
-        dma_channel_configure(
-            pdm_mic.dma_channel_a,
-            &pdm_mic.dma_channel_a_cfg,
-            pdm_mic.raw_buffer + pdm_mic.raw_buffer_size*pdm_mic.raw_buffer_write_index_a,
-            &pdm_mic.config.pio->rxf[pdm_mic.config.pio_sm],
-            pdm_mic.raw_buffer_size/N_CHANNELS,
-            false
-        );
-    else if (channel == pdm_mic.dma_channel_b)
-        dma_channel_configure(
-            pdm_mic.dma_channel_b,
-            &pdm_mic.dma_channel_b_cfg,
-            pdm_mic.raw_buffer + pdm_mic.raw_buffer_size*pdm_mic.raw_buffer_write_index_b,
-            &pdm_mic.config.pio->rxf[pdm_mic.config.pio_sm],
-            pdm_mic.raw_buffer_size/N_CHANNELS,
-            false
-        );
+    pdm_microphone_instance_stop(&pdm_mic);
+}
 
-    if (pdm_mic.samples_ready_handler) {
-        pdm_mic.samples_ready_handler();
-    }
+// PIO cycles per PDM bit, for pdm_clock_plan(); all capture programs take the same
+uint pdm_microphone_cycles_per_bit() {
+    return pdm_microphone_data_n1_program.length;
+}
+
+// divider, achieved sample rate and jitter of the running configuration
+const struct pdm_clock_config* pdm_microphone_instance_get_clock(pdm_microphone_t* mic) {
+    return &mic->clock;
+}
+
+const struct pdm_clock_config* pdm_microphone_get_clock() {
+    return pdm_microphone_instance_get_clock(&pdm_mic);
+}
+
+void pdm_microphone_instance_set_samples_ready_handler(pdm_microphone_t* mic, pdm_microphone_samples_ready_handler_t handler, void* context) {
+    mic->samples_ready_handler = handler;
+    mic->samples_ready_context = context;
+}
+
+static void pdm_mic_samples_ready(pdm_microphone_t* mic, void* context) {
+    pdm_mic_samples_ready_handler();
 }
 
 void pdm_microphone_set_samples_ready_handler(pdm_samples_ready_handler_t handler) {
-    pdm_mic.samples_ready_handler = handler;
+    pdm_mic_samples_ready_handler = handler;
+    pdm_microphone_instance_set_samples_ready_handler(&pdm_mic, handler ? pdm_mic_samples_ready : NULL, NULL);
+}
+
+void pdm_microphone_instance_set_filter_max_volume(pdm_microphone_t* mic, uint8_t max_volume) {
+    mic->filter.MaxVolume = max_volume;
+    mic->decimator.max_volume = max_volume;
+}
+
+void pdm_microphone_instance_set_filter_gain(pdm_microphone_t* mic, uint8_t gain) {
+    mic->filter.Gain = gain;
+    mic->decimator.gain = gain;
+}
+
+void pdm_microphone_instance_set_filter_volume(pdm_microphone_t* mic, uint16_t volume) {
+    mic->filter_volume = volume;
+}
+
+void pdm_microphone_instance_set_read_mode(pdm_microphone_t* mic, enum pdm_microphone_read_mode read_mode) {
+    mic->config.read_mode = read_mode;
+}
+
+// complete raw buffers (or PCM frames, when eager) the reader has not
+// reached yet (at most raw_buffer_count - 2, or pcm_buffer_count - 2)
+uint pdm_microphone_instance_blocks_available(pdm_microphone_t* mic) {
+    pdm_microphone_poll(mic);
+
+    return pdm_ring_available(pdm_microphone_eager(mic) ? &mic->pcm_ring : &mic->ring);
+}
+
+static void pdm_microphone_ring_stats(const struct pdm_ring* ring, struct pdm_microphone_ring_stats* stats) {
+    stats->blocks_written = ring->written;
+    stats->blocks_read = ring->read;
+    stats->overruns = ring->overruns;
+    stats->underruns = ring->underruns;
+    stats->blocks_dropped = ring->dropped;
+    stats->blocks_repeated = ring->repeated;
+}
+
+void pdm_microphone_instance_get_ring_stats(pdm_microphone_t* mic, struct pdm_microphone_ring_stats* stats) {
+    pdm_microphone_poll(mic);
+    pdm_microphone_ring_stats(&mic->ring, stats);
+}
+
+// eager: the same for the PCM frames
+void pdm_microphone_instance_get_pcm_ring_stats(pdm_microphone_t* mic, struct pdm_microphone_ring_stats* stats) {
+    pdm_microphone_ring_stats(&mic->pcm_ring, stats);
+}
+
+void pdm_microphone_instance_get_timing(pdm_microphone_t* mic, struct pdm_microphone_timing* timing) {
+    *timing = mic->timing;
+
+    if (timing->latency_min_us > timing->latency_max_us) {
+        timing->latency_min_us = 0;
+    }
+}
+
+void pdm_microphone_instance_get_health(pdm_microphone_t* mic, struct pdm_microphone_health* health) {
+    pdm_microphone_instance_get_ring_stats(mic, &health->ring);
+    pdm_microphone_ring_stats(&mic->pcm_ring, &health->pcm_ring);
+    health->saturated = mic->saturated;
+    health->late_irqs = mic->late_irqs;
+    health->gated = mic->gated;
+    memcpy(health->distance, mic->distance, sizeof(health->distance));
+}
+
+void pdm_microphone_instance_reset_timing(pdm_microphone_t* mic) {
+    memset(&mic->timing, 0x00, sizeof(mic->timing));
+    mic->timing.latency_min_us = UINT32_MAX;
 }
 
 void pdm_microphone_set_filter_max_volume(uint8_t max_volume) {
-    pdm_mic.filters[0].MaxVolume = max_volume;
+    pdm_microphone_instance_set_filter_max_volume(&pdm_mic, max_volume);
 }
 
 void pdm_microphone_set_filter_gain(uint8_t gain) {
-    pdm_mic.filters[0].Gain = gain;
+    pdm_microphone_instance_set_filter_gain(&pdm_mic, gain);
 }
 
 void pdm_microphone_set_filter_volume(uint16_t volume) {
-    pdm_mic.filter_volume = volume;
+    pdm_microphone_instance_set_filter_volume(&pdm_mic, volume);
 }
 
-// morton_even - extract even bits
-uint16_t morton_even(uint32_t x)
-{
-    x = x & 0x55555555;
-    x = (x | (x >> 1)) & 0x33333333;
-    x = (x | (x >> 2)) & 0x0F0F0F0F;
-    x = (x | (x >> 4)) & 0x00FF00FF;
-    x = (x | (x >> 8)) & 0x0000FFFF;
-    return (uint16_t)x;
+void pdm_microphone_set_read_mode(enum pdm_microphone_read_mode read_mode) {
+    pdm_microphone_instance_set_read_mode(&pdm_mic, read_mode);
 }
 
-// morton2 - extract odd and even bits
-void morton2(uint16_t *x, uint16_t *y, uint32_t z)
-{
-    *x = morton_even(z);
-    *y = morton_even(z >> 1);
+uint pdm_microphone_blocks_available() {
+    return pdm_microphone_instance_blocks_available(&pdm_mic);
 }
 
-// morton_fourth - extract every fourth bit
-uint8_t morton_fourth(uint32_t x)
-{
-    x = x & 0x11111111;
-    x = (x | (x >>  3)) & 0x03030303;
-    x = (x | (x >>  6)) & 0x000F000F;
-    x = (x | (x >> 12)) & 0x000000FF;
-    return (uint8_t)x;
+void pdm_microphone_get_ring_stats(struct pdm_microphone_ring_stats* stats) {
+    pdm_microphone_instance_get_ring_stats(&pdm_mic, stats);
 }
 
-// morton4 - de-interleave 4 channels
-void morton4(uint8_t *a, uint8_t *b, uint8_t *c, uint8_t *d, uint32_t z)
-{
-    *a = morton_fourth(z);
-    *b = morton_fourth(z >> 1);
-    *c = morton_fourth(z >> 2);
-    *d = morton_fourth(z >> 3);
+void pdm_microphone_get_pcm_ring_stats(struct pdm_microphone_ring_stats* stats) {
+    pdm_microphone_instance_get_pcm_ring_stats(&pdm_mic, stats);
 }
 
-// temporary de-interleaving buffer
-#define MAX_SAMPLE_RATE 192000
-uint8_t tmp_buffer[N_CHANNELS][(MAX_SAMPLE_RATE/1000) * (PDM_DECIMATION / 8)];
+void pdm_microphone_get_timing(struct pdm_microphone_timing* timing) {
+    pdm_microphone_instance_get_timing(&pdm_mic, timing);
+}
 
-#ifndef USB_IS_SLOWER
-int raw_buffer_read_index = PDM_RAW_BUFFER_COUNT/2;
-#elif   USB_IS_SLOWER == true
-int raw_buffer_read_index = PDM_RAW_BUFFER_COUNT-2;
-#elif   USB_IS_SLOWER == false
-int raw_buffer_read_index = 2;
-#endif
+void pdm_microphone_get_health(struct pdm_microphone_health* health) {
+    pdm_microphone_instance_get_health(&pdm_mic, health);
+}
 
-int pdm_microphone_read(int16_t* buffer, size_t raw_n_samples) {
-    int filter_stride = (pdm_mic.filters[0].Fs / 1000);
-    size_t n_samples = (raw_n_samples / filter_stride) * filter_stride;
+void pdm_microphone_reset_timing() {
+    pdm_microphone_instance_reset_timing(&pdm_mic);
+}
 
-    if (n_samples > pdm_mic.config.sample_buffer_size) {
-        n_samples = pdm_mic.config.sample_buffer_size;
+// fills samples [done, n_samples) of every channel with silence
+static void pdm_microphone_silence(pdm_microphone_t* mic, void* buffer, size_t done, size_t n_samples, size_t stride, bool wide) {
+    for (uint j = 0; j < mic->config.channels; j++) {
+        if (wide) {
+            memset((int32_t*)buffer + j*stride + done, 0x00, (n_samples - done) * sizeof(int32_t));
+        } else {
+            memset((int16_t*)buffer + j*stride + done, 0x00, (n_samples - done) * sizeof(int16_t));
+        }
     }
+}
 
-    // compute max write index and read-to-write distance
-    const int raw_buffer_write_index = (pdm_mic.raw_buffer_write_index_a > pdm_mic.raw_buffer_write_index_a) ?
-        pdm_mic.raw_buffer_write_index_a : pdm_mic.raw_buffer_write_index_b;
-    int write_to_read = raw_buffer_read_index-raw_buffer_write_index;
-    write_to_read = (write_to_read < -PDM_RAW_BUFFER_COUNT/2) ? write_to_read + PDM_RAW_BUFFER_COUNT : write_to_read;
-    write_to_read = (write_to_read > +PDM_RAW_BUFFER_COUNT/2) ? write_to_read - PDM_RAW_BUFFER_COUNT : write_to_read;
+#define PDM_MICROPHONE_SILENCE -2
 
-    // if write buffer gets too close to read buffer
-    if (write_to_read > -2 && write_to_read < 2) {
-#ifndef USB_IS_SLOWER
-        raw_buffer_read_index = (raw_buffer_write_index+PDM_RAW_BUFFER_COUNT/2)%PDM_RAW_BUFFER_COUNT;
-#elif   USB_IS_SLOWER == true
-        raw_buffer_read_index = (raw_buffer_write_index-2+PDM_RAW_BUFFER_COUNT)%PDM_RAW_BUFFER_COUNT;
-#elif   USB_IS_SLOWER == false
-        raw_buffer_read_index = (raw_buffer_write_index+2+PDM_RAW_BUFFER_COUNT)%PDM_RAW_BUFFER_COUNT;
-#endif
+// the reader takes chunk samples per channel, done of them into the read so far,
+// from offset on in a block; info (if any) describes the read
+static void pdm_microphone_track(pdm_microphone_t* mic, struct pdm_microphone_read_info* info,
+                                 const struct pdm_microphone_block_info* block, uint offset, size_t done, size_t chunk) {
+    const uint64_t sample = block->sample + offset;
+
+    if (info == NULL) {
+        return;
     }
 
-    // de-interleave
-    uint32_t* read_raw_buffer = (uint32_t*)(pdm_mic.raw_buffer + pdm_mic.raw_buffer_size*raw_buffer_read_index);
-    void* edit_tmp_buffers[N_CHANNELS];
-    for (int j = 0; j < N_CHANNELS; j++) edit_tmp_buffers[j] = (void*)tmp_buffer[j];
-#if N_CHANNELS == 1
-    // pass through
-#elif N_CHANNELS == 2
-    for (uint i = 0; i < pdm_mic.raw_buffer_size*sizeof(uint8_t)/sizeof(uint32_t); i++) {
-        morton2(
-            (uint16_t*)edit_tmp_buffers[0] + i,
-            (uint16_t*)edit_tmp_buffers[1] + i,
-            *(read_raw_buffer + i)
-        );
+    if (done == 0) {
+        info->sample = sample;
+        info->time_us = block->time_us;
     }
-#elif N_CHANNELS == 4
-    for (uint i = 0; i < pdm_mic.raw_buffer_size*sizeof(uint8_t)/sizeof(uint32_t); i++) {
-        morton4(
-            (uint8_t*)edit_tmp_buffers[0] + i,
-            (uint8_t*)edit_tmp_buffers[1] + i,
-            (uint8_t*)edit_tmp_buffers[2] + i,
-            (uint8_t*)edit_tmp_buffers[3] + i,
-            *(read_raw_buffer + i)
-        );
+    if (sample != mic->next_sample) {
+        info->discontinuous = true;
     }
-#else
-#error "Unsupported N_CHANNELS value!"
-#endif
 
-    for (int j = 0; j < N_CHANNELS; j++) {
-#if N_CHANNELS == 1
-        uint8_t* in = (uint8_t*)read_raw_buffer;
-#else
-        uint8_t* in = (uint8_t*)tmp_buffer[j];
-#endif
-        uint16_t* out = buffer+j*raw_n_samples; // TODO: int or uint?
-
-        for (int i = 0; i < n_samples; i += filter_stride) {
-#if PDM_DECIMATION == 48
-            Open_PDM_Filter_48(in, out, pdm_mic.filter_volume, &pdm_mic.filters[j]);
-#elif PDM_DECIMATION == 64
-            Open_PDM_Filter_64(in, out, pdm_mic.filter_volume, &pdm_mic.filters[j]);
-#elif PDM_DECIMATION == 128
-            Open_PDM_Filter_128(in, out, pdm_mic.filter_volume, &pdm_mic.filters[j]);
-#else
-            #error "Unsupported PDM_DECIMATION value!"
-#endif
+    mic->next_sample = sample + chunk;
+}
+
+// samples the filters clipped to their limits, in the channels they filtered
+static uint32_t pdm_microphone_clipped(int16_t* out[], uint channels, size_t n_samples) {
+    uint32_t n = 0;
+
+    for (uint j = 0; j < channels; j++) {
+        for (size_t i = 0; out[j] && i < n_samples; i++) {
+            n += (out[j][i] >= 32700 || out[j][i] <= -32700);
+        }
+    }
+
+    return n;
+}
+
+static uint32_t pdm_microphone_clipped32(int32_t* out[], uint channels, size_t n_samples) {
+    uint32_t n = 0;
+
+    for (uint j = 0; j < channels; j++) {
+        for (size_t i = 0; out[j] && i < n_samples; i++) {
+            n += (out[j][i] == INT32_MAX || out[j][i] <= -INT32_MAX);
+        }
+    }
+
+    return n;
+}
+
+// the reader is done with a block completed at time
+static void pdm_microphone_latency(pdm_microphone_t* mic, uint64_t time) {
+    const uint32_t latency = time_us_64() - time;
+
+    if (latency < mic->timing.latency_min_us) {
+        mic->timing.latency_min_us = latency;
+    }
+    if (latency > mic->timing.latency_max_us) {
+        mic->timing.latency_max_us = latency;
+    }
+}
+
+// index of the next raw buffer (or PCM frame) to read from ring, after
+// waiting for or replaying them as read_mode says if the reader caught up with
+// the writer; -1 if the read ends here, PDM_MICROPHONE_SILENCE if nothing was
+// written yet to replay
+static int pdm_microphone_acquire(pdm_microphone_t* mic, struct pdm_ring* ring, enum pdm_microphone_read_mode read_mode) {
+    pdm_microphone_poll(mic);
+    int index = pdm_ring_acquire(ring);
+
+    while (index < 0) {
+        if (read_mode == PDM_MICROPHONE_READ_BLOCKING && mic->running) {
+            const uint32_t written = ring->written;
+
+            pdm_ring_underrun(ring, false);
+            do {
+                tight_loop_contents();
+                pdm_microphone_poll(mic);
+            } while (ring->written == written && mic->running);
+        } else if (read_mode == PDM_MICROPHONE_READ_REPEAT) {
+            pdm_ring_underrun(ring, true);
+            if (ring->written == 0) {
+                return PDM_MICROPHONE_SILENCE;
+            }
+        } else {
+            pdm_ring_underrun(ring, false);
+
+            return -1;
+        }
+
+        index = pdm_ring_acquire(ring);
+    }
+
+    return index;
+}
+
+#define PDM_MICROPHONE_GATE_POINTS 4 // output samples per raw buffer the activity is measured at
+#define PDM_MICROPHONE_GATE_PRIME 24 // output samples a reopened channel's filter runs over before its raw buffer
+
+static const uint8_t pdm_microphone_popcount4[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+// channel j's activity in raw buffer index (see struct pdm_microphone_config),
+// from the 1s in a few samples spread over it, moving the channel's mean
+// density toward them
+static uint32_t pdm_microphone_activity(pdm_microphone_t* mic, int index, uint j) {
+    const uint size = mic->config.sample_buffer_size;
+    const uint n = (size < PDM_MICROPHONE_GATE_POINTS) ? size : PDM_MICROPHONE_GATE_POINTS;
+    const uint8_t* data = pdm_microphone_lane_buffer(mic, mic->config.planar ? j : 0, index);
+    // channel j's bits in each byte of the bit-interleaved stream
+    uint8_t mask = 0xFF;
+    int32_t sum = 0;
+    uint32_t square = 0;
+
+    if (!mic->config.planar && mic->config.channels == 2) {
+        mask = 0x55 << j;
+    } else if (!mic->config.planar && mic->config.channels == 4) {
+        mask = 0x11 << j;
+    }
+
+    for (uint k = 0; k < n; k++) {
+        const uint8_t* sample = data + (size - 1 - k*(size / n))*mic->lane_sample_size;
+        int32_t ones = 0;
+
+        for (uint i = 0; i < mic->lane_sample_size; i++) {
+            const uint8_t bits = sample[i] & mask;
+
+            ones += pdm_microphone_popcount4[bits & 0xF] + pdm_microphone_popcount4[bits >> 4];
+        }
+
+        const int32_t deviation = (ones << 4) - mic->gate_mean[j];
+
+        sum += deviation;
+        square += deviation * deviation;
+    }
+
+    mic->gate_mean[j] += sum / (int32_t)n / 8;
+
+    return square / n / 16;
+}
 
-            in += filter_stride * (PDM_DECIMATION / 8);
-            out += filter_stride;
+// decides which channels to filter in raw buffer index (the ring's read one):
+// channels open at once on activity and close after gate_hold quiet raw buffers.
+// The filters hold a gated channel's state, so one that reopens first runs over
+// the end of the previous raw buffer (if the DMA has not reused it yet) to pick
+// up where the signal is now.
+static void pdm_microphone_gate(pdm_microphone_t* mic, int index) {
+    const uint32_t read = mic->ring.read;
+    uint8_t opened = 0;
+
+    for (uint j = 0; j < mic->config.channels; j++) {
+        const uint32_t activity = pdm_microphone_activity(mic, index, j);
+        const uint8_t bit = 1u << j;
+
+        if (activity >= mic->config.gate_open_level) {
+            opened |= mic->gate_closed & bit;
+            mic->gate_closed &= ~bit;
+            mic->gate_quiet[j] = 0;
+        } else if (activity >= mic->config.gate_close_level) {
+            mic->gate_quiet[j] = 0;
+        } else if (mic->gate_quiet[j] < mic->config.gate_hold && ++mic->gate_quiet[j] == mic->config.gate_hold) {
+            mic->gate_closed |= bit;
+        }
+
+        if (mic->gate_closed & bit) {
+            mic->gated++;
+        }
+    }
+
+    if (opened && read > 0 && mic->ring.written - read < mic->raw_buffer_count - 2) {
+        const uint n = (mic->config.sample_buffer_size < PDM_MICROPHONE_GATE_PRIME) ? mic->config.sample_buffer_size : PDM_MICROPHONE_GATE_PRIME;
+        const int previous = (read - 1) % mic->raw_buffer_count;
+        int32_t scratch[PDM_MICROPHONE_GATE_PRIME];
+        uint8_t* in[PDM_CHANNELS_MAX];
+        int32_t* out[PDM_CHANNELS_MAX];
+
+        for (uint lane = 0; lane < mic->n_lanes; lane++) {
+            in[lane] = pdm_microphone_lane_buffer(mic, lane, previous) + (mic->config.sample_buffer_size - n)*mic->lane_sample_size;
+        }
+        for (uint j = 0; j < mic->config.channels; j++) {
+            out[j] = (opened & (1u << j)) ? scratch : NULL;
+        }
+
+        // the state is the same for both kernels, so this primes either
+        mic->filter32_kernel(mic, in, out, n, mic->filter_volume);
+    }
+}
+
+// filters up to n_samples samples per channel from the read position into
+// buffer + j*stride for channel j (int32_t Q31 samples if wide, else int16_t),
+// tracking the reader's position in info unless NULL; returns how many, fewer
+// only if read_mode is PDM_MICROPHONE_READ_NONBLOCKING
+static size_t pdm_microphone_filter(pdm_microphone_t* mic, void* buffer, size_t n_samples, size_t stride, bool wide,
+                                    enum pdm_microphone_read_mode read_mode, struct pdm_microphone_read_info* info) {
+    const uint channels = mic->config.channels;
+    size_t done = 0;
+
+    while (done < n_samples) {
+        const uint32_t read = mic->ring.read;
+        const int raw_buffer_read_index = pdm_microphone_acquire(mic, &mic->ring, read_mode);
+
+        if (raw_buffer_read_index == PDM_MICROPHONE_SILENCE) {
+            pdm_microphone_silence(mic, buffer, done, n_samples, stride, wide);
+            if (info) {
+                info->discontinuous = true;
+            }
+
+            return n_samples;
+        }
+        if (raw_buffer_read_index < 0) {
+            return done;
+        }
+
+        // resynced: start at the beginning of the new raw buffer
+        if (mic->ring.read != read) {
+            mic->raw_buffer_read_offset = 0;
+        }
+
+        // filter straight from the (bit-interleaved or planar) raw buffer, up to the end of the current raw buffer
+        size_t chunk = mic->config.sample_buffer_size - mic->raw_buffer_read_offset;
+        if (chunk > n_samples - done) {
+            chunk = n_samples - done;
+        }
+
+        pdm_microphone_track(mic, info, &mic->block_info[raw_buffer_read_index], mic->raw_buffer_read_offset, done, chunk);
+
+        uint8_t* in[PDM_CHANNELS_MAX];
+        for (uint lane = 0; lane < mic->n_lanes; lane++) {
+            in[lane] = pdm_microphone_lane_buffer(mic, lane, raw_buffer_read_index) + mic->raw_buffer_read_offset*mic->lane_sample_size;
+        }
+
+        if (mic->config.gate_open_level && mic->raw_buffer_read_offset == 0) {
+            pdm_microphone_gate(mic, raw_buffer_read_index);
+        }
+
+        // gated channels read as 0, and the kernels skip their NULL outputs
+        const uint8_t gated = mic->gate_closed;
+        const bool all_gated = (gated == (1u << channels) - 1);
+
+        PDM_PROFILE_BEGIN(start);
+        if (wide) {
+            int32_t* out[PDM_CHANNELS_MAX];
+            for (uint j = 0; j < channels; j++) {
+                out[j] = (int32_t*)buffer + j*stride + done;
+                if (gated & (1u << j)) {
+                    memset(out[j], 0x00, chunk * sizeof(int32_t));
+                    out[j] = NULL;
+                }
+            }
+
+            if (!all_gated) {
+                mic->filter32_kernel(mic, in, out, chunk, mic->filter_volume);
+                mic->saturated += pdm_microphone_clipped32(out, channels, chunk);
+            }
+        } else {
+            int16_t* out[PDM_CHANNELS_MAX];
+            for (uint j = 0; j < channels; j++) {
+                out[j] = (int16_t*)buffer + j*stride + done;
+                if (gated & (1u << j)) {
+                    memset(out[j], 0x00, chunk * sizeof(int16_t));
+                    out[j] = NULL;
+                }
+            }
+
+            if (!all_gated) {
+                mic->filter_kernel(mic, in, out, chunk, mic->filter_volume);
+                mic->saturated += pdm_microphone_clipped(out, channels, chunk);
+            }
+        }
+        PDM_PROFILE_END(PDM_PROFILE_FILTER, start);
+
+        done += chunk;
+        mic->raw_buffer_read_offset += chunk;
+        if (mic->raw_buffer_read_offset == mic->config.sample_buffer_size) {
+            mic->raw_buffer_read_offset = 0;
+            if (!pdm_microphone_eager(mic)) {
+                pdm_microphone_latency(mic, mic->block_info[raw_buffer_read_index].time_us);
+            }
+            pdm_ring_release(&mic->ring);
+        }
+    }
+
+    return done;
+}
+
+// eager: filters every complete raw buffer of mic into the next PCM frame
+static void pdm_microphone_process(pdm_microphone_t* mic) {
+    const size_t frame_size = mic->config.sample_buffer_size;
+    const uint32_t start = time_us_32();
+    bool busy = false;
+
+    pdm_microphone_poll(mic);
+
+    // only what is there now, so the pass ends even if the filter falls behind
+    for (uint n = pdm_ring_available(&mic->ring); n > 0; n--) {
+        const int index = mic->pcm_ring.written % mic->pcm_ring.count;
+
+        if (pdm_microphone_filter(mic, pdm_microphone_pcm_frame(mic, index, 0), frame_size, frame_size, true,
+                                  PDM_MICROPHONE_READ_NONBLOCKING, NULL) < frame_size) {
+            break;
+        }
+
+        mic->pcm_info[index] = mic->block_info[(mic->ring.read - 1) % mic->ring.count];
+        busy = true;
+
+        // the frame's samples before its sequence number
+        __dmb();
+        pdm_ring_publish(&mic->pcm_ring, mic->pcm_ring.written + 1);
+    }
+
+    // a whole pass, the burst the IRQ or core1 spends on one wakeup
+    const uint32_t elapsed = time_us_32() - start;
+    if (busy && elapsed > mic->timing.process_max_us) {
+        mic->timing.process_max_us = elapsed;
+    }
+}
+
+static void pdm_microphone_core1_entry() {
+    pdm_profile_init();
+
+    while (true) {
+        for (uint i = 0; i < PDM_MICROPHONE_INSTANCES_MAX; i++) {
+            pdm_microphone_t* mic = pdm_microphone_core1[i];
+
+            if (mic) {
+                pdm_microphone_process(mic);
+            }
+        }
+
+        pdm_microphone_core1_passes++;
+    }
+}
+
+// eager: copies up to n_samples samples per channel from the PCM frames the
+// IRQ or core1 filtered, like pdm_microphone_filter()
+static size_t pdm_microphone_copy(pdm_microphone_t* mic, void* buffer, size_t n_samples, size_t stride, bool wide,
+                                  enum pdm_microphone_read_mode read_mode, struct pdm_microphone_read_info* info) {
+    const size_t frame_size = mic->config.sample_buffer_size;
+    size_t done = 0;
+
+    while (done < n_samples) {
+        const uint32_t read = mic->pcm_ring.read;
+        const int index = pdm_microphone_acquire(mic, &mic->pcm_ring, read_mode);
+
+        if (index == PDM_MICROPHONE_SILENCE) {
+            pdm_microphone_silence(mic, buffer, done, n_samples, stride, wide);
+            if (info) {
+                info->discontinuous = true;
+            }
+
+            return n_samples;
+        }
+        if (index < 0) {
+            return done;
+        }
+
+        // the frame's samples after its sequence number
+        __dmb();
+
+        if (mic->pcm_ring.read != read) {
+            mic->pcm_read_offset = 0;
         }
+
+        size_t chunk = frame_size - mic->pcm_read_offset;
+        if (chunk > n_samples - done) {
+            chunk = n_samples - done;
+        }
+
+        pdm_microphone_track(mic, info, &mic->pcm_info[index], mic->pcm_read_offset, done, chunk);
+
+        for (uint j = 0; j < mic->config.channels; j++) {
+            const int32_t* in = pdm_microphone_pcm_frame(mic, index, j) + mic->pcm_read_offset;
+
+            if (wide) {
+                memcpy((int32_t*)buffer + j*stride + done, in, chunk * sizeof(int32_t));
+            } else {
+                int16_t* out = (int16_t*)buffer + j*stride + done;
+
+                for (size_t i = 0; i < chunk; i++) {
+                    out[i] = (in[i] > INT32_MAX - 0x8000) ? INT16_MAX : (in[i] + 0x8000) >> 16;
+                }
+            }
+        }
+
+        done += chunk;
+        mic->pcm_read_offset += chunk;
+        if (mic->pcm_read_offset == frame_size) {
+            mic->pcm_read_offset = 0;
+            pdm_microphone_latency(mic, mic->pcm_info[index].time_us);
+            pdm_ring_release(&mic->pcm_ring);
+        }
+    }
+
+    return done;
+}
+
+// produces n_samples samples at the reader's rate from the filtered PDM stream,
+// stride apart per channel, steering the resampling ratio so the read position
+// stays at the ASRC target
+static void pdm_microphone_resample(pdm_microphone_t* mic, void* buffer, size_t n_samples, size_t stride, bool wide,
+                                    struct pdm_microphone_read_info* info) {
+    // when eager, the clock domains meet at the PCM frames instead
+    struct pdm_ring* ring = pdm_microphone_eager(mic) ? &mic->pcm_ring : &mic->ring;
+    uint* read_offset = pdm_microphone_eager(mic) ? &mic->pcm_read_offset : &mic->raw_buffer_read_offset;
+    const int total = ring->count * mic->config.sample_buffer_size;
+    const int margin = 2 * mic->config.sample_buffer_size;
+
+    pdm_microphone_poll(mic);
+
+    const uint32_t blocks = ring->written - ring->read;
+    int fill = (blocks > ring->count) ? total : (int)(blocks * mic->config.sample_buffer_size - *read_offset);
+
+    // too close to the writer on either side (e.g. after a stall): restart at the target
+    if (fill < margin || fill > total - margin) {
+        if (fill < margin) {
+            ring->underruns++;
+        } else {
+            ring->overruns++;
+        }
+
+        pdm_ring_resync(ring, ring->count/2);
+        *read_offset = 0;
+        fill = mic->asrc.target_fill;
+        pdm_asrc_resync(&mic->asrc);
+    }
+
+    pdm_asrc_update(&mic->asrc, fill);
+
+    const size_t n_in = pdm_asrc_input_needed(&mic->asrc, n_samples);
+    if (pdm_microphone_eager(mic)) {
+        pdm_microphone_copy(mic, mic->asrc_buffer, n_in, mic->asrc_buffer_size, wide, PDM_MICROPHONE_READ_REPEAT, info);
+    } else {
+        pdm_microphone_filter(mic, mic->asrc_buffer, n_in, mic->asrc_buffer_size, wide, PDM_MICROPHONE_READ_REPEAT, info);
+    }
+
+    PDM_PROFILE_BEGIN(start);
+    if (wide) {
+        int32_t* in[PDM_CHANNELS_MAX];
+        int32_t* out[PDM_CHANNELS_MAX];
+        for (uint j = 0; j < mic->config.channels; j++) {
+            in[j] = mic->asrc_buffer + j*mic->asrc_buffer_size;
+            out[j] = (int32_t*)buffer + j*stride;
+        }
+
+        pdm_asrc_process32(&mic->asrc, in, out, n_samples);
+    } else {
+        int16_t* in[PDM_CHANNELS_MAX];
+        int16_t* out[PDM_CHANNELS_MAX];
+        for (uint j = 0; j < mic->config.channels; j++) {
+            in[j] = (int16_t*)mic->asrc_buffer + j*mic->asrc_buffer_size;
+            out[j] = (int16_t*)buffer + j*stride;
+        }
+
+        pdm_asrc_process(&mic->asrc, in, out, n_samples);
+    }
+    PDM_PROFILE_END(PDM_PROFILE_RESAMPLE, start);
+}
+
+// reads up to n_samples samples per channel, channel j at buffer + j * stride
+static int pdm_microphone_read_any(pdm_microphone_t* mic, void* buffer, size_t n_samples, size_t stride, bool wide,
+                                   struct pdm_microphone_read_info* info) {
+    const uint32_t start = time_us_32();
+    struct pdm_microphone_read_info unused;
+    PDM_PROFILE_BEGIN(profile_start);
+
+    // tracked either way, so a later read with info knows where the last one ended
+    if (info == NULL) {
+        info = &unused;
+    }
+    memset(info, 0x00, sizeof(*info));
+
+    pdm_microphone_poll(mic);
+    const struct pdm_ring* ring = pdm_microphone_eager(mic) ? &mic->pcm_ring : &mic->ring;
+    const uint32_t fill = ring->written - ring->read;
+    mic->distance[(fill < ring->count) ? fill * PDM_MICROPHONE_DISTANCE_BUCKETS / ring->count : PDM_MICROPHONE_DISTANCE_BUCKETS - 1]++;
+
+    if (mic->config.resample) {
+        if (n_samples > mic->config.sample_buffer_size) {
+            n_samples = mic->config.sample_buffer_size;
+        }
+
+        pdm_microphone_resample(mic, buffer, n_samples, stride, wide, info);
+    } else if (pdm_microphone_eager(mic)) {
+        n_samples = pdm_microphone_copy(mic, buffer, n_samples, stride, wide, mic->config.read_mode, info);
+    } else {
+        n_samples = pdm_microphone_filter(mic, buffer, n_samples, stride, wide, mic->config.read_mode, info);
     }
 
-    raw_buffer_read_index = (raw_buffer_read_index + 1) % PDM_RAW_BUFFER_COUNT;
+    // blocking reads include the wait
+    const uint32_t elapsed = time_us_32() - start;
+    if (elapsed > mic->timing.read_max_us) {
+        mic->timing.read_max_us = elapsed;
+    }
+    if (!pdm_microphone_eager(mic) && elapsed > mic->timing.process_max_us) {
+        mic->timing.process_max_us = elapsed;
+    }
+    PDM_PROFILE_END(PDM_PROFILE_READ, profile_start);
 
     return n_samples;
 }
+
+// at most a block, but the channels stay the caller's n_samples apart
+int pdm_microphone_instance_read(pdm_microphone_t* mic, int16_t* buffer, size_t n_samples) {
+    const size_t count = (n_samples > mic->config.sample_buffer_size) ? mic->config.sample_buffer_size : n_samples;
+
+    return pdm_microphone_read_any(mic, buffer, count, n_samples, false, NULL);
+}
+
+int pdm_microphone_instance_read_samples(pdm_microphone_t* mic, int16_t* buffer, size_t n_samples) {
+    return pdm_microphone_read_any(mic, buffer, n_samples, n_samples, false, NULL);
+}
+
+int pdm_microphone_instance_read32(pdm_microphone_t* mic, int32_t* buffer, size_t n_samples) {
+    const size_t count = (n_samples > mic->config.sample_buffer_size) ? mic->config.sample_buffer_size : n_samples;
+
+    return pdm_microphone_read_any(mic, buffer, count, n_samples, true, NULL);
+}
+
+int pdm_microphone_instance_read_samples32(pdm_microphone_t* mic, int32_t* buffer, size_t n_samples) {
+    return pdm_microphone_read_any(mic, buffer, n_samples, n_samples, true, NULL);
+}
+
+int pdm_microphone_instance_read_samples_info(pdm_microphone_t* mic, int16_t* buffer, size_t n_samples,
+                                              struct pdm_microphone_read_info* info) {
+    return pdm_microphone_read_any(mic, buffer, n_samples, n_samples, false, info);
+}
+
+int pdm_microphone_instance_read_samples32_info(pdm_microphone_t* mic, int32_t* buffer, size_t n_samples,
+                                                struct pdm_microphone_read_info* info) {
+    return pdm_microphone_read_any(mic, buffer, n_samples, n_samples, true, info);
+}
+
+int pdm_microphone_read(int16_t* buffer, size_t n_samples) {
+    return pdm_microphone_instance_read(&pdm_mic, buffer, n_samples);
+}
+
+int pdm_microphone_read_samples(int16_t* buffer, size_t n_samples) {
+    return pdm_microphone_instance_read_samples(&pdm_mic, buffer, n_samples);
+}
+
+int pdm_microphone_read32(int32_t* buffer, size_t n_samples) {
+    return pdm_microphone_instance_read32(&pdm_mic, buffer, n_samples);
+}
+
+int pdm_microphone_read_samples32(int32_t* buffer, size_t n_samples) {
+    return pdm_microphone_instance_read_samples32(&pdm_mic, buffer, n_samples);
+}
+
+int pdm_microphone_read_samples_info(int16_t* buffer, size_t n_samples, struct pdm_microphone_read_info* info) {
+    return pdm_microphone_instance_read_samples_info(&pdm_mic, buffer, n_samples, info);
+}
+
+int pdm_microphone_read_samples32_info(int32_t* buffer, size_t n_samples, struct pdm_microphone_read_info* info) {
+    return pdm_microphone_instance_read_samples32_info(&pdm_mic, buffer, n_samples, info);
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include "pico/pdm_microphone.h"
+
+static int pdm_microphone_source_start(struct audio_source* source) {
+    return pdm_microphone_instance_start(source->context);
+}
+
+static void pdm_microphone_source_stop(struct audio_source* source) {
+    pdm_microphone_instance_stop(source->context);
+}
+
+static int pdm_microphone_source_read(struct audio_source* source, int16_t* buffer, size_t n_samples) {
+    return pdm_microphone_instance_read_samples(source->context, buffer, n_samples);
+}
+
+static int pdm_microphone_source_read32(struct audio_source* source, int32_t* buffer, size_t n_samples) {
+    return pdm_microphone_instance_read_samples32(source->context, buffer, n_samples);
+}
+
+static uint32_t pdm_microphone_source_latency_us(struct audio_source* source) {
+    const uint64_t samples = (uint64_t)(pdm_microphone_instance_blocks_available(source->context) + 1) * source->sample_buffer_size;
+
+    return (samples * 1000000) / source->sample_rate;
+}
+
+// raw buffers and PCM frames both hold sample_buffer_size samples, so when
+// eager the two rings' skips add up as in the usb_microphone health report
+static void pdm_microphone_source_get_stats(struct audio_source* source, struct audio_source_stats* stats) {
+    struct pdm_microphone_health health;
+
+    pdm_microphone_instance_get_health(source->context, &health);
+
+    stats->blocks_written = health.ring.blocks_written;
+    stats->blocks_read = health.ring.blocks_read;
+    stats->overruns = health.ring.overruns + health.pcm_ring.overruns;
+    stats->underruns = health.ring.underruns + health.pcm_ring.underruns;
+    stats->blocks_dropped = health.ring.blocks_dropped + health.pcm_ring.blocks_dropped;
+    stats->blocks_repeated = health.ring.blocks_repeated + health.pcm_ring.blocks_repeated;
+    stats->saturated = health.saturated;
+}
+
+static void pdm_microphone_source_deinit(struct audio_source* source) {
+    pdm_microphone_destroy(source->context);
+
+    source->context = NULL;
+}
+
+static const struct audio_source_ops pdm_microphone_source_ops = {
+    .start = pdm_microphone_source_start,
+    .stop = pdm_microphone_source_stop,
+    .read = pdm_microphone_source_read,
+    .read32 = pdm_microphone_source_read32,
+    .latency_us = pdm_microphone_source_latency_us,
+    .get_stats = pdm_microphone_source_get_stats,
+    .deinit = pdm_microphone_source_deinit,
+};
+
+int pdm_microphone_source_init(struct audio_source* source, const struct pdm_microphone_config* config) {
+    pdm_microphone_t* mic = pdm_microphone_create(config);
+
+    if (mic == NULL) {
+        return -1;
+    }
+
+    source->ops = &pdm_microphone_source_ops;
+    source->context = mic;
+    source->name = "pdm";
+    source->channels = config->channels ? config->channels : PDM_CHANNELS;
+    source->sample_rate = config->sample_rate;
+    source->sample_buffer_size = config->sample_buffer_size;
+
+    return 0;
+}
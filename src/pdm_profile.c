@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <string.h>
+
+#include "pico/pdm_profile.h"
+
+#if PICO_ON_DEVICE
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+
+// SysTick counts clk_sys cycles down from its 24-bit reload value
+#define PDM_PROFILE_TICK_MASK 0x00FFFFFF
+#else
+#include <time.h>
+
+#define PDM_PROFILE_TICK_MASK 0xFFFFFFFF
+#endif
+
+static const char* const pdm_profile_stage_names[PDM_PROFILE_STAGES] = {
+    "dma_irq", "filter", "resample", "read", "interleave", "write",
+};
+
+#if PDM_PROFILE
+static struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t histogram[PDM_PROFILE_BUCKETS];
+} pdm_profile[PDM_PROFILE_STAGES];
+#endif
+
+void pdm_profile_init() {
+#if PDM_PROFILE && PICO_ON_DEVICE
+    systick_hw->rvr = PDM_PROFILE_TICK_MASK;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // enabled, on the processor clock, no exception
+#endif
+}
+
+uint32_t pdm_profile_now() {
+#if PICO_ON_DEVICE
+    return PDM_PROFILE_TICK_MASK - systick_hw->cvr;
+#else
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+
+    return (uint32_t)t.tv_sec * 1000000000u + (uint32_t)t.tv_nsec;
+#endif
+}
+
+uint32_t pdm_profile_tick_hz() {
+#if PICO_ON_DEVICE
+    return clock_get_hz(clk_sys);
+#else
+    return 1000000000u;
+#endif
+}
+
+const char* pdm_profile_stage_name(enum pdm_profile_stage stage) {
+    return (stage < PDM_PROFILE_STAGES) ? pdm_profile_stage_names[stage] : "?";
+}
+
+#if PDM_PROFILE
+// 0-3 one tick each, then 4 buckets per power of two
+static uint32_t pdm_profile_bucket(uint32_t ticks) {
+    if (ticks < 4) {
+        return ticks;
+    }
+
+    const uint32_t e = 31 - __builtin_clz(ticks);
+    const uint32_t bucket = (e - 1) * 4 + ((ticks >> (e - 2)) & 3);
+
+    return (bucket < PDM_PROFILE_BUCKETS) ? bucket : PDM_PROFILE_BUCKETS - 1;
+}
+#endif
+
+uint32_t pdm_profile_bucket_min(uint32_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+
+    return (4 + bucket % 4) << (bucket / 4 - 1);
+}
+
+void pdm_profile_end(enum pdm_profile_stage stage, uint32_t start) {
+#if PDM_PROFILE
+    const uint32_t ticks = (pdm_profile_now() - start) & PDM_PROFILE_TICK_MASK;
+
+    if (pdm_profile[stage].count == 0 || ticks < pdm_profile[stage].min) {
+        pdm_profile[stage].min = ticks;
+    }
+    if (ticks > pdm_profile[stage].max) {
+        pdm_profile[stage].max = ticks;
+    }
+    pdm_profile[stage].sum += ticks;
+    pdm_profile[stage].histogram[pdm_profile_bucket(ticks)]++;
+    pdm_profile[stage].count++;
+#else
+    (void)stage;
+    (void)start;
+#endif
+}
+
+void pdm_profile_reset() {
+#if PDM_PROFILE
+    memset(pdm_profile, 0x00, sizeof(pdm_profile));
+#endif
+}
+
+uint32_t pdm_profile_percentile(enum pdm_profile_stage stage, uint32_t percent) {
+#if PDM_PROFILE
+    const uint32_t count = pdm_profile[stage].count;
+    const uint32_t rank = ((uint64_t)count * percent + 99) / 100;
+    uint32_t seen = 0;
+
+    if (count == 0) {
+        return 0;
+    }
+
+    for (uint32_t bucket = 0; bucket < PDM_PROFILE_BUCKETS; bucket++) {
+        seen += pdm_profile[stage].histogram[bucket];
+
+        if (seen >= rank && seen > 0) {
+            const uint32_t end = pdm_profile_bucket_min(bucket + 1) - 1;
+
+            if (end > pdm_profile[stage].max) {
+                return pdm_profile[stage].max;
+            }
+
+            return (end < pdm_profile[stage].min) ? pdm_profile[stage].min : end;
+        }
+    }
+
+    return pdm_profile[stage].max;
+#else
+    (void)stage;
+    (void)percent;
+
+    return 0;
+#endif
+}
+
+bool pdm_profile_get_stats(enum pdm_profile_stage stage, struct pdm_profile_stats* stats) {
+    memset(stats, 0x00, sizeof(*stats));
+
+#if PDM_PROFILE
+    if (pdm_profile[stage].count == 0) {
+        return false;
+    }
+
+    stats->count = pdm_profile[stage].count;
+    stats->min = pdm_profile[stage].min;
+    stats->mean = pdm_profile[stage].sum / pdm_profile[stage].count;
+    stats->max = pdm_profile[stage].max;
+    stats->p50 = pdm_profile_percentile(stage, 50);
+    stats->p90 = pdm_profile_percentile(stage, 90);
+    stats->p99 = pdm_profile_percentile(stage, 99);
+
+    return true;
+#else
+    (void)stage;
+
+    return false;
+#endif
+}
+
+const uint32_t* pdm_profile_get_histogram(enum pdm_profile_stage stage) {
+#if PDM_PROFILE
+    return pdm_profile[stage].histogram;
+#else
+    static const uint32_t empty[PDM_PROFILE_BUCKETS];
+
+    (void)stage;
+
+    return empty;
+#endif
+}
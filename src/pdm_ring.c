@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <string.h>
+
+#include "pdm_ring.h"
+
+void pdm_ring_init(struct pdm_ring* ring, uint32_t count, uint32_t resync_fill) {
+    memset(ring, 0x00, sizeof(*ring));
+
+    ring->count = count;
+    ring->resync_fill = (resync_fill > count - 2) ? count - 2 : resync_fill;
+}
+
+// back to an empty ring, before the producer starts again
+void pdm_ring_reset(struct pdm_ring* ring) {
+    pdm_ring_init(ring, ring->count, ring->resync_fill);
+}
+
+// moves the reader fill raw buffers behind the given producer position (or
+// to the oldest one there is), accounting for what it skips or replays
+static void pdm_ring_resync_to(struct pdm_ring* ring, uint32_t written, uint32_t fill) {
+    const uint32_t read = written - ((fill < written) ? fill : written);
+
+    if ((int32_t)(read - ring->read) > 0) {
+        ring->dropped += read - ring->read;
+    } else {
+        ring->repeated += ring->read - read;
+    }
+
+    ring->read = read;
+}
+
+// raw buffers the consumer can read without waiting
+uint32_t pdm_ring_available(const struct pdm_ring* ring) {
+    const uint32_t fill = ring->written - ring->read;
+
+    return (fill > ring->count - 2) ? ring->count - 2 : fill;
+}
+
+// consumer: ring index of the next raw buffer to read, after resyncing if the
+// producer overran it; -1 if the producer has not completed it yet
+int pdm_ring_acquire(struct pdm_ring* ring) {
+    const uint32_t written = ring->written;
+
+    if (written - ring->read > ring->count - 2) {
+        ring->overruns++;
+        pdm_ring_resync_to(ring, written, ring->resync_fill);
+    }
+
+    if (written == ring->read) {
+        return -1;
+    }
+
+    return ring->read % ring->count;
+}
+
+// consumer: done with the raw buffer pdm_ring_acquire() returned
+void pdm_ring_release(struct pdm_ring* ring) {
+    ring->read++;
+}
+
+// consumer: pdm_ring_acquire() found nothing; if repeat, step back to replay
+// raw buffers instead of waiting for new ones
+void pdm_ring_underrun(struct pdm_ring* ring, bool repeat) {
+    ring->underruns++;
+
+    if (repeat) {
+        pdm_ring_resync_to(ring, ring->written, ring->resync_fill);
+    }
+}
+
+// consumer: restart fill raw buffers behind the producer (e.g. the resampler
+// drifting too close to it)
+void pdm_ring_resync(struct pdm_ring* ring, uint32_t fill) {
+    pdm_ring_resync_to(ring, ring->written, fill);
+}
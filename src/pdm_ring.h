@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _PDM_RING_H_
+#define _PDM_RING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Single-producer / single-consumer bookkeeping of the raw buffer ring.
+//
+// The DMA IRQ (producer) publishes each completed raw buffer by advancing a
+// free-running sequence number, and the reader (consumer) keeps its own.
+// Raw buffer s lives at index s % count. Both numbers only ever increase
+// (modulo 2^32), so the fill level is a plain subtraction and never
+// ambiguous. The DMA always holds two raw buffers, the one it is writing and
+// the one queued on its partner channel, so at most count - 2 are readable;
+// a reader further behind has been overrun.
+
+struct pdm_ring {
+    uint32_t count;
+    uint32_t resync_fill;      // raw buffers left behind the producer on resyncing
+    volatile uint32_t written; // producer: raw buffers completed
+    uint32_t read;             // consumer: next raw buffer to read
+    // consumer side accounting
+    uint32_t overruns;
+    uint32_t underruns;
+    uint32_t dropped;          // raw buffers skipped to recover from overruns
+    uint32_t repeated;         // raw buffers read again to recover from underruns
+};
+
+void pdm_ring_init(struct pdm_ring* ring, uint32_t count, uint32_t resync_fill);
+void pdm_ring_reset(struct pdm_ring* ring);
+
+// producer: written raw buffers are complete (only ever increases)
+static inline void pdm_ring_publish(struct pdm_ring* ring, uint32_t written) {
+    ring->written = written;
+}
+
+uint32_t pdm_ring_available(const struct pdm_ring* ring);
+
+int pdm_ring_acquire(struct pdm_ring* ring);
+void pdm_ring_release(struct pdm_ring* ring);
+void pdm_ring_underrun(struct pdm_ring* ring, bool repeat);
+void pdm_ring_resync(struct pdm_ring* ring, uint32_t fill);
+
+#endif
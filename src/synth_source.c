@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/synth_source.h"
+
+#include "pdm_decimator.h"
+
+#define SYNTH_SOURCE_SINE_BITS 10
+#define SYNTH_SOURCE_SINE_SIZE (1 << SYNTH_SOURCE_SINE_BITS)
+
+struct synth_source {
+    struct synth_source_config config; // with the defaults filled in
+    uint32_t phase[SYNTH_SOURCE_CHANNELS_MAX];
+    uint32_t phase_step[SYNTH_SOURCE_CHANNELS_MAX]; // per sample, or per PDM byte
+    uint32_t noise[SYNTH_SOURCE_CHANNELS_MAX];
+    int32_t error[SYNTH_SOURCE_CHANNELS_MAX][2]; // PDM modulator's last 2 quantization errors
+    struct pdm_decimator decimator;
+    uint8_t* pdm; // sample_buffer_size * decimation / 8 bytes per channel
+    uint64_t samples; // per channel, since the start
+};
+
+// one cycle, and the first sample again for the interpolation
+static int16_t synth_source_sine[SYNTH_SOURCE_SINE_SIZE + 1];
+
+static void synth_source_sine_init() {
+    if (synth_source_sine[SYNTH_SOURCE_SINE_SIZE / 4] != 0) {
+        return;
+    }
+
+    for (int i = 0; i <= SYNTH_SOURCE_SINE_SIZE; i++) {
+        synth_source_sine[i] = lroundf(32767.0f * sinf((float)(2 * M_PI) * i / SYNTH_SOURCE_SINE_SIZE));
+    }
+}
+
+// Q31 sine of phase (a full cycle is 2^32), linearly interpolated
+static inline int32_t synth_source_sine_q31(uint32_t phase) {
+    const uint32_t index = phase >> (32 - SYNTH_SOURCE_SINE_BITS);
+    const int32_t frac = (phase >> (16 - SYNTH_SOURCE_SINE_BITS)) & 0xFFFF;
+    const int32_t a = synth_source_sine[index];
+    const int32_t b = synth_source_sine[index + 1];
+
+    return (a << 16) + (b - a) * frac;
+}
+
+// xorshift32, as a full range signed value
+static inline int32_t synth_source_noise(uint32_t* state) {
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return (int32_t)x;
+}
+
+// the next sample of channel ch, in Q31 at amplitude
+static inline int32_t synth_source_next(struct synth_source* synth, uint ch) {
+    int32_t x;
+
+    if (synth->config.signal == SYNTH_SOURCE_NOISE) {
+        x = synth_source_noise(&synth->noise[ch]);
+    } else {
+        x = synth_source_sine_q31(synth->phase[ch]);
+        synth->phase[ch] += synth->phase_step[ch];
+    }
+
+    return ((int64_t)x * synth->config.amplitude) >> 15;
+}
+
+// PDM bit stream of n_samples output samples per channel, the MSB of each byte
+// first; the tone is held for the 8 bits of a byte
+static void synth_source_modulate(struct synth_source* synth, size_t n_samples) {
+    const size_t n_bytes = n_samples * synth->config.decimation / 8;
+
+    for (uint ch = 0; ch < synth->config.channels; ch++) {
+        uint8_t* out = synth->pdm + ch * (synth->config.sample_buffer_size * synth->config.decimation / 8);
+        int32_t e1 = synth->error[ch][0];
+        int32_t e2 = synth->error[ch][1];
+
+        for (size_t i = 0; i < n_bytes; i++) {
+            const int32_t x = synth_source_next(synth, ch) >> 16;
+            uint8_t byte = 0;
+
+            // noise transfer function (1 - z^-1)^2
+            for (int k = 0; k < 8; k++) {
+                const int32_t u = x - 2 * e1 + e2;
+                const uint32_t bit = ~(uint32_t)u >> 31; // branch-free: the bits are as good as random
+
+                byte = (byte << 1) | bit;
+                e2 = e1;
+                e1 = (int32_t)(bit << 16) - 32768 - u;
+            }
+
+            out[i] = byte;
+        }
+
+        synth->error[ch][0] = e1;
+        synth->error[ch][1] = e2;
+    }
+}
+
+// generates n_samples per channel into buffer (int16_t or int32_t)
+static int synth_source_generate(struct audio_source* source, void* buffer, size_t n_samples, bool q31) {
+    struct synth_source* synth = source->context;
+    const uint channels = synth->config.channels;
+
+    if (synth->config.signal == SYNTH_SOURCE_PDM) {
+        const size_t bytes_per_channel = synth->config.sample_buffer_size * synth->config.decimation / 8;
+
+        for (size_t done = 0; done < n_samples;) {
+            const size_t chunk = (n_samples - done < synth->config.sample_buffer_size) ? n_samples - done : synth->config.sample_buffer_size;
+            const uint8_t* in[SYNTH_SOURCE_CHANNELS_MAX];
+
+            synth_source_modulate(synth, chunk);
+
+            for (uint j = 0; j < channels; j++) {
+                in[j] = synth->pdm + j * bytes_per_channel;
+            }
+
+            if (q31) {
+                int32_t* out[SYNTH_SOURCE_CHANNELS_MAX];
+
+                for (uint j = 0; j < channels; j++) {
+                    out[j] = (int32_t*)buffer + j * n_samples + done;
+                }
+                pdm_decimator_process32(&synth->decimator, in, out, chunk, synth->decimator.max_volume);
+            } else {
+                int16_t* out[SYNTH_SOURCE_CHANNELS_MAX];
+
+                for (uint j = 0; j < channels; j++) {
+                    out[j] = (int16_t*)buffer + j * n_samples + done;
+                }
+                pdm_decimator_process(&synth->decimator, in, out, chunk, synth->decimator.max_volume);
+            }
+
+            done += chunk;
+        }
+    } else {
+        for (uint j = 0; j < channels; j++) {
+            if (q31) {
+                int32_t* out = (int32_t*)buffer + j * n_samples;
+
+                for (size_t i = 0; i < n_samples; i++) {
+                    out[i] = synth_source_next(synth, j);
+                }
+            } else {
+                int16_t* out = (int16_t*)buffer + j * n_samples;
+
+                // rounded as the PDM driver's int16_t reads of Q31 samples
+                for (size_t i = 0; i < n_samples; i++) {
+                    const int32_t x = synth_source_next(synth, j);
+
+                    out[i] = (x > 0x7FFF7FFF) ? 32767 : (x + 0x8000) >> 16;
+                }
+            }
+        }
+    }
+
+    synth->samples += n_samples;
+
+    return n_samples;
+}
+
+static int synth_source_start(struct audio_source* source) {
+    struct synth_source* synth = source->context;
+
+    for (uint ch = 0; ch < synth->config.channels; ch++) {
+        // the PDM modulator takes a new tone sample every byte
+        const uint64_t rate = (synth->config.signal == SYNTH_SOURCE_PDM) ?
+                              (uint64_t)synth->config.sample_rate * synth->config.decimation / 8 :
+                              synth->config.sample_rate;
+
+        synth->phase[ch] = 0;
+        synth->phase_step[ch] = (((uint64_t)synth->config.frequency * (ch + 1)) << 32) / rate;
+        synth->noise[ch] = synth->config.seed * (2 * ch + 1);
+        if (synth->noise[ch] == 0) {
+            synth->noise[ch] = 1;
+        }
+        synth->error[ch][0] = 0;
+        synth->error[ch][1] = 0;
+    }
+
+    if (synth->config.signal == SYNTH_SOURCE_PDM) {
+        pdm_decimator_reset(&synth->decimator);
+    }
+
+    synth->samples = 0;
+
+    return 0;
+}
+
+static void synth_source_stop(struct audio_source* source) {
+    (void)source;
+}
+
+static int synth_source_read(struct audio_source* source, int16_t* buffer, size_t n_samples) {
+    return synth_source_generate(source, buffer, n_samples, false);
+}
+
+static int synth_source_read32(struct audio_source* source, int32_t* buffer, size_t n_samples) {
+    return synth_source_generate(source, buffer, n_samples, true);
+}
+
+static uint32_t synth_source_latency_us(struct audio_source* source) {
+    (void)source;
+
+    return 0;
+}
+
+static void synth_source_get_stats(struct audio_source* source, struct audio_source_stats* stats) {
+    struct synth_source* synth = source->context;
+
+    memset(stats, 0x00, sizeof(*stats));
+
+    stats->blocks_written = synth->samples / synth->config.sample_buffer_size;
+    stats->blocks_read = stats->blocks_written;
+}
+
+static void synth_source_deinit(struct audio_source* source) {
+    struct synth_source* synth = source->context;
+
+    if (synth == NULL) {
+        return;
+    }
+
+    if (synth->config.signal == SYNTH_SOURCE_PDM) {
+        pdm_decimator_deinit(&synth->decimator);
+    }
+    free(synth->pdm);
+    free(synth);
+
+    source->context = NULL;
+}
+
+static const struct audio_source_ops synth_source_ops = {
+    .start = synth_source_start,
+    .stop = synth_source_stop,
+    .read = synth_source_read,
+    .read32 = synth_source_read32,
+    .latency_us = synth_source_latency_us,
+    .get_stats = synth_source_get_stats,
+    .deinit = synth_source_deinit,
+};
+
+int synth_source_init(struct audio_source* source, const struct synth_source_config* config) {
+    if (config->sample_rate == 0 || config->sample_buffer_size == 0) {
+        return -1;
+    }
+    if (config->channels < 1 || config->channels > SYNTH_SOURCE_CHANNELS_MAX) {
+        return -1;
+    }
+    if (config->amplitude > ((config->signal == SYNTH_SOURCE_PDM) ? SYNTH_SOURCE_PDM_AMPLITUDE_MAX : 32767)) {
+        return -1;
+    }
+
+    struct synth_source* synth = calloc(1, sizeof(*synth));
+
+    if (synth == NULL) {
+        return -1;
+    }
+
+    synth->config = *config;
+    if (synth->config.frequency == 0) {
+        synth->config.frequency = SYNTH_SOURCE_FREQUENCY;
+    }
+    if (synth->config.amplitude == 0) {
+        synth->config.amplitude = SYNTH_SOURCE_AMPLITUDE;
+    }
+    if (synth->config.seed == 0) {
+        synth->config.seed = 1;
+    }
+    if (synth->config.decimation == 0) {
+        synth->config.decimation = SYNTH_SOURCE_DECIMATION;
+    }
+    if (synth->config.filter_stages == 0) {
+        synth->config.filter_stages = 2;
+    }
+
+    if (synth->config.signal == SYNTH_SOURCE_PDM) {
+        if (pdm_decimator_init(&synth->decimator, synth->config.channels, synth->config.decimation,
+                               synth->config.filter_stages, synth->config.sample_rate) < 0) {
+            free(synth);
+
+            return -1;
+        }
+
+        // full scale bit streams at full scale, so that the tone keeps its amplitude
+        synth->decimator.gain = 1;
+
+        synth->pdm = malloc(synth->config.channels * synth->config.sample_buffer_size * synth->config.decimation / 8);
+        if (synth->pdm == NULL) {
+            pdm_decimator_deinit(&synth->decimator);
+            free(synth);
+
+            return -1;
+        }
+    }
+
+    source->ops = &synth_source_ops;
+    source->context = synth;
+    source->name = "synth";
+    source->channels = synth->config.channels;
+    source->sample_rate = synth->config.sample_rate;
+    source->sample_buffer_size = synth->config.sample_buffer_size;
+
+    synth_source_sine_init();
+    synth_source_start(source);
+
+    return 0;
+}
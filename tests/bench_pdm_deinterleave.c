@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// Compares the two ways of filtering a bit-interleaved 2 or 4 mic capture:
+// the separate de-interleaving pass the driver used to make (morton2/morton4
+// into per-channel scratch buffers, then the planar filter bank) and the
+// filter bank reading the raw PIO words in place (pdm_fold_bits2/4 and a
+// 256-byte table inside the kernel). Checks that both give the same samples
+// and prints the cost of each per output sample, in pdm_profile ticks
+// (nanoseconds on a host, clk_sys cycles on the device).
+
+#include "OpenPDMFilter.h"
+
+#include "test_common.h"
+
+#define FS 48000
+#define SAMPLES 1024 // per channel per pass
+#define PASSES 200
+
+static uint8_t pdm[4][SAMPLES * DECIMATION_MAX / 8];
+static uint32_t raw[SAMPLES * DECIMATION_MAX / 8];
+static uint8_t scratch[4][SAMPLES * DECIMATION_MAX / 8];
+static int16_t out[2][4][SAMPLES];
+static TPDMFilterBank_InitStruct bank;
+
+// the separate pass, as in the original pdm_microphone_read()
+
+static uint16_t morton_even(uint32_t x) {
+    x = x & 0x55555555;
+    x = (x | (x >> 1)) & 0x33333333;
+    x = (x | (x >> 2)) & 0x0F0F0F0F;
+    x = (x | (x >> 4)) & 0x00FF00FF;
+    x = (x | (x >> 8)) & 0x0000FFFF;
+    return (uint16_t)x;
+}
+
+static uint8_t morton_fourth(uint32_t x) {
+    x = x & 0x11111111;
+    x = (x | (x >> 3)) & 0x03030303;
+    x = (x | (x >> 6)) & 0x000F000F;
+    x = (x | (x >> 12)) & 0x000000FF;
+    return (uint8_t)x;
+}
+
+static void deinterleave(uint channels, size_t n_words) {
+    for (size_t i = 0; i < n_words; i++) {
+        if (channels == 2) {
+            ((uint16_t*)scratch[0])[i] = morton_even(raw[i]);
+            ((uint16_t*)scratch[1])[i] = morton_even(raw[i] >> 1);
+        } else {
+            for (uint ch = 0; ch < 4; ch++) {
+                scratch[ch][i] = morton_fourth(raw[i] >> ch);
+            }
+        }
+    }
+}
+
+static void bank_init(uint8_t decimation, uint8_t channels) {
+    memset(&bank, 0, sizeof(bank));
+    bank.Fs = FS;
+    bank.LP_HZ = FS / 2;
+    bank.HP_HZ = 10;
+    bank.Channels = channels;
+    bank.Decimation = decimation;
+    bank.MaxVolume = 64;
+    bank.Gain = 16;
+    Open_PDM_FilterBank_Init(&bank);
+}
+
+// ticks per output sample (of one channel) of PASSES passes, separate or fused
+static double run(uint8_t decimation, uint8_t channels, bool fused) {
+    const size_t n_words = SAMPLES * decimation / 8 * channels / 4;
+    uint8_t* in[4] = { scratch[0], scratch[1], scratch[2], scratch[3] };
+    uint16_t* o[4];
+    uint32_t ticks = 0;
+
+    for (int ch = 0; ch < channels; ch++) {
+        o[ch] = (uint16_t*)out[fused][ch];
+    }
+
+    bank_init(decimation, channels);
+    for (int pass = 0; pass < PASSES; pass++) {
+        const uint32_t start = pdm_profile_now();
+
+        if (fused) {
+            Open_PDM_FilterBank_ProcessInterleaved((uint8_t*)raw, o, SAMPLES, 64, &bank);
+        } else {
+            deinterleave(channels, n_words);
+            Open_PDM_FilterBank_Process(in, o, SAMPLES, 64, &bank);
+        }
+        ticks += pdm_profile_now() - start;
+    }
+
+    return (double)ticks / PASSES / SAMPLES / channels;
+}
+
+int main() {
+    static const uint8_t decimations[] = { 48, 64, 128 };
+    uint32_t seed = 1;
+
+    printf("ticks per output sample (%u Hz ticks), separate de-interleave vs fused:\n", pdm_profile_tick_hz());
+
+    for (int d = 0; d < 3; d++) {
+        const uint8_t D = decimations[d];
+
+        if (!LUT_HAS(D)) {
+            continue;
+        }
+
+        for (uint8_t channels = 2; channels <= 4; channels *= 2) {
+            uint8_t* in[4] = { pdm[0], pdm[1], pdm[2], pdm[3] };
+
+            for (int ch = 0; ch < channels; ch++) {
+                test_modulate_tone(pdm[ch], SAMPLES * D / 8, 12000, 40.0 * D * (ch + 1), ch);
+                pdm[ch][test_random(&seed) % (SAMPLES * D / 8)] ^= 0x5A; // a few stray bits
+            }
+            test_interleave((uint8_t*)raw, in, channels, SAMPLES * D / 8);
+
+            const double separate = run(D, channels, false);
+            const double fused = run(D, channels, true);
+
+            for (int ch = 0; ch < channels; ch++) {
+                TEST_CHECK(memcmp(out[0][ch], out[1][ch], sizeof(out[0][ch])) == 0, "/%u, %u mics: channel %d differs",
+                           D, channels, ch);
+            }
+            printf("/%-3u %u mics: %7.2f vs %7.2f (%.2fx)\n", D, channels, separate, fused, separate / fused);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,227 @@
+// generated by test_pdm_filter --golden: Open_PDM_Filter_48/64/128 over the
+// tone, noise and square streams, 256 samples each
+
+static const int16_t golden[3][3][256] = {
+    { // /48
+        { // tone
+            -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 28917, -27744, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 15765, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            30283, -26528, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 16853, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 31136, -25483, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 17771, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32021, -24779, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 18421, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32608, -24149, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 18944, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -23648, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 19371, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -23349, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 19637, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -23019, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700,
+        },
+        { // noise
+            -32700, -32700, 18229, 32700, 15659, -32700, -32700, -32700, 16021, 32700, 32700, 16395,
+            -31755, -32700, -31189, 19147, 32700, 32700, 16704, -32700, -32700, -32700, 17237, 32700,
+            32700, 18560, -32700, -32700, -32700, 16651, 32700, 32700, 13333, -32700, -32700, -32700,
+            12384, 32700, 32700, 9195, -32700, -32700, -32128, 16800, 32700, 32700, 14848, -30752,
+            -32700, -32640, 16160, 32700, 32700, 16448, -32700, -32700, -32700, 12544, 32700, 32700,
+            14933, -31947, -32700, -31061, 13749, 32700, 32700, 14677, -32700, -32700, -32700, 17088,
+            32700, 32700, 17557, -32700, -32700, -32700, 14027, 32700, 32700, 7669, -32700, -32700,
+            -32700, 17013, 32700, 32700, 17835, -32700, -32700, -32700, 11360, 32700, 32700, 13067,
+            -32700, -32700, -32700, 15445, 32700, 32700, 15371, -32700, -32700, -32700, 17440, 32700,
+            32700, 14325, -32700, -32700, -32700, 14261, 32700, 32700, 14208, -32700, -32700, -32700,
+            13237, 32700, 32700, 14731, -32700, -32700, -32700, 14603, 32700, 32700, 12661, -32700,
+            -32700, -32700, 15093, 32700, 32700, 15947, -32700, -32700, -32700, 13323, 32700, 32700,
+            12309, -32700, -32700, -32700, 16331, 32700, 32700, 15296, -32700, -32700, -32700, 11541,
+            32700, 32700, 10539, -32700, -32700, -32700, 14464, 32700, 32700, 12629, -32700, -32700,
+            -32700, 13824, 32700, 32700, 14283, -32700, -32700, -32700, 14805, 32700, 32700, 8576,
+            -32700, -32700, -32700, 17579, 32700, 32700, 11851, -32700, -32700, -32700, 11243, 32700,
+            32700, 11957, -32700, -32700, -32700, 15520, 32700, 32700, 13749, -32700, -32700, -32700,
+            13739, 32700, 32700, 13152, -31253, -32700, -32700, 13621, 32700, 32700, 16085, -32700,
+            -32700, -32700, 11328, 32700, 32700, 13099, -32700, -32700, -32700, 11029, 32700, 32700,
+            11125, -32700, -32700, -32700, 13632, 32700, 32700, 7733, -32700, -32700, -32700, 13152,
+            32700, 32700, 15637, -32700, -32700, -32700, 16139, 32700, 32700, 10091, -32700, -32700,
+            -32700, 12203, 32700, 32700,
+        },
+        { // square
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700,
+        },
+    },
+    { // /64
+        { // tone
+            -32700, -32700, 30032, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 25648, -24788, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 14212, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            26828, -23600, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 15264, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 27748, -22656, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 16028, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 28476, -21976, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 16688, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            29040, -21408, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 17180, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 29464, -20968, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 17540, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 29808, -20640, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32612, 17868, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            30072, -20348, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700,
+        },
+        { // noise
+            -32700, -32700, 17208, 32700, 11696, -30680, -32700, -29392, 14776, 32700, 32700, 16016,
+            -28920, -32700, -28636, 13468, 32700, 32700, 15228, -27752, -32700, -29484, 15160, 32700,
+            32700, 10848, -30856, -32700, -29444, 10720, 32700, 32700, 14680, -29516, -32700, -28012,
+            16396, 32700, 32700, 15368, -28592, -32700, -30600, 12200, 32700, 32700, 15268, -27204,
+            -32700, -28988, 14204, 32700, 32700, 13052, -27276, -32700, -27516, 15716, 32700, 32700,
+            10580, -32700, -32700, -30532, 15736, 32700, 32700, 13588, -32420, -32700, -32700, 12004,
+            32700, 32700, 13644, -31116, -32700, -29152, 14452, 32700, 32700, 14084, -30224, -32700,
+            -29732, 13772, 32700, 32700, 12856, -31640, -32700, -30312, 13344, 32700, 32700, 11712,
+            -31388, -32700, -31428, 12016, 32700, 32700, 14096, -28960, -32700, -29312, 13092, 32700,
+            32700, 13528, -30988, -32700, -29700, 14280, 32700, 32700, 10900, -32428, -32700, -32700,
+            13256, 32700, 32700, 13440, -31432, -32700, -31828, 12588, 32700, 32700, 11656, -32100,
+            -32700, -30776, 10164, 32700, 32700, 14220, -29244, -32700, -31612, 12836, 32700, 32700,
+            14932, -32168, -32700, -29380, 14500, 32700, 32700, 12356, -31972, -32700, -30628, 11500,
+            32700, 32700, 12788, -29192, -32700, -29228, 10564, 32700, 32700, 12160, -31332, -32700,
+            -31512, 11316, 32700, 32700, 12124, -29768, -32700, -30696, 9732, 32700, 32700, 10936,
+            -30576, -32700, -29792, 10992, 32700, 32700, 11340, -32700, -32700, -31556, 11612, 32700,
+            32700, 14808, -30364, -32700, -29304, 13260, 32700, 32700, 12072, -32700, -32700, -32088,
+            13432, 32700, 32700, 12984, -29256, -32700, -32700, 10628, 32700, 32700, 13224, -29176,
+            -32700, -31340, 11280, 32700, 32700, 10996, -30176, -32700, -32308, 12176, 32700, 32700,
+            10304, -30024, -32700, -28000, 14200, 32700, 32700, 14736, -30428, -32700, -32104, 11900,
+            32700, 32700, 9644, -31500, -32700, -31748, 11928, 32700, 32700, 10540, -32700, -32700,
+            -27716, 14708, 32700, 32700,
+        },
+        { // square
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700,
+        },
+    },
+    { // /128
+        { // tone
+            -32700, -32700, 30232, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 25475, -24958, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 14454, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            26713, -23726, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 15547, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 27681, -22769, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 16391, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 28438, -22029, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 17042, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            29025, -21450, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 17558, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 29478, -21000, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32539, 17957, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 29828, -20643, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32227, 18263, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            30102, -20371, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700,
+        },
+        { // noise
+            -32700, -32700, 16582, 32700, 11942, -29258, -32700, -28682, 14728, 32700, 32700, 14167,
+            -30423, -32700, -30327, 12885, 32700, 32700, 15080, -28678, -32700, -28903, 13825, 32700,
+            32700, 14022, -30843, -32700, -26648, 15863, 32700, 32700, 13900, -27012, -32700, -31427,
+            13612, 32700, 32700, 14185, -28351, -32700, -28826, 14635, 32700, 32700, 13293, -30595,
+            -32700, -30324, 13664, 32700, 32700, 13892, -30125, -32700, -28504, 15189, 32700, 32700,
+            12339, -29526, -32700, -30217, 13667, 32700, 32700, 11694, -31322, -32700, -29206, 13519,
+            32700, 32700, 13948, -29849, -32700, -29738, 14865, 32700, 32700, 12965, -31569, -32700,
+            -30534, 13566, 32700, 32700, 12026, -31342, -32700, -28847, 14057, 32700, 32700, 12025,
+            -30682, -32700, -28791, 13885, 32700, 32700, 12707, -29918, -32700, -30668, 12968, 32700,
+            32700, 12520, -31411, -32700, -29793, 12637, 32700, 32700, 14681, -27920, -32700, -29560,
+            13082, 32700, 32700, 12454, -29733, -32700, -27957, 15747, 32700, 32700, 12729, -30199,
+            -32700, -31293, 12612, 32700, 32700, 13155, -30823, -32700, -32700, 11846, 32700, 32700,
+            10569, -32700, -32700, -30587, 13762, 32700, 32700, 11113, -32700, -32700, -30895, 12116,
+            32700, 32700, 12282, -31205, -32700, -30524, 12395, 32700, 32700, 9847, -32700, -32700,
+            -30402, 12643, 32700, 32700, 11286, -31941, -32700, -30251, 12878, 32700, 32700, 12385,
+            -32700, -32700, -30062, 13132, 32700, 32700, 13237, -31112, -32700, -31362, 13203, 32700,
+            32700, 10169, -32700, -32700, -29837, 13302, 32700, 32700, 12691, -31132, -32700, -30808,
+            13022, 32700, 32700, 12158, -32133, -32700, -31539, 11750, 32700, 32700, 11095, -31563,
+            -32700, -29470, 12187, 32700, 32700, 10566, -32700, -32700, -30894, 11852, 32700, 32700,
+            11399, -32700, -32700, -31412, 10633, 32700, 32700, 12334, -30375, -32700, -30085, 12336,
+            32700, 32700, 10522, -32700, -32700, -31062, 12178, 32700, 32700, 11911, -31608, -32700,
+            -30815, 10764, 32700, 32700,
+        },
+        { // square
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, 32700, 32700, 32700,
+            32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700, 32700,
+            32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700, -32700,
+            -32700, -32700, -32700, -32700,
+        },
+    },
+};
@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+#
+# SPDX-License-Identifier: Apache-2.0
+#
+
+# Assembles a .pio file into the C header pioasm would write, for the host
+# tests, which have no Pico SDK (and so no pioasm). Only what the capture
+# programs use is supported: .program, .side_set, .wrap_target, .wrap, % c-sdk
+# blocks, labels, and the nop, jmp (unconditional), in and push instructions
+# with side-set and delay. Anything else is an error rather than a guess.
+#
+#   pioasm.py pdm_microphone.pio pdm_microphone.pio.h
+
+import re
+import sys
+
+IN_SOURCES = {"pins": 0, "x": 1, "y": 2, "null": 3, "isr": 6, "osr": 7}
+
+
+class Program:
+    def __init__(self, name):
+        self.name = name
+        self.sideset_count = 0
+        self.sideset_opt = False
+        self.sideset_pindirs = False
+        self.wrap_target = None
+        self.wrap = None
+        self.labels = {}
+        self.lines = []  # (source line number, instruction text, side, delay)
+        self.c_sdk = []
+
+
+def fail(path, number, message):
+    sys.exit("%s:%d: %s" % (path, number, message))
+
+
+def encode(program, path, number, text, side, delay):
+    words = text.replace(",", " ").split()
+    op, args = words[0], words[1:]
+
+    if op == "nop" and not args:
+        word = 0xA042  # mov y, y
+    elif op == "jmp" and len(args) == 1:
+        if args[0] in program.labels:
+            target = program.labels[args[0]]
+        elif args[0].isdigit():
+            target = int(args[0])
+        else:
+            fail(path, number, "unknown jmp target '%s'" % args[0])
+        word = 0x0000 | target
+    elif op == "in" and len(args) == 2 and args[0] in IN_SOURCES and args[1].isdigit() and 1 <= int(args[1]) <= 32:
+        word = 0x4000 | (IN_SOURCES[args[0]] << 5) | (int(args[1]) & 31)
+    elif op == "push" and set(args) <= {"iffull", "block", "noblock"} and not ({"block", "noblock"} <= set(args)):
+        word = 0x8000 | (("iffull" in args) << 6) | (("noblock" not in args) << 5)
+    else:
+        fail(path, number, "unsupported instruction '%s'" % text)
+
+    # side-set in the top bits of the delay/side-set field, after the enable bit if optional
+    bits = program.sideset_count + program.sideset_opt
+    if side is None:
+        if program.sideset_count and not program.sideset_opt:
+            fail(path, number, "side-set required")
+        field = 0
+    else:
+        if not program.sideset_count or side >= (1 << program.sideset_count):
+            fail(path, number, "bad side-set value %d" % side)
+        field = ((program.sideset_opt << program.sideset_count) | side) << (5 - bits)
+    if delay >= (1 << (5 - bits)):
+        fail(path, number, "delay %d too long" % delay)
+
+    return word | ((field | delay) << 8)
+
+
+def parse(path):
+    programs = []
+    program = None
+    c_sdk = None
+
+    for number, line in enumerate(open(path), 1):
+        if c_sdk is not None:
+            if line.strip() == "%}":
+                program.c_sdk.extend(c_sdk)
+                c_sdk = None
+            else:
+                c_sdk.append(line)
+            continue
+
+        line = re.sub(r"(//|;).*", "", line).strip()
+        if not line or line.startswith("/*") or line.startswith("*"):
+            continue
+
+        if line == "% c-sdk {":
+            if program is None:
+                fail(path, number, "c-sdk block outside a program")
+            c_sdk = []
+            continue
+
+        words = line.split()
+        if words[0] == ".program" and len(words) == 2:
+            program = Program(words[1])
+            programs.append(program)
+            continue
+        if program is None:
+            fail(path, number, "'%s' outside a program" % line)
+
+        if words[0] == ".side_set" and 2 <= len(words) and set(words[2:]) <= {"opt", "pindirs"}:
+            program.sideset_count = int(words[1])
+            program.sideset_opt = "opt" in words
+            program.sideset_pindirs = "pindirs" in words
+        elif line == ".wrap_target":
+            program.wrap_target = len(program.lines)
+        elif line == ".wrap":
+            program.wrap = len(program.lines) - 1
+        elif words[0].startswith("."):
+            fail(path, number, "unsupported directive '%s'" % line)
+        elif line.endswith(":") and len(words) == 1:
+            program.labels[line[:-1]] = len(program.lines)
+        else:
+            match = re.match(r"^(.*?)(?:\s+side\s+(\d+))?(?:\s*\[(\d+)\])?$", line)
+            side = int(match.group(2)) if match.group(2) is not None else None
+            delay = int(match.group(3)) if match.group(3) is not None else 0
+            program.lines.append((number, match.group(1).strip(), side, delay))
+
+    if c_sdk is not None:
+        sys.exit("%s: unterminated c-sdk block" % path)
+
+    return programs
+
+
+def write(path, programs, out):
+    out.write("// generated from %s by pioasm.py, do not edit\n\n" % path.replace("\\", "/").split("/")[-1])
+    out.write("#pragma once\n\n")
+    out.write("#if !PICO_NO_HARDWARE\n#include \"hardware/pio.h\"\n#endif\n")
+
+    for program in programs:
+        name = program.name
+        wrap_target = program.wrap_target or 0
+        wrap = len(program.lines) - 1 if program.wrap is None else program.wrap
+
+        out.write("\n// %s\n\n" % name)
+        out.write("#define %s_wrap_target %d\n" % (name, wrap_target))
+        out.write("#define %s_wrap %d\n\n" % (name, wrap))
+        out.write("static const uint16_t %s_program_instructions[] = {\n" % name)
+        for i, (number, text, side, delay) in enumerate(program.lines):
+            word = encode(program, path, number, text, side, delay)
+            out.write("    0x%04x, // %2d: %s\n" % (word, i, text))
+        out.write("};\n\n")
+
+        out.write("#if !PICO_NO_HARDWARE\n")
+        out.write("static const struct pio_program %s_program = {\n" % name)
+        out.write("    .instructions = %s_program_instructions,\n" % name)
+        out.write("    .length = %d,\n" % len(program.lines))
+        out.write("    .origin = -1,\n};\n\n")
+        out.write("static inline pio_sm_config %s_program_get_default_config(uint offset) {\n" % name)
+        out.write("    pio_sm_config c = pio_get_default_sm_config();\n")
+        out.write("    sm_config_set_wrap(&c, offset + %s_wrap_target, offset + %s_wrap);\n" % (name, name))
+        if program.sideset_count:
+            out.write("    sm_config_set_sideset(&c, %d, %s, %s);\n" % (
+                program.sideset_count + program.sideset_opt, str(program.sideset_opt).lower(),
+                str(program.sideset_pindirs).lower()))
+        out.write("    return c;\n}\n")
+        if program.c_sdk:
+            out.write("".join(program.c_sdk))
+        out.write("#endif\n")
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: pioasm.py <input.pio> <output.h>")
+
+    programs = parse(sys.argv[1])
+    with open(sys.argv[2], "w") as out:
+        write(sys.argv[1], programs, out)
+
+
+if __name__ == "__main__":
+    main()
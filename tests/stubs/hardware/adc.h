@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the library uses; the
+// conversions run in the emulator (see pico_emu.h)
+
+#ifndef _HARDWARE_ADC_H
+#define _HARDWARE_ADC_H
+
+#include "pico.h"
+
+typedef struct {
+    volatile uint32_t cs;
+    volatile uint32_t result;
+    volatile uint32_t fcs;
+    volatile uint32_t fifo;
+    volatile uint32_t div;
+    volatile uint32_t intr;
+    volatile uint32_t inte;
+    volatile uint32_t intf;
+    volatile uint32_t ints;
+} adc_hw_t;
+
+extern adc_hw_t adc_emu_hw;
+
+#define adc_hw (&adc_emu_hw)
+
+void adc_init(void);
+void adc_gpio_init(uint gpio);
+void adc_select_input(uint input);
+void adc_set_round_robin(uint input_mask);
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift);
+void adc_set_clkdiv(float clkdiv);
+void adc_run(bool run);
+void adc_fifo_drain(void);
+
+#endif
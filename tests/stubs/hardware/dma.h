@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the library uses; the
+// channels run in the emulator (see pico_emu.h)
+
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+#include "pico.h"
+
+#define NUM_DMA_CHANNELS 12
+
+#define DREQ_PIO0_TX0 0
+#define DREQ_PIO0_RX0 4
+#define DREQ_PIO1_TX0 8
+#define DREQ_PIO1_RX0 12
+#define DREQ_ADC 36
+#define DREQ_FORCE 63
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2,
+};
+
+typedef struct {
+    volatile uint32_t read_addr;
+    volatile uint32_t write_addr;
+    volatile uint32_t transfer_count;
+    volatile uint32_t ctrl_trig;
+    volatile uint32_t al1_ctrl;
+    volatile uint32_t al1_read_addr;
+    volatile uint32_t al1_write_addr;
+    volatile uint32_t al1_transfer_count_trig;
+    volatile uint32_t al2_ctrl;
+    volatile uint32_t al2_transfer_count;
+    volatile uint32_t al2_read_addr;
+    volatile uint32_t al2_write_addr_trig;
+    volatile uint32_t al3_ctrl;
+    volatile uint32_t al3_write_addr;
+    volatile uint32_t al3_transfer_count;
+    volatile uint32_t al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct {
+    dma_channel_hw_t ch[NUM_DMA_CHANNELS];
+    volatile uint32_t intr;
+    volatile uint32_t inte0;
+    volatile uint32_t intf0;
+    volatile uint32_t ints0;
+    volatile uint32_t inte1;
+    volatile uint32_t intf1;
+    volatile uint32_t ints1;
+} dma_hw_t;
+
+extern dma_hw_t dma_emu_hw;
+
+#define dma_hw (&dma_emu_hw)
+
+// the fields the SDK packs into CTRL
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    uint8_t dreq;
+    uint8_t chain_to;
+    uint8_t ring_size_bits;
+    bool ring_write;
+    bool bswap;
+    bool irq_quiet;
+    bool enable;
+} dma_channel_config;
+
+int dma_claim_unused_channel(bool required);
+void dma_channel_claim(uint channel);
+void dma_channel_unclaim(uint channel);
+bool dma_channel_is_claimed(uint channel);
+
+dma_channel_config dma_channel_get_default_config(uint channel);
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size);
+void channel_config_set_read_increment(dma_channel_config* c, bool incr);
+void channel_config_set_write_increment(dma_channel_config* c, bool incr);
+void channel_config_set_dreq(dma_channel_config* c, uint dreq);
+void channel_config_set_chain_to(dma_channel_config* c, uint chain_to);
+void channel_config_set_ring(dma_channel_config* c, bool write, uint size_bits);
+void channel_config_set_bswap(dma_channel_config* c, bool bswap);
+void channel_config_set_irq_quiet(dma_channel_config* c, bool irq_quiet);
+void channel_config_set_enable(dma_channel_config* c, bool enable);
+
+void dma_channel_set_config(uint channel, const dma_channel_config* config, bool trigger);
+void dma_channel_set_read_addr(uint channel, const volatile void* read_addr, bool trigger);
+void dma_channel_set_write_addr(uint channel, volatile void* write_addr, bool trigger);
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger);
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint transfer_count, bool trigger);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_set_irq1_enabled(uint channel, bool enabled);
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the library uses; the
+// state machines run in the emulator (see pico_emu.h)
+
+#ifndef _HARDWARE_PIO_H
+#define _HARDWARE_PIO_H
+
+#include "pico.h"
+
+#define NUM_PIOS 2
+#define NUM_PIO_STATE_MACHINES 4
+#define PIO_INSTRUCTION_COUNT 32
+
+typedef struct {
+    volatile uint32_t ctrl;
+    volatile uint32_t fstat;
+    volatile uint32_t fdebug;
+    volatile uint32_t flevel;
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t* PIO;
+
+extern pio_hw_t pio_emu_hw[NUM_PIOS];
+
+#define pio0 (&pio_emu_hw[0])
+#define pio1 (&pio_emu_hw[1])
+
+enum pio_fifo_join {
+    PIO_FIFO_JOIN_NONE = 0,
+    PIO_FIFO_JOIN_TX = 1,
+    PIO_FIFO_JOIN_RX = 2,
+};
+
+// the fields the SDK packs into the CLKDIV, EXECCTRL, SHIFTCTRL and PINCTRL registers
+typedef struct {
+    uint32_t clkdiv; // 16.8 fixed point
+    uint8_t wrap_target;
+    uint8_t wrap;
+    uint8_t sideset_base;
+    uint8_t sideset_count; // including the enable bit, when optional
+    bool sideset_optional;
+    bool sideset_pindirs;
+    uint8_t in_base;
+    bool in_shift_right;
+    bool autopush;
+    uint8_t push_threshold;
+    enum pio_fifo_join fifo_join;
+} pio_sm_config;
+
+typedef struct pio_program {
+    const uint16_t* instructions;
+    uint8_t length;
+    int8_t origin;
+} pio_program_t;
+
+pio_sm_config pio_get_default_sm_config(void);
+
+void sm_config_set_wrap(pio_sm_config* c, uint wrap_target, uint wrap);
+void sm_config_set_sideset(pio_sm_config* c, uint bit_count, bool optional, bool pindirs);
+void sm_config_set_sideset_pins(pio_sm_config* c, uint sideset_base);
+void sm_config_set_in_pins(pio_sm_config* c, uint in_base);
+void sm_config_set_in_shift(pio_sm_config* c, bool shift_right, bool autopush, uint push_threshold);
+void sm_config_set_fifo_join(pio_sm_config* c, enum pio_fifo_join join);
+void sm_config_set_clkdiv(pio_sm_config* c, float div);
+
+uint pio_get_index(PIO pio);
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+
+bool pio_can_add_program(PIO pio, const pio_program_t* program);
+uint pio_add_program(PIO pio, const pio_program_t* program);
+void pio_remove_program(PIO pio, const pio_program_t* program, uint loaded_offset);
+
+void pio_sm_claim(PIO pio, uint sm);
+void pio_claim_sm_mask(PIO pio, uint sm_mask);
+void pio_sm_unclaim(PIO pio, uint sm);
+bool pio_sm_is_claimed(PIO pio, uint sm);
+
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config* config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled);
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask);
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the library uses
+
+#ifndef _PICO_H
+#define _PICO_H
+
+#include "pico/types.h"
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+#define __not_in_flash_func(func_name) func_name
+#define __time_critical_func(func_name) func_name
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the library uses
+
+#ifndef _PICO_MULTICORE_H
+#define _PICO_MULTICORE_H
+
+#include "pico.h"
+
+// core1 is a thread
+void multicore_launch_core1(void (*entry)(void));
+void multicore_reset_core1(void);
+uint get_core_num(void);
+
+#endif
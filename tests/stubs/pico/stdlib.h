@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the examples built here use
+
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include "pico.h"
+#include "pico/time.h"
+
+// printf goes to the host's stdout as it is
+static inline bool stdio_init_all(void) {
+    return true;
+}
+
+#endif
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// host stand-in for the SDK header, with only what the library uses
+
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+#include "pico.h"
+
+// the emulated time, clk_sys cycles / 125
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+
+// lets the emulated hardware run (on core0) while the caller waits for it
+void tight_loop_contents(void);
+
+#endif
@@ -0,0 +1,1076 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/adc.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "pico/multicore.h"
+#include "pico/time.h"
+
+#include "pico_emu.h"
+
+#define EMU_FIFO_DEPTH 4 // per direction, twice that joined
+#define EMU_IRQ_HANDLERS_MAX 4
+#define EMU_ADC_INPUTS 5 // 4 GPIOs and the temperature sensor
+#define EMU_ADC_CYCLES_MIN 96 // clk_adc cycles per conversion, back to back
+
+pio_hw_t pio_emu_hw[NUM_PIOS];
+dma_hw_t dma_emu_hw;
+adc_hw_t adc_emu_hw;
+
+struct emu_sm {
+    pio_sm_config config;
+    bool enabled;
+    uint8_t pc;
+    uint8_t delay; // cycles left of the current instruction's delay
+    uint32_t clkdiv_acc; // 1/256ths of a clk_sys cycle
+    uint32_t x;
+    uint32_t y;
+    uint32_t isr;
+    uint8_t isr_count;
+    uint32_t side_mask; // pins it side-set so far, and their levels
+    uint32_t side_level;
+    uint32_t rx_fifo[2 * EMU_FIFO_DEPTH];
+    uint8_t rx_head;
+    uint8_t rx_level;
+};
+
+static struct {
+    uint16_t instr[PIO_INSTRUCTION_COUNT];
+    uint32_t used;
+    uint8_t claimed;
+    struct emu_sm sm[NUM_PIO_STATE_MACHINES];
+    uint32_t pin_out; // output levels the state machines set
+} emu_pio[NUM_PIOS];
+
+static struct {
+    dma_channel_config config;
+    uint32_t reload; // transfer count loaded on trigger
+    bool busy;
+} emu_dma[NUM_DMA_CHANNELS];
+
+static uint32_t emu_dma_claimed;
+static uint32_t emu_dma_intr; // completions, raw
+
+static struct {
+    bool fifo_enabled;
+    bool dreq_enabled;
+    uint dreq_threshold;
+    bool running;
+    uint input; // converted next
+    uint round_robin; // inputs, as a mask
+    uint32_t clkdiv; // 1/256ths of a clk_adc cycle, as the SDK's 16.8 fixed point
+    uint64_t acc; // clk_adc cycles since the last conversion, in 1/256ths times PICO_EMU_SYS_HZ
+    uint16_t fifo[EMU_FIFO_DEPTH];
+    uint8_t fifo_head;
+    uint8_t fifo_level;
+    pico_emu_adc_input_t source;
+} emu_adc;
+
+static struct {
+    irq_handler_t handlers[EMU_IRQ_HANDLERS_MAX];
+    uint n_handlers;
+    bool enabled;
+} emu_irq[NUM_IRQS];
+
+static struct {
+    uint clk_pin;
+    const uint8_t* pdm;
+    size_t n_bits;
+    size_t edges;
+} emu_mic[PICO_EMU_GPIOS];
+
+static uint32_t emu_gpio_pio[NUM_PIOS]; // pins with each PIO block's function
+static uint32_t emu_mic_pins;
+static uint32_t emu_gpio_oe;
+static uint32_t emu_gpio_level;
+
+static struct pico_emu_stats emu_stats;
+static pico_emu_dma_trace_t emu_dma_trace;
+static bool emu_running;
+
+static void emu_panic(const char* fmt, ...) {
+    va_list args;
+
+    va_start(args, fmt);
+    printf("pico_emu: ");
+    vprintf(fmt, args);
+    printf("\n");
+    va_end(args);
+    exit(1);
+}
+
+static uint32_t emu_addr(const volatile void* addr) {
+    if ((uintptr_t)addr > UINT32_MAX) {
+        emu_panic("address %p does not fit the DMA (link with -no-pie)", addr);
+    }
+
+    return (uint32_t)(uintptr_t)addr;
+}
+
+// clocks and time
+
+uint32_t clock_get_hz(enum clock_index clk_index) {
+    return (clk_index == clk_sys) ? PICO_EMU_SYS_HZ : 48000000;
+}
+
+uint64_t time_us_64(void) {
+    return emu_stats.cycles / (PICO_EMU_SYS_HZ / 1000000);
+}
+
+uint32_t time_us_32(void) {
+    return (uint32_t)time_us_64();
+}
+
+// multicore: core1 is a thread, which cannot run the emulator
+
+static __thread uint emu_core_num;
+static pthread_t emu_core1;
+static void (*emu_core1_entry)(void);
+
+static void* emu_core1_main(void* arg) {
+    (void)arg;
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
+    emu_core_num = 1;
+    emu_core1_entry();
+
+    return NULL;
+}
+
+void multicore_launch_core1(void (*entry)(void)) {
+    emu_core1_entry = entry;
+    pthread_create(&emu_core1, NULL, emu_core1_main, NULL);
+}
+
+void multicore_reset_core1(void) {
+    pthread_cancel(emu_core1);
+    pthread_join(emu_core1, NULL);
+}
+
+uint get_core_num(void) {
+    return emu_core_num;
+}
+
+void tight_loop_contents(void) {
+    if (emu_core_num == 0 && !emu_running) {
+        pico_emu_run(PICO_EMU_SYS_HZ / 1000000);
+    } else {
+        sched_yield();
+    }
+}
+
+// IRQs
+
+void irq_set_enabled(uint num, bool enabled) {
+    emu_irq[num].enabled = enabled;
+}
+
+bool irq_is_enabled(uint num) {
+    return emu_irq[num].enabled;
+}
+
+void irq_add_shared_handler(uint num, irq_handler_t handler, uint8_t order_priority) {
+    (void)order_priority;
+
+    for (uint i = 0; i < emu_irq[num].n_handlers; i++) {
+        if (emu_irq[num].handlers[i] == handler) {
+            emu_panic("handler added to IRQ %u twice", num);
+        }
+    }
+    if (emu_irq[num].n_handlers == EMU_IRQ_HANDLERS_MAX) {
+        emu_panic("too many shared handlers on IRQ %u", num);
+    }
+    emu_irq[num].handlers[emu_irq[num].n_handlers++] = handler;
+}
+
+void irq_remove_handler(uint num, irq_handler_t handler) {
+    for (uint i = 0; i < emu_irq[num].n_handlers; i++) {
+        if (emu_irq[num].handlers[i] == handler) {
+            memmove(&emu_irq[num].handlers[i], &emu_irq[num].handlers[i + 1],
+                    (emu_irq[num].n_handlers - i - 1) * sizeof(irq_handler_t));
+            emu_irq[num].n_handlers--;
+
+            return;
+        }
+    }
+    emu_panic("removing a handler IRQ %u does not have", num);
+}
+
+uint pico_emu_irq_handlers(uint num) {
+    return emu_irq[num].n_handlers;
+}
+
+// PIO configuration
+
+pio_sm_config pio_get_default_sm_config(void) {
+    pio_sm_config c;
+
+    memset(&c, 0x00, sizeof(c));
+    c.clkdiv = 1 << 8;
+    c.wrap = PIO_INSTRUCTION_COUNT - 1;
+    c.push_threshold = 32;
+    c.in_shift_right = true;
+
+    return c;
+}
+
+void sm_config_set_wrap(pio_sm_config* c, uint wrap_target, uint wrap) {
+    c->wrap_target = wrap_target;
+    c->wrap = wrap;
+}
+
+void sm_config_set_sideset(pio_sm_config* c, uint bit_count, bool optional, bool pindirs) {
+    c->sideset_count = bit_count;
+    c->sideset_optional = optional;
+    c->sideset_pindirs = pindirs;
+}
+
+void sm_config_set_sideset_pins(pio_sm_config* c, uint sideset_base) {
+    c->sideset_base = sideset_base;
+}
+
+void sm_config_set_in_pins(pio_sm_config* c, uint in_base) {
+    c->in_base = in_base;
+}
+
+void sm_config_set_in_shift(pio_sm_config* c, bool shift_right, bool autopush, uint push_threshold) {
+    c->in_shift_right = shift_right;
+    c->autopush = autopush;
+    c->push_threshold = push_threshold;
+}
+
+void sm_config_set_fifo_join(pio_sm_config* c, enum pio_fifo_join join) {
+    c->fifo_join = join;
+}
+
+// as the SDK: 16.8 fixed point, truncated
+void sm_config_set_clkdiv(pio_sm_config* c, float div) {
+    const uint16_t div_int = (uint16_t)div;
+    const uint8_t div_frac = (uint8_t)((div - div_int) * 256);
+
+    c->clkdiv = (div_int << 8) | div_frac;
+}
+
+uint pio_get_index(PIO pio) {
+    return pio == pio1;
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx) {
+    return (pio_get_index(pio) ? (is_tx ? DREQ_PIO1_TX0 : DREQ_PIO1_RX0) : (is_tx ? DREQ_PIO0_TX0 : DREQ_PIO0_RX0)) + sm;
+}
+
+// PIO instruction memory, allocated from the top as the SDK does
+
+static int emu_find_offset(PIO pio, const pio_program_t* program) {
+    const uint32_t mask = (1u << program->length) - 1;
+    const uint32_t used = emu_pio[pio_get_index(pio)].used;
+
+    if (program->origin >= 0) {
+        return (used & (mask << program->origin)) ? -1 : program->origin;
+    }
+    for (int offset = PIO_INSTRUCTION_COUNT - program->length; offset >= 0; offset--) {
+        if (!(used & (mask << offset))) {
+            return offset;
+        }
+    }
+
+    return -1;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t* program) {
+    return emu_find_offset(pio, program) >= 0;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t* program) {
+    const int offset = emu_find_offset(pio, program);
+
+    if (offset < 0) {
+        emu_panic("no program space");
+    }
+    for (uint i = 0; i < program->length; i++) {
+        uint16_t instr = program->instructions[i];
+
+        // JMP targets are relative to the program
+        if ((instr & 0xE000) == 0x0000) {
+            instr += offset;
+        }
+        emu_pio[pio_get_index(pio)].instr[offset + i] = instr;
+    }
+    emu_pio[pio_get_index(pio)].used |= ((1u << program->length) - 1) << offset;
+
+    return offset;
+}
+
+void pio_remove_program(PIO pio, const pio_program_t* program, uint loaded_offset) {
+    const uint32_t mask = ((1u << program->length) - 1) << loaded_offset;
+
+    if ((emu_pio[pio_get_index(pio)].used & mask) != mask) {
+        emu_panic("removing a program that is not loaded");
+    }
+    emu_pio[pio_get_index(pio)].used &= ~mask;
+}
+
+uint32_t pico_emu_instructions_used(PIO pio) {
+    return emu_pio[pio_get_index(pio)].used;
+}
+
+// state machine claims, panicking on a double claim as the SDK does
+
+void pio_sm_claim(PIO pio, uint sm) {
+    pio_claim_sm_mask(pio, 1u << sm);
+}
+
+void pio_claim_sm_mask(PIO pio, uint sm_mask) {
+    if (emu_pio[pio_get_index(pio)].claimed & sm_mask) {
+        emu_panic("PIO %u state machines (mask %x) already claimed", pio_get_index(pio), sm_mask);
+    }
+    emu_pio[pio_get_index(pio)].claimed |= sm_mask;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm) {
+    emu_pio[pio_get_index(pio)].claimed &= ~(1u << sm);
+}
+
+bool pio_sm_is_claimed(PIO pio, uint sm) {
+    return emu_pio[pio_get_index(pio)].claimed & (1u << sm);
+}
+
+// state machines
+
+void pio_gpio_init(PIO pio, uint pin) {
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        emu_gpio_pio[p] &= ~(1u << pin);
+    }
+    emu_gpio_pio[pio_get_index(pio)] |= 1u << pin;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out) {
+    (void)pio;
+    (void)sm;
+
+    for (uint pin = pin_base; pin < pin_base + pin_count; pin++) {
+        if (is_out) {
+            emu_gpio_oe |= 1u << pin;
+        } else {
+            emu_gpio_oe &= ~(1u << pin);
+        }
+    }
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config* config) {
+    struct emu_sm* s = &emu_pio[pio_get_index(pio)].sm[sm];
+
+    if (config->autopush) {
+        emu_panic("autopush is not emulated");
+    }
+
+    memset(s, 0x00, sizeof(*s));
+    s->config = *config;
+    s->pc = initial_pc;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled) {
+    pio_set_sm_mask_enabled(pio, 1u << sm, enabled);
+}
+
+void pio_set_sm_mask_enabled(PIO pio, uint32_t mask, bool enabled) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (mask & (1u << sm)) {
+            emu_pio[pio_get_index(pio)].sm[sm].enabled = enabled;
+        }
+    }
+}
+
+// CTRL with SM_ENABLE and CLKDIV_RESTART: the dividers start in phase
+void pio_enable_sm_mask_in_sync(PIO pio, uint32_t mask) {
+    for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+        if (mask & (1u << sm)) {
+            emu_pio[pio_get_index(pio)].sm[sm].clkdiv_acc = 0;
+            emu_pio[pio_get_index(pio)].sm[sm].enabled = true;
+        }
+    }
+}
+
+// DMA configuration
+
+int dma_claim_unused_channel(bool required) {
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        if (!(emu_dma_claimed & (1u << channel))) {
+            emu_dma_claimed |= 1u << channel;
+
+            return channel;
+        }
+    }
+    if (required) {
+        emu_panic("no DMA channels are available");
+    }
+
+    return -1;
+}
+
+void dma_channel_claim(uint channel) {
+    if (emu_dma_claimed & (1u << channel)) {
+        emu_panic("DMA channel %u is already claimed", channel);
+    }
+    emu_dma_claimed |= 1u << channel;
+}
+
+void dma_channel_unclaim(uint channel) {
+    emu_dma_claimed &= ~(1u << channel);
+}
+
+bool dma_channel_is_claimed(uint channel) {
+    return emu_dma_claimed & (1u << channel);
+}
+
+uint32_t pico_emu_dma_claimed(void) {
+    return emu_dma_claimed;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel) {
+    dma_channel_config c;
+
+    memset(&c, 0x00, sizeof(c));
+    c.size = DMA_SIZE_32;
+    c.read_increment = true;
+    c.dreq = DREQ_FORCE;
+    c.chain_to = channel;
+    c.enable = true;
+
+    return c;
+}
+
+void channel_config_set_transfer_data_size(dma_channel_config* c, enum dma_channel_transfer_size size) {
+    c->size = size;
+}
+
+void channel_config_set_read_increment(dma_channel_config* c, bool incr) {
+    c->read_increment = incr;
+}
+
+void channel_config_set_write_increment(dma_channel_config* c, bool incr) {
+    c->write_increment = incr;
+}
+
+void channel_config_set_dreq(dma_channel_config* c, uint dreq) {
+    c->dreq = dreq;
+}
+
+void channel_config_set_chain_to(dma_channel_config* c, uint chain_to) {
+    c->chain_to = chain_to;
+}
+
+void channel_config_set_ring(dma_channel_config* c, bool write, uint size_bits) {
+    c->ring_write = write;
+    c->ring_size_bits = size_bits;
+}
+
+void channel_config_set_bswap(dma_channel_config* c, bool bswap) {
+    c->bswap = bswap;
+}
+
+void channel_config_set_irq_quiet(dma_channel_config* c, bool irq_quiet) {
+    c->irq_quiet = irq_quiet;
+}
+
+void channel_config_set_enable(dma_channel_config* c, bool enable) {
+    c->enable = enable;
+}
+
+static void emu_dma_trigger(uint channel) {
+    if (!emu_dma[channel].config.enable) {
+        return;
+    }
+    if (emu_dma[channel].busy) {
+        emu_panic("DMA channel %u triggered while busy", channel);
+    }
+
+    emu_dma[channel].busy = true;
+    dma_hw->ch[channel].transfer_count = emu_dma[channel].reload;
+}
+
+void dma_channel_set_config(uint channel, const dma_channel_config* config, bool trigger) {
+    emu_dma[channel].config = *config;
+    if (trigger) {
+        emu_dma_trigger(channel);
+    }
+}
+
+void dma_channel_set_read_addr(uint channel, const volatile void* read_addr, bool trigger) {
+    dma_hw->ch[channel].read_addr = emu_addr(read_addr);
+    if (trigger) {
+        emu_dma_trigger(channel);
+    }
+}
+
+void dma_channel_set_write_addr(uint channel, volatile void* write_addr, bool trigger) {
+    dma_hw->ch[channel].write_addr = emu_addr(write_addr);
+    if (trigger) {
+        emu_dma_trigger(channel);
+    }
+}
+
+void dma_channel_set_trans_count(uint channel, uint32_t trans_count, bool trigger) {
+    emu_dma[channel].reload = trans_count;
+    if (!emu_dma[channel].busy) {
+        dma_hw->ch[channel].transfer_count = trans_count;
+    }
+    if (trigger) {
+        emu_dma_trigger(channel);
+    }
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config* config, volatile void* write_addr,
+                           const volatile void* read_addr, uint transfer_count, bool trigger) {
+    dma_channel_set_read_addr(channel, read_addr, false);
+    dma_channel_set_write_addr(channel, write_addr, false);
+    dma_channel_set_trans_count(channel, transfer_count, false);
+    dma_channel_set_config(channel, config, trigger);
+}
+
+void dma_channel_start(uint channel) {
+    emu_dma_trigger(channel);
+}
+
+// stops at once (and any completion it raises is dropped)
+void dma_channel_abort(uint channel) {
+    emu_dma[channel].busy = false;
+    emu_dma_intr &= ~(1u << channel);
+}
+
+bool dma_channel_is_busy(uint channel) {
+    return emu_dma[channel].busy;
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled) {
+    if (enabled) {
+        dma_hw->inte0 |= 1u << channel;
+    } else {
+        dma_hw->inte0 &= ~(1u << channel);
+    }
+}
+
+void dma_channel_set_irq1_enabled(uint channel, bool enabled) {
+    if (enabled) {
+        dma_hw->inte1 |= 1u << channel;
+    } else {
+        dma_hw->inte1 &= ~(1u << channel);
+    }
+}
+
+// ADC
+
+void adc_init(void) {
+    const pico_emu_adc_input_t source = emu_adc.source;
+
+    memset(&emu_adc, 0x00, sizeof(emu_adc));
+    emu_adc.source = source;
+}
+
+void adc_gpio_init(uint gpio) {
+    if (gpio < 26 || gpio > 29) {
+        emu_panic("GPIO %u is not an ADC input", gpio);
+    }
+}
+
+void adc_select_input(uint input) {
+    if (input >= EMU_ADC_INPUTS) {
+        emu_panic("ADC input %u does not exist", input);
+    }
+    emu_adc.input = input;
+}
+
+void adc_set_round_robin(uint input_mask) {
+    emu_adc.round_robin = input_mask & ((1u << EMU_ADC_INPUTS) - 1);
+}
+
+void adc_fifo_setup(bool en, bool dreq_en, uint16_t dreq_thresh, bool err_in_fifo, bool byte_shift) {
+    if (err_in_fifo || byte_shift) {
+        emu_panic("ADC FIFO error bits and byte shift are not emulated");
+    }
+    emu_adc.fifo_enabled = en;
+    emu_adc.dreq_enabled = dreq_en;
+    emu_adc.dreq_threshold = dreq_thresh;
+}
+
+void adc_set_clkdiv(float clkdiv) {
+    emu_adc.clkdiv = (uint32_t)(clkdiv * 256);
+    emu_adc.acc = 0;
+}
+
+void adc_run(bool run) {
+    emu_adc.running = run;
+    emu_adc.acc = 0;
+}
+
+void adc_fifo_drain(void) {
+    emu_adc.fifo_level = 0;
+}
+
+// emulation
+
+void pico_emu_connect_mic(uint data_pin, uint clk_pin, const uint8_t* pdm, size_t n_bytes) {
+    emu_mic[data_pin].clk_pin = clk_pin;
+    emu_mic[data_pin].pdm = pdm;
+    emu_mic[data_pin].n_bits = n_bytes * 8;
+    emu_mic[data_pin].edges = 0;
+    emu_mic_pins |= 1u << data_pin;
+}
+
+void pico_emu_disconnect_mics(void) {
+    memset(emu_mic, 0x00, sizeof(emu_mic));
+    emu_mic_pins = 0;
+}
+
+const struct pico_emu_stats* pico_emu_get_stats(void) {
+    return &emu_stats;
+}
+
+void pico_emu_set_dma_trace(pico_emu_dma_trace_t trace) {
+    emu_dma_trace = trace;
+}
+
+void pico_emu_set_adc_input(pico_emu_adc_input_t input) {
+    emu_adc.source = input;
+}
+
+// levels on the pins: PIO outputs where enabled, else the microphones (or 0)
+static uint32_t emu_gpio_in(void) {
+    uint32_t driven = 0;
+    uint32_t level = 0;
+
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        const uint32_t pins = emu_gpio_pio[p] & emu_gpio_oe;
+
+        driven |= pins;
+        level |= emu_pio[p].pin_out & pins;
+    }
+    for (uint32_t mics = emu_mic_pins & ~driven; mics; mics &= mics - 1) {
+        const uint pin = __builtin_ctz(mics);
+        const size_t bit = emu_mic[pin].edges;
+
+        if (bit < emu_mic[pin].n_bits) {
+            level |= (uint32_t)(emu_mic[pin].pdm[bit / 8] >> (7 - bit % 8) & 1) << pin;
+        }
+    }
+
+    return level;
+}
+
+static bool emu_sm_push(struct emu_sm* s, bool block) {
+    const uint depth = (s->config.fifo_join == PIO_FIFO_JOIN_RX) ? 2 * EMU_FIFO_DEPTH : EMU_FIFO_DEPTH;
+
+    if (s->rx_level == depth) {
+        if (block) {
+            return false;
+        }
+        emu_stats.rx_dropped++;
+    } else {
+        s->rx_fifo[(s->rx_head + s->rx_level++) % depth] = s->isr;
+    }
+    s->isr = 0;
+    s->isr_count = 0;
+
+    return true;
+}
+
+// one cycle of state machine sm, reading the pins as they were at its start
+static void emu_sm_step(uint p, uint sm, uint32_t pins) {
+    struct emu_sm* s = &emu_pio[p].sm[sm];
+    const pio_sm_config* c = &s->config;
+
+    s->clkdiv_acc += 256;
+    if (s->clkdiv_acc < c->clkdiv) {
+        return;
+    }
+    s->clkdiv_acc -= c->clkdiv;
+
+    if (s->delay) {
+        s->delay--;
+        return;
+    }
+
+    const uint16_t instr = emu_pio[p].instr[s->pc];
+    const uint field = (instr >> 8) & 0x1F;
+    const uint side_bits = c->sideset_count;
+    const uint delay_bits = 5 - side_bits;
+    const uint arg = instr & 0xFF;
+    bool stalled = false;
+
+    if (side_bits && (!c->sideset_optional || (field >> 4))) {
+        const uint n = side_bits - c->sideset_optional;
+        const uint side = (field >> delay_bits) & ((1u << n) - 1);
+
+        if (c->sideset_pindirs) {
+            emu_panic("side-set pindirs are not emulated");
+        }
+        for (uint i = 0; i < n; i++) {
+            const uint pin = (c->sideset_base + i) % 32;
+
+            s->side_mask |= 1u << pin;
+            s->side_level = (s->side_level & ~(1u << pin)) | ((side >> i & 1) << pin);
+        }
+    }
+
+    switch (instr >> 13) {
+    case 0: // JMP, unconditional only
+        if ((arg >> 5) != 0) {
+            emu_panic("JMP condition %u is not emulated", arg >> 5);
+        }
+        s->pc = arg & 0x1F;
+        s->delay = field & ((1u << delay_bits) - 1);
+        return;
+
+    case 2: { // IN
+        const uint n = (arg & 0x1F) ? (arg & 0x1F) : 32;
+        uint32_t data;
+
+        switch (arg >> 5) {
+        case 0: data = (pins >> c->in_base) | (c->in_base ? pins << (32 - c->in_base) : 0); break;
+        case 1: data = s->x; break;
+        case 2: data = s->y; break;
+        case 3: data = 0; break;
+        default: emu_panic("IN source %u is not emulated", arg >> 5);
+        }
+        if (n < 32) {
+            data &= (1u << n) - 1;
+        }
+
+        if (n == 32) {
+            s->isr = data;
+        } else if (c->in_shift_right) {
+            s->isr = (s->isr >> n) | (data << (32 - n));
+        } else {
+            s->isr = (s->isr << n) | data;
+        }
+        s->isr_count = (s->isr_count + n > 32) ? 32 : s->isr_count + n;
+        break;
+    }
+
+    case 4: // PUSH (PULL is not emulated)
+        if (arg & 0x80) {
+            emu_panic("PULL is not emulated");
+        }
+        if (!(arg & 0x40) || s->isr_count >= c->push_threshold) {
+            stalled = !emu_sm_push(s, arg & 0x20);
+        }
+        break;
+
+    case 5: // MOV between X, Y and NULL (nop is mov y, y)
+        if ((arg & 0x18) || ((arg >> 5) != 1 && (arg >> 5) != 2) || ((arg & 7) != 1 && (arg & 7) != 2 && (arg & 7) != 3)) {
+            emu_panic("MOV %02x is not emulated", arg);
+        } else {
+            const uint32_t data = ((arg & 7) == 1) ? s->x : ((arg & 7) == 2) ? s->y : 0;
+
+            if ((arg >> 5) == 1) {
+                s->x = data;
+            } else {
+                s->y = data;
+            }
+        }
+        break;
+
+    default:
+        emu_panic("instruction %04x is not emulated", instr);
+    }
+
+    if (stalled) {
+        return;
+    }
+    s->delay = field & ((1u << delay_bits) - 1);
+    s->pc = (s->pc == c->wrap) ? c->wrap_target : (s->pc + 1) % PIO_INSTRUCTION_COUNT;
+}
+
+// one clk_sys cycle of the ADC: a conversion every 1 + clkdiv clk_adc cycles
+// (96 at least), pushed to the FIFO, then the next input of the round robin
+static void emu_adc_step(void) {
+    const uint64_t period = (emu_adc.clkdiv + 256 > EMU_ADC_CYCLES_MIN * 256) ? emu_adc.clkdiv + 256 : EMU_ADC_CYCLES_MIN * 256;
+
+    if (!emu_adc.running) {
+        return;
+    }
+    emu_adc.acc += (uint64_t)clock_get_hz(clk_adc) * 256;
+    if (emu_adc.acc < period * PICO_EMU_SYS_HZ) {
+        return;
+    }
+    emu_adc.acc -= period * PICO_EMU_SYS_HZ;
+
+    if (emu_adc.fifo_enabled) {
+        if (emu_adc.fifo_level == EMU_FIFO_DEPTH) {
+            emu_stats.adc_dropped++;
+        } else {
+            const uint16_t code = emu_adc.source ? emu_adc.source(emu_adc.input) & 0xFFF : 0;
+
+            emu_adc.fifo[(emu_adc.fifo_head + emu_adc.fifo_level++) % EMU_FIFO_DEPTH] = code;
+        }
+    }
+
+    for (uint i = 1; emu_adc.round_robin && i <= EMU_ADC_INPUTS; i++) {
+        const uint input = (emu_adc.input + i) % EMU_ADC_INPUTS;
+
+        if (emu_adc.round_robin & (1u << input)) {
+            emu_adc.input = input;
+            break;
+        }
+    }
+}
+
+// the PIO RX FIFO at addr, if any
+static struct emu_sm* emu_rx_fifo(uint32_t addr) {
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            if (addr == emu_addr(&pio_emu_hw[p].rxf[sm])) {
+                return &emu_pio[p].sm[sm];
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static bool emu_dreq(uint dreq) {
+    if (dreq == DREQ_FORCE) {
+        return true;
+    }
+    if (dreq == DREQ_ADC) {
+        return emu_adc.dreq_enabled && emu_adc.fifo_level >= emu_adc.dreq_threshold;
+    }
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        const uint rx0 = p ? DREQ_PIO1_RX0 : DREQ_PIO0_RX0;
+
+        if (dreq >= rx0 && dreq < rx0 + NUM_PIO_STATE_MACHINES) {
+            return emu_pio[p].sm[dreq - rx0].rx_level > 0;
+        }
+    }
+    emu_panic("DREQ %u is not emulated", dreq);
+
+    return false;
+}
+
+static uint32_t emu_dma_read(uint32_t addr, uint size) {
+    struct emu_sm* s = emu_rx_fifo(addr);
+    uint32_t data = 0;
+
+    if (s) {
+        const uint depth = (s->config.fifo_join == PIO_FIFO_JOIN_RX) ? 2 * EMU_FIFO_DEPTH : EMU_FIFO_DEPTH;
+
+        // a narrow read of the FIFO register takes its low lanes, and pops it
+        if (s->rx_level == 0) {
+            emu_panic("DMA read of an empty RX FIFO");
+        }
+        data = s->rx_fifo[s->rx_head];
+        s->rx_head = (s->rx_head + 1) % depth;
+        s->rx_level--;
+
+        return (size == 4) ? data : data & ((1u << (8 * size)) - 1);
+    }
+
+    if (addr == emu_addr(&adc_hw->fifo)) {
+        if (emu_adc.fifo_level == 0) {
+            emu_panic("DMA read of an empty ADC FIFO");
+        }
+        data = emu_adc.fifo[emu_adc.fifo_head];
+        emu_adc.fifo_head = (emu_adc.fifo_head + 1) % EMU_FIFO_DEPTH;
+        emu_adc.fifo_level--;
+
+        return data;
+    }
+
+    memcpy(&data, (const void*)(uintptr_t)addr, size);
+
+    return data;
+}
+
+// register aliases by word offset: 0 read address, 1 write address, 2 transfer count, 3 control
+static const uint8_t emu_dma_alias_reg[16] = { 0, 1, 2, 3, 3, 0, 1, 2, 3, 2, 0, 1, 3, 1, 2, 0 };
+
+static void emu_dma_write(uint channel, uint32_t addr, uint32_t data, uint size) {
+    const uint32_t regs = emu_addr(&dma_hw->ch[0]);
+
+    if (addr >= regs && addr < regs + sizeof(dma_hw->ch)) {
+        const uint target = (addr - regs) / sizeof(dma_channel_hw_t);
+        const uint word = (addr - regs) % sizeof(dma_channel_hw_t) / 4;
+        const bool trigger = (word % 4 == 3);
+
+        if (size != 4) {
+            emu_panic("narrow DMA register write");
+        }
+        switch (emu_dma_alias_reg[word]) {
+        case 0: dma_hw->ch[target].read_addr = data; break;
+        case 1: dma_hw->ch[target].write_addr = data; break;
+        case 2: dma_channel_set_trans_count(target, data, false); break;
+        default: emu_panic("DMA control register writes are not emulated");
+        }
+        if (trigger && data) {
+            emu_dma_trigger(target);
+        }
+
+        return;
+    }
+
+    memcpy((void*)(uintptr_t)addr, &data, size);
+    if (emu_dma_trace) {
+        emu_dma_trace(channel, emu_dma[channel].config.dreq, (const uint8_t*)(uintptr_t)addr, size);
+    }
+}
+
+static uint32_t emu_dma_advance(uint32_t addr, uint size, uint ring_bits) {
+    if (!ring_bits) {
+        return addr + size;
+    }
+
+    const uint32_t ring = (1u << ring_bits) - 1;
+
+    return (addr & ~ring) | ((addr + size) & ring);
+}
+
+// one transfer of each busy channel its DREQ lets through
+static void emu_dma_step(void) {
+    for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+        dma_channel_hw_t* hw = &dma_hw->ch[channel];
+        const dma_channel_config* c = &emu_dma[channel].config;
+        const uint size = 1u << c->size;
+
+        if (!emu_dma[channel].busy || !emu_dreq(c->dreq)) {
+            continue;
+        }
+        if (hw->transfer_count == 0) {
+            emu_dma[channel].busy = false;
+            continue;
+        }
+
+        const uint32_t read_addr = hw->read_addr;
+        const uint32_t write_addr = hw->write_addr;
+        uint32_t data = emu_dma_read(read_addr, size);
+
+        if (c->bswap && size == 2) {
+            data = ((data & 0xFF) << 8) | (data >> 8);
+        } else if (c->bswap && size == 4) {
+            data = __builtin_bswap32(data);
+        }
+
+        if (c->read_increment) {
+            hw->read_addr = emu_dma_advance(read_addr, size, c->ring_write ? 0 : c->ring_size_bits);
+        }
+        if (c->write_increment) {
+            hw->write_addr = emu_dma_advance(write_addr, size, c->ring_write ? c->ring_size_bits : 0);
+        }
+        hw->transfer_count--;
+        emu_stats.dma_transfers++;
+
+        // a register trigger may start another channel, or restart this one
+        const bool last = (hw->transfer_count == 0);
+        if (last) {
+            emu_dma[channel].busy = false;
+        }
+        emu_dma_write(channel, write_addr, data, size);
+
+        if (last) {
+            if (!c->irq_quiet) {
+                emu_dma_intr |= 1u << channel;
+            }
+            if (c->chain_to != channel) {
+                emu_dma_trigger(c->chain_to);
+            }
+        }
+    }
+}
+
+// each pending channel on its own (see pico_emu.h)
+static void emu_irq_step(void) {
+    for (uint line = 0; line < 2; line++) {
+        const uint num = line ? DMA_IRQ_1 : DMA_IRQ_0;
+        volatile uint32_t* ints = line ? &dma_hw->ints1 : &dma_hw->ints0;
+        const uint32_t pending = emu_dma_intr & (line ? dma_hw->inte1 : dma_hw->inte0);
+
+        if (!pending || !emu_irq[num].enabled || !emu_irq[num].n_handlers) {
+            continue;
+        }
+
+        for (uint channel = 0; channel < NUM_DMA_CHANNELS; channel++) {
+            if (!(pending & (1u << channel))) {
+                continue;
+            }
+
+            // the other line's INTS reads all its pending channels, which
+            // a late handler finds there too
+            const uint32_t other = emu_dma_intr & (line ? dma_hw->inte0 : dma_hw->inte1);
+
+            dma_hw->ints0 = line ? other : 0;
+            dma_hw->ints1 = line ? 0 : other;
+            *ints = 1u << channel;
+            for (uint i = 0; i < emu_irq[num].n_handlers; i++) {
+                emu_irq[num].handlers[i]();
+            }
+            emu_dma_intr &= ~((1u << channel) | other);
+            emu_stats.irqs++;
+        }
+        dma_hw->ints0 = 0;
+        dma_hw->ints1 = 0;
+    }
+}
+
+void pico_emu_run(uint64_t cycles) {
+    emu_running = true;
+
+    for (uint64_t cycle = 0; cycle < cycles; cycle++) {
+        const uint32_t pins = emu_gpio_in();
+
+        for (uint p = 0; p < NUM_PIOS; p++) {
+            uint32_t side_mask = 0;
+            uint32_t side_level = 0;
+            bool conflict = false;
+
+            for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+                const struct emu_sm* s = &emu_pio[p].sm[sm];
+
+                if (!s->enabled) {
+                    continue;
+                }
+                emu_sm_step(p, sm, pins);
+
+                // the last one to side-set a pin sets it; each of them would keep setting its own level
+                conflict |= ((side_level ^ s->side_level) & side_mask & s->side_mask) != 0;
+                side_mask |= s->side_mask;
+                side_level = (side_level & ~s->side_mask) | s->side_level;
+            }
+            emu_pio[p].pin_out = (emu_pio[p].pin_out & ~side_mask) | side_level;
+            emu_stats.pin_conflicts += conflict;
+        }
+
+        const uint32_t level = emu_gpio_in();
+        const uint32_t rising = level & ~emu_gpio_level;
+
+        emu_gpio_level = level;
+        for (uint32_t pins = rising; pins; pins &= pins - 1) {
+            const uint pin = __builtin_ctz(pins);
+
+            emu_stats.rising_edges[pin]++;
+            for (uint32_t mics = emu_mic_pins; mics; mics &= mics - 1) {
+                if (emu_mic[__builtin_ctz(mics)].clk_pin == pin) {
+                    emu_mic[__builtin_ctz(mics)].edges++;
+                }
+            }
+        }
+
+        emu_adc_step();
+        emu_dma_step();
+        emu_irq_step();
+        emu_stats.cycles++;
+    }
+
+    emu_running = false;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// Host emulation of the RP2040 parts the capture drivers use, behind the
+// stubbed SDK headers: both PIO blocks run their loaded programs cycle by
+// cycle (with the fractional clock dividers, side-set, IN, PUSH and the RX
+// FIFOs), the DMA channels move data as their DREQs allow (sizes, bswap,
+// increments, read rings, chaining and register triggers), and the DMA IRQ
+// lines call the shared handlers. The ADC converts its inputs (round robin)
+// at its divider's rate, into its FIFO and DREQ. The emulated hardware only
+// advances in pico_emu_run() and in tight_loop_contents() on core0.
+//
+// Plain stores to INTS0/INTS1 cannot clear bits the way the write-1-to-clear
+// registers do, so each pending channel is raised on its own, with only its
+// bit set in the line's INTS register (the other line's INTS register holds
+// all of its pending channels, as a handler running late would find them),
+// and those count as acknowledged after the handlers ran. Masking a line with
+// irq_set_enabled() holds its channels pending. DMA addresses are 32 bits: link the tests with -no-pie, so
+// that statics and the heap stay below 4 GB.
+
+#ifndef _PICO_EMU_H
+#define _PICO_EMU_H
+
+#include "hardware/adc.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+#define PICO_EMU_SYS_HZ 125000000
+#define PICO_EMU_GPIOS 30
+
+struct pico_emu_stats {
+    uint64_t cycles; // clk_sys cycles emulated
+    uint32_t rising_edges[PICO_EMU_GPIOS]; // of the pin levels
+    uint32_t pin_conflicts; // cycles in which state machines side-setting one pin hold it at different levels
+    uint32_t rx_dropped; // pushes a full RX FIFO dropped (noblock)
+    uint32_t adc_dropped; // conversions a full ADC FIFO dropped
+    uint32_t dma_transfers;
+    uint32_t irqs; // handler calls, one per pending channel of the line raised
+};
+
+// a PDM microphone on data_pin, outputting the bits of pdm (MSB of each byte
+// first), the next one on each rising edge of clk_pin, then 0s
+void pico_emu_connect_mic(uint data_pin, uint clk_pin, const uint8_t* pdm, size_t n_bytes);
+void pico_emu_disconnect_mics(void);
+
+void pico_emu_run(uint64_t cycles);
+const struct pico_emu_stats* pico_emu_get_stats(void);
+
+// called with each DMA write to memory, as the bytes land (little-endian)
+typedef void (*pico_emu_dma_trace_t)(uint channel, uint dreq, const uint8_t* data, uint size);
+void pico_emu_set_dma_trace(pico_emu_dma_trace_t trace);
+
+// the 12-bit code of each conversion of ADC input (0 - 4), 0 if none is set
+typedef uint16_t (*pico_emu_adc_input_t)(uint input);
+void pico_emu_set_adc_input(pico_emu_adc_input_t input);
+
+// bookkeeping the drivers must leave as they found it
+uint32_t pico_emu_instructions_used(PIO pio); // instruction memory slots, as a mask
+uint32_t pico_emu_dma_claimed(void); // channels, as a mask
+uint pico_emu_irq_handlers(uint num); // shared handlers added to an IRQ
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The oversampled ADC decimator (analog_decimator.c) at 4, 8, 16 and 32 times
+// oversampling: a tone with a DC offset and white noise of a couple of codes,
+// quantised to 12 bits, through analog_decimator_process(), against taking
+// every oversample-th conversion as it is. With the noise spread evenly up to
+// half the ADC's rate, decimating by R gains log2(sqrt(R)) effective bits;
+// the test asks for 90% of that, and for the tone to come out 16 times the
+// ADC code (built with UBSan, for the fixed point scaling).
+
+#include "analog_decimator.h"
+
+#include "test_common.h"
+
+#define ADC_HZ_MAX 384000 // conversions per second, all channels
+#define FS_MAX 48000
+#define N 8192 // output samples analysed
+#define SKIP 8192 // output samples skipped while the filters and the DC blocker settle on the offset
+#define BIAS 1551 // ADC code at 0 V
+#define OFFSET 40 // codes between the actual bias and the nominal one
+#define AMPLITUDE 1400.0 // codes
+#define NOISE 2.2 // codes rms
+#define TONE_HZ 997.0 // moved to a whole number of cycles in N samples, for test_sinad()
+#define ENOB_GAIN_MIN 0.9 // of log2(sqrt(R))
+#define GAIN_TOLERANCE 0.01
+
+static uint16_t adc[(SKIP + N) * 32];
+static int16_t out[SKIP + N];
+static double x[N];
+
+// normally distributed, by Box-Muller
+static double gauss(uint32_t* seed) {
+    const double u = (test_random(seed) + 1.0) / 4294967297.0;
+    const double v = test_random(seed) / 4294967296.0;
+
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+static void run(uint8_t oversample) {
+    const uint32_t fs = (ADC_HZ_MAX / oversample < FS_MAX) ? ADC_HZ_MAX / oversample : FS_MAX;
+    const double adc_hz = (double)fs * oversample;
+    const double tone = round(TONE_HZ * N / fs) / N; // of fs
+    const size_t n_adc = (SKIP + N) * oversample;
+    struct analog_decimator dec;
+    int16_t* o[1] = { out };
+    uint32_t seed = 1;
+
+    TEST_CHECK(analog_decimator_init(&dec, 1, oversample, BIAS, fs) == 0, "%ux: init failed", oversample);
+    analog_decimator_reset(&dec);
+
+    for (size_t i = 0; i < n_adc; i++) {
+        const long code = lround(BIAS + OFFSET + AMPLITUDE * sin(2 * M_PI * tone * fs * i / adc_hz) + NOISE * gauss(&seed));
+
+        adc[i] = (code < 0) ? 0 : (code > 4095) ? 4095 : code;
+    }
+    analog_decimator_process(&dec, adc, o, SKIP + N);
+
+    // the raw path: every oversample-th conversion, scaled as the decimator's output
+    for (size_t i = 0; i < N; i++) {
+        x[i] = ((int32_t)adc[(SKIP + i) * oversample] - BIAS) * 16.0;
+    }
+    const double raw_sinad = test_sinad(x, N, tone);
+
+    for (size_t i = 0; i < N; i++) {
+        x[i] = out[SKIP + i];
+    }
+    const double sinad = test_sinad(x, N, tone);
+    const double gain = test_tone_amplitude(x, N, tone) / (AMPLITUDE * 16);
+
+    const double enob_gain = (sinad - raw_sinad) / 6.02;
+    const double ideal = 0.5 * log2(oversample);
+
+    printf("%2ux at %5u Hz: SINAD %.1f dB decimated, %.1f dB raw, %.2f bits gained (ideal %.2f), tone gain %.4f\n",
+           oversample, fs, sinad, raw_sinad, enob_gain, ideal, gain);
+    TEST_CHECK(enob_gain >= ENOB_GAIN_MIN * ideal, "%ux: %.2f bits gained, %.2f ideal", oversample, enob_gain, ideal);
+    TEST_CHECK(fabs(gain - 1) < GAIN_TOLERANCE, "%ux: tone gain %.4f", oversample, gain);
+}
+
+int main() {
+    for (uint8_t oversample = 4; oversample <= 32; oversample *= 2) {
+        run(oversample);
+    }
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The analog microphone driver (analog_microphone.c) on the emulated ADC and
+// DMA (see stubs/pico_emu.h), with three mics from the second ADC input, each
+// conversion coding its input and its count of conversions so far:
+//  - ring: every DMA block lands in the next raw buffer of the ring, its
+//    address chained from the table, in order, lap after lap and again from
+//    the first after a restart
+//  - de-interleave: reads of 1 to 2 blocks' worth, across block boundaries,
+//    give each channel its own input's conversions, in order and without gaps
+//  - overrun: a reader half way through a block that lets the DMA get a whole
+//    ring ahead restarts half a ring behind it, counting the blocks dropped,
+//    and reads on from there
+// and the samples ready handler called once per block, with deinit releasing
+// the DMA channels and the IRQ handler.
+
+#include "pico/analog_microphone.h"
+
+#include "pico_emu.h"
+#include "test_common.h"
+
+#define FS 16000
+#define BLOCK 16 // samples per channel per DMA block
+#define CHANNELS 3
+#define GPIO 27 // ADC input 1
+#define COUNT 8 // raw buffers
+#define BLOCK_CONVERSIONS (BLOCK * CHANNELS)
+#define READS (5 * COUNT) // blocks read in order, five laps of the ring
+#define STEP_CYCLES 1000 // a conversion takes 2604
+
+static uint32_t conversions[4]; // per ADC input
+static uint32_t traced; // ADC conversions the DMA stored
+static uint32_t traced_base; // address of the first
+static uint32_t misplaced;
+static uint32_t ready_calls;
+static int16_t out[CHANNELS * 2 * BLOCK];
+
+// the input in the top bits, its conversions so far in the low 10
+static uint16_t adc_input(uint input) {
+    return (input << 10) | (conversions[input]++ & 0x3FF);
+}
+
+// conversion c into raw buffer (c / BLOCK_CONVERSIONS) % COUNT, in order
+static void trace(uint channel, uint dreq, const uint8_t* data, uint size) {
+    const uint32_t addr = (uint32_t)(uintptr_t)data;
+
+    (void)channel;
+    if (dreq != DREQ_ADC) {
+        return;
+    }
+    if (traced == 0 && traced_base == 0) {
+        traced_base = addr;
+    }
+
+    const uint32_t block = traced / BLOCK_CONVERSIONS;
+    const uint32_t expected = traced_base + 2 * ((block % COUNT) * BLOCK_CONVERSIONS + traced % BLOCK_CONVERSIONS);
+
+    misplaced += (size != 2 || addr != expected);
+    traced++;
+}
+
+static void samples_ready() {
+    ready_calls++;
+}
+
+static void start() {
+    memset(conversions, 0x00, sizeof(conversions));
+    traced = 0;
+    ready_calls = 0;
+    TEST_CHECK(analog_microphone_start() == 0, "start failed");
+}
+
+// n samples per channel, channel j at out + j * stride, are samples from
+// position on of input GPIO - 26 + j
+static uint32_t check_samples(uint32_t position, int n, size_t stride) {
+    uint32_t wrong = 0;
+
+    for (uint j = 0; j < CHANNELS; j++) {
+        const uint input = GPIO - 26 + j;
+
+        for (int i = 0; i < n; i++) {
+            wrong += (out[j * stride + i] != (int16_t)((input << 10) | ((position + i) & 0x3FF)));
+        }
+    }
+
+    return wrong;
+}
+
+// from position, in reads of 1 to 2 blocks' worth, waiting for the DMA
+static uint32_t read_in_order(uint32_t position, uint32_t n_samples, uint32_t* seed) {
+    const uint32_t end = position + n_samples;
+    uint32_t wrong = 0;
+
+    while (position < end) {
+        const uint32_t left = end - position;
+        const size_t chunk = (1 + test_random(seed) % (2 * BLOCK) < left) ? 1 + test_random(seed) % (2 * BLOCK) : left;
+        const int n = analog_microphone_read(out, chunk);
+
+        wrong += check_samples(position, n, chunk);
+        position += n;
+        if (n < (int)chunk) {
+            pico_emu_run(STEP_CYCLES);
+        }
+    }
+
+    return wrong;
+}
+
+static void check_ring(uint32_t* seed) {
+    struct analog_microphone_stats stats;
+
+    const uint32_t wrong = read_in_order(0, READS * BLOCK, seed);
+
+    analog_microphone_get_stats(&stats);
+    printf("ring: %u blocks written, %u read, %u conversions, %u misplaced, %u samples wrong\n", stats.blocks_written,
+           stats.blocks_read, traced, misplaced, wrong);
+    TEST_CHECK(wrong == 0, "ring: %u samples not from their input, in order", wrong);
+    TEST_CHECK(misplaced == 0, "ring: %u conversions outside their raw buffer", misplaced);
+    TEST_CHECK(stats.blocks_read == READS && stats.overruns == 0, "ring: %u blocks read, %u overruns", stats.blocks_read,
+               stats.overruns);
+    TEST_CHECK(ready_calls == stats.blocks_written, "ring: samples ready handler called %u times for %u blocks",
+               ready_calls, stats.blocks_written);
+    TEST_CHECK(pico_emu_get_stats()->adc_dropped == 0, "ring: %u conversions dropped by the ADC FIFO",
+               pico_emu_get_stats()->adc_dropped);
+}
+
+static void check_overrun(uint32_t* seed) {
+    struct analog_microphone_stats stats;
+
+    // half a block in, then a whole ring behind
+    for (analog_microphone_get_stats(&stats); stats.blocks_written == stats.blocks_read; analog_microphone_get_stats(&stats)) {
+        pico_emu_run(STEP_CYCLES);
+    }
+    TEST_CHECK(analog_microphone_read(out, BLOCK / 2) == BLOCK / 2, "overrun: short read");
+    const uint32_t read = stats.blocks_read;
+
+    while (stats.blocks_written - read < COUNT - 1) {
+        pico_emu_run(STEP_CYCLES);
+        analog_microphone_get_stats(&stats);
+    }
+    TEST_CHECK(stats.blocks_written - read == COUNT - 1, "overrun: %u blocks ahead", stats.blocks_written - read);
+
+    const uint32_t restart = stats.blocks_written - COUNT / 2;
+    const int n = analog_microphone_read(out, BLOCK);
+    const uint32_t wrong = check_samples(restart * BLOCK, n, BLOCK);
+
+    analog_microphone_get_stats(&stats);
+    printf("overrun: %u blocks ahead, restarted at block %u, %u dropped, %u samples wrong\n", COUNT - 1, restart,
+           stats.blocks_dropped, wrong);
+    TEST_CHECK(n == BLOCK && wrong == 0, "overrun: %d samples read, %u not from block %u on", n, wrong, restart);
+    TEST_CHECK(stats.overruns == 1 && stats.blocks_dropped == restart - read, "overrun: %u overruns, %u blocks dropped",
+               stats.overruns, stats.blocks_dropped);
+
+    // and on from there
+    const uint32_t after = read_in_order((restart + 1) * BLOCK, 2 * COUNT * BLOCK, seed);
+
+    analog_microphone_get_stats(&stats);
+    TEST_CHECK(after == 0 && stats.overruns == 1, "overrun: %u samples wrong, %u overruns after the restart", after,
+               stats.overruns);
+}
+
+int main() {
+    const struct analog_microphone_config config = {
+        .gpio = GPIO,
+        .bias_voltage = 0,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .channels = CHANNELS,
+        .raw_buffer_count = COUNT,
+    };
+    uint32_t seed = 1;
+
+    pico_emu_set_adc_input(adc_input);
+    pico_emu_set_dma_trace(trace);
+
+    TEST_CHECK(analog_microphone_init(&config) == 0, "init failed");
+    analog_microphone_set_samples_ready_handler(samples_ready);
+    start();
+    check_ring(&seed);
+    check_overrun(&seed);
+
+    // a restart fills the ring from its first raw buffer again
+    analog_microphone_stop();
+    misplaced = 0;
+    start();
+    const uint32_t wrong = read_in_order(0, 2 * COUNT * BLOCK, &seed);
+
+    printf("restart: %u conversions, %u misplaced, %u samples wrong\n", traced, misplaced, wrong);
+    TEST_CHECK(wrong == 0 && misplaced == 0, "restart: %u samples wrong, %u conversions misplaced", wrong, misplaced);
+
+    analog_microphone_deinit();
+    TEST_CHECK(pico_emu_dma_claimed() == 0 && pico_emu_irq_handlers(DMA_IRQ_0) == 0,
+               "deinit: DMA channels %03x claimed, %u IRQ handlers", pico_emu_dma_claimed(),
+               pico_emu_irq_handlers(DMA_IRQ_0));
+
+    return 0;
+}
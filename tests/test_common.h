@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+#ifndef _TEST_COMMON_H_
+#define _TEST_COMMON_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/pdm_profile.h"
+
+// Helpers shared by the host tests: a failed check prints where and exits
+// with 1, which ctest reports as a failure.
+
+#define TEST_CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        exit(1); \
+    } \
+} while (0)
+
+// xorshift32, the same generator as the synthetic source's noise
+static inline uint32_t test_random(uint32_t* state) {
+    uint32_t x = *state;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+// PDM bit stream, the MSB of each byte first, of a 2nd order sigma-delta
+// modulator (noise transfer function (1 - z^-1)^2) fed x(bit), one of +/-32768
+// full scale; stable up to about 0.7 of it
+struct test_modulator {
+    int32_t e1;
+    int32_t e2;
+};
+
+static inline uint8_t test_modulate_bit(struct test_modulator* m, int32_t x) {
+    const int32_t u = x - 2 * m->e1 + m->e2;
+    const uint8_t bit = (u >= 0);
+
+    m->e2 = m->e1;
+    m->e1 = (bit ? 32768 : -32768) - u;
+
+    return bit;
+}
+
+// n_bytes of a tone at amplitude (of 32768), period PDM bits per cycle
+static inline void test_modulate_tone(uint8_t* pdm, size_t n_bytes, double amplitude, double period, double phase) {
+    struct test_modulator m = { 0, 0 };
+
+    for (size_t i = 0; i < n_bytes; i++) {
+        uint8_t byte = 0;
+
+        for (int k = 0; k < 8; k++) {
+            const double t = (double)(i * 8 + k) / period;
+            const int32_t x = lround(amplitude * sin(2 * M_PI * t + phase));
+
+            byte = (byte << 1) | test_modulate_bit(&m, x);
+        }
+        pdm[i] = byte;
+    }
+}
+
+// bit-interleaved raw PIO words of 2 or 4 microphones, as the
+// pdm_microphone_data_n2/n4 programs and their DMA store them: bit k (LSB = 0)
+// of a channel's byte lands at bit channels * k + ch of its 8 * channels bits,
+// and each 32-bit word holds 32 / channels samples per channel, earliest first
+static inline void test_interleave(uint8_t* out, uint8_t* in[], unsigned channels, size_t n_bytes) {
+    uint32_t* words = (uint32_t*)out;
+
+    for (size_t i = 0; i < n_bytes; i++) {
+        uint32_t bits = 0;
+
+        for (unsigned ch = 0; ch < channels; ch++) {
+            for (unsigned k = 0; k < 8; k++) {
+                bits |= (uint32_t)((in[ch][i] >> k) & 1) << (channels * k + ch);
+            }
+        }
+
+        if (channels == 4) {
+            words[i] = bits;
+        } else if (i & 1) {
+            words[i / 2] |= bits << 16;
+        } else {
+            words[i / 2] = bits;
+        }
+    }
+}
+
+// seconds between two pdm_profile_now() ticks
+static inline double test_seconds(uint32_t start, uint32_t end) {
+    return (double)(uint32_t)(end - start) / pdm_profile_tick_hz();
+}
+
+// least squares fit of a sine at frequency (of the sample rate) to x: the
+// ratio of the fitted tone's power to the residual's, in dB (SINAD)
+static inline double test_sinad(const double* x, size_t n, double frequency) {
+    double s = 0, c = 0, m = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        m += x[i];
+    }
+    m /= n;
+    for (size_t i = 0; i < n; i++) {
+        s += (x[i] - m) * sin(2 * M_PI * frequency * i);
+        c += (x[i] - m) * cos(2 * M_PI * frequency * i);
+    }
+    s *= 2.0 / n;
+    c *= 2.0 / n;
+
+    double signal = 0, residual = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const double fit = s * sin(2 * M_PI * frequency * i) + c * cos(2 * M_PI * frequency * i);
+
+        signal += fit * fit;
+        residual += (x[i] - m - fit) * (x[i] - m - fit);
+    }
+
+    return 10 * log10(signal / residual);
+}
+
+// amplitude of the tone at frequency (of the sample rate) in x
+static inline double test_tone_amplitude(const double* x, size_t n, double frequency) {
+    double s = 0, c = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        s += x[i] * sin(2 * M_PI * frequency * i);
+        c += x[i] * cos(2 * M_PI * frequency * i);
+    }
+
+    return 2.0 / n * sqrt(s * s + c * c);
+}
+
+#endif
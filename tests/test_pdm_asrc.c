@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The resampling loop of pdm_microphone_resample() against a drifting clock:
+// a producer completing whole raw buffers at 16 kHz plus or minus several
+// hundred ppm into a pdm_ring, and a consumer taking 1 ms blocks at exactly
+// 16 kHz with a little jitter, as USB frames would. The fill level, margins
+// and resync are the driver's. After the loop locks, the fill level must stay
+// between the margins (so no resyncs) and the ratio trim must match the drift.
+// The fill level is only known to a whole raw buffer, so the trim wobbles by
+// about +/-150 ppm around the drift and is checked on average.
+
+#include "pdm_asrc.h"
+#include "pdm_ring.h"
+
+#include "test_common.h"
+
+#define FS 16000
+#define BLOCK 16 // samples per raw buffer, and per read
+#define COUNT 8 // raw buffers
+#define SECONDS 120
+#define LOCK_SECONDS 30 // settling allowed before the checks
+#define TRIM_SECONDS 60 // trim averaged over the last TRIM_SECONDS
+#define TRIM_ERROR_PPM 10 // vs the drift
+
+static int16_t in[PDM_ASRC_INPUT_MAX(BLOCK)];
+static int16_t out[BLOCK];
+
+static void run(double ppm) {
+    const int total = COUNT * BLOCK;
+    const int margin = 2 * BLOCK;
+    const double producer_hz = FS * (1 + ppm * 1e-6);
+    static struct pdm_asrc asrc;
+    struct pdm_ring ring;
+    uint32_t seed = 1;
+    uint read_offset = 0;
+    int lo = total, hi = 0, resyncs = 0, locked_resyncs = 0;
+    double trim = 0;
+
+    pdm_ring_init(&ring, COUNT, COUNT / 2);
+    pdm_asrc_init(&asrc, 1, COUNT / 2 * BLOCK);
+
+    for (long k = 0; k < SECONDS * 1000L; k++) {
+        int16_t* i[1] = { in };
+        int16_t* o[1] = { out };
+        const bool locked = (k >= LOCK_SECONDS * 1000L);
+
+        // raw buffers completed by now, the read jittering by up to +/-250 us
+        const double t = (k + 1 + (int32_t)test_random(&seed) / (double)INT32_MAX / 4) * 1e-3;
+        pdm_ring_publish(&ring, (uint32_t)(t * producer_hz / BLOCK));
+
+        const uint32_t blocks = ring.written - ring.read;
+        int fill = (blocks > ring.count) ? total : (int)(blocks * BLOCK - read_offset);
+
+        if (fill < margin || fill > total - margin) {
+            resyncs++;
+            locked_resyncs += locked;
+            pdm_ring_resync(&ring, ring.count / 2);
+            read_offset = 0;
+            fill = asrc.target_fill;
+            pdm_asrc_resync(&asrc);
+        }
+
+        pdm_asrc_update(&asrc, fill);
+
+        const size_t n_in = pdm_asrc_input_needed(&asrc, BLOCK);
+        TEST_CHECK(n_in <= PDM_ASRC_INPUT_MAX(BLOCK), "%.0f ppm: %zu input samples", ppm, n_in);
+        for (size_t j = 0; j < n_in; j++) {
+            in[j] = (int16_t)(8000 * sin(2 * M_PI * 1000 * (ring.read * BLOCK + read_offset + j) / producer_hz));
+        }
+        read_offset += n_in;
+        while (read_offset >= BLOCK) {
+            read_offset -= BLOCK;
+            pdm_ring_release(&ring);
+        }
+        pdm_asrc_process(&asrc, i, o, BLOCK);
+
+        if (locked) {
+            lo = (fill < lo) ? fill : lo;
+            hi = (fill > hi) ? fill : hi;
+        }
+        if (k >= (SECONDS - TRIM_SECONDS) * 1000L) {
+            trim += asrc.adjust / 4294.967296 / (TRIM_SECONDS * 1000);
+        }
+    }
+
+    printf("%+5.0f ppm: fill %d - %d after %d s (target %ld, margins %d - %d), trim %+6.1f ppm, %d resyncs before lock\n", ppm,
+           lo, hi, LOCK_SECONDS, (long)asrc.target_fill, margin, total - margin, trim, resyncs - locked_resyncs);
+    TEST_CHECK(locked_resyncs == 0, "%.0f ppm: %d resyncs after lock", ppm, locked_resyncs);
+    TEST_CHECK(lo >= margin && hi <= total - margin, "%.0f ppm: fill %d - %d", ppm, lo, hi);
+    TEST_CHECK(fabs(trim - ppm) < TRIM_ERROR_PPM, "%.0f ppm: trim %.1f ppm", ppm, trim);
+}
+
+int main() {
+    static const double ppms[] = { -800, -500, -300, -100, 0, 100, 300, 500, 800 };
+
+    for (size_t i = 0; i < sizeof(ppms) / sizeof(ppms[0]); i++) {
+        run(ppms[i]);
+    }
+
+    return 0;
+}
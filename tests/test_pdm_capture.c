@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The capture path on the emulated PIO and DMA (see stubs/pico_emu.h): the
+// real programs from pdm_microphone.pio, set up by the driver for 1, 2 and 4
+// bit-interleaved mics and 1, 2 and 4 planar lanes, with the DMA either
+// serviced by the IRQ handlers or free running. Each microphone outputs its own
+// pattern. Every byte the DMA stores must be where the filters expect it (the
+// mic's bytes, MSB first, for a planar lane or a single mic, test_interleave()
+// of them for 2 or 4 bit-interleaved mics), the samples read must equal the filter bank's output
+// for the mics' streams, and the state machines sharing the clock pin must
+// never drive it apart, with one rising edge per PDM bit.
+
+#include "hardware/clocks.h"
+#include "pico/pdm_microphone.h"
+#include "OpenPDMFilter.h"
+#include "pdm_microphone.pio.h"
+
+#include "pico_emu.h"
+#include "test_common.h"
+
+#define FS 16000
+#define DECIMATION 48
+#define BLOCK 16 // samples per raw buffer
+#define COUNT 8 // raw buffers
+#define READS 24 // blocks read, three laps of the raw buffers
+#define SAMPLES (READS * BLOCK)
+#define PDM_BYTES (SAMPLES * DECIMATION / 8)
+#define GPIO_DATA 2
+#define GPIO_CLK 10
+
+static uint8_t pdm[PDM_CHANNELS_MAX][PDM_BYTES];
+static uint32_t expected_raw[PDM_BYTES * PDM_CHANNELS_MAX / 4];
+static uint8_t captured[PDM_CHANNELS_MAX][PDM_BYTES * PDM_CHANNELS_MAX];
+static size_t captured_size[PDM_CHANNELS_MAX];
+static uint captured_dreq0; // DREQ of lane 0's state machine
+static int16_t expected[PDM_CHANNELS_MAX][SAMPLES];
+static int16_t out[PDM_CHANNELS_MAX * 2 * BLOCK];
+static TPDMFilterBank_InitStruct bank;
+
+// what the DMA stores from each lane's state machine, in order
+static void trace(uint channel, uint dreq, const uint8_t* data, uint size) {
+    const uint lane = dreq - captured_dreq0;
+
+    (void)channel;
+    if (lane >= PDM_CHANNELS_MAX) {
+        return;
+    }
+    if (captured_size[lane] + size <= sizeof(captured[lane])) {
+        memcpy(captured[lane] + captured_size[lane], data, size);
+    }
+    captured_size[lane] += size;
+}
+
+// tones of a different pitch per mic, and a counting pattern in the first
+// bytes, so that a misplaced bit, byte or channel shows
+static void make_streams() {
+    for (uint j = 0; j < PDM_CHANNELS_MAX; j++) {
+        test_modulate_tone(pdm[j], PDM_BYTES, 16384, (8 + 5 * j) * DECIMATION, j);
+
+        for (uint i = 0; i < 64; i++) {
+            pdm[j][i] = (uint8_t)(i * 0x11 + j * 0x40 + 1);
+        }
+    }
+}
+
+static void run(uint channels, bool planar, bool free_running, PIO pio, uint pio_sm) {
+    const uint n_lanes = planar ? channels : 1;
+    const char* layout = planar ? "planar" : "interleaved";
+    const char* mode = free_running ? "free running" : "IRQ";
+    struct pdm_microphone_config config = {
+        .gpio_data = GPIO_DATA,
+        .gpio_clk = GPIO_CLK,
+        .pio = pio,
+        .pio_sm = pio_sm,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .planar = planar,
+        .channels = channels,
+        .decimation = DECIMATION,
+        .raw_buffer_count = COUNT,
+        .read_mode = PDM_MICROPHONE_READ_BLOCKING,
+        .free_running = free_running,
+    };
+
+    // the reference: the filter bank on the mics' streams
+    memset(&bank, 0, sizeof(bank));
+    bank.Fs = FS;
+    bank.LP_HZ = FS / 2;
+    bank.HP_HZ = 10;
+    bank.Channels = channels;
+    bank.Decimation = DECIMATION;
+    bank.MaxVolume = 64;
+    bank.Gain = 16;
+    Open_PDM_FilterBank_Init(&bank);
+    for (uint i = 0; i < READS; i++) {
+        uint8_t* in[PDM_CHANNELS_MAX];
+        uint16_t* o[PDM_CHANNELS_MAX];
+
+        for (uint j = 0; j < channels; j++) {
+            in[j] = pdm[j] + i * BLOCK * DECIMATION / 8;
+            o[j] = (uint16_t*)expected[j] + i * BLOCK;
+        }
+        Open_PDM_FilterBank_Process(in, o, BLOCK, bank.MaxVolume, &bank);
+    }
+
+    pdm_microphone_t* mic = pdm_microphone_create(&config);
+    TEST_CHECK(mic, "%u %s mics, %s: create failed", channels, layout, mode);
+
+    pico_emu_disconnect_mics();
+    for (uint j = 0; j < channels; j++) {
+        pico_emu_connect_mic(GPIO_DATA + j, GPIO_CLK, pdm[j], PDM_BYTES);
+    }
+    memset(captured_size, 0, sizeof(captured_size));
+    captured_dreq0 = pio_get_dreq(pio, pio_sm, false);
+    pico_emu_set_dma_trace(trace);
+
+    const struct pico_emu_stats* stats = pico_emu_get_stats();
+    const struct pico_emu_stats before = *stats;
+
+    TEST_CHECK(pdm_microphone_instance_start(mic) == 0, "%u %s mics, %s: start failed", channels, layout, mode);
+
+    // every other read asks for more than a block: a block comes back, with
+    // the channels as far apart as asked for
+    for (uint i = 0; i < READS; i++) {
+        const uint stride = (i % 2) ? 2 * BLOCK : BLOCK;
+        const int n = pdm_microphone_instance_read(mic, out, stride);
+
+        TEST_CHECK(n == BLOCK, "%u %s mics, %s: read %d samples", channels, layout, mode, n);
+        for (uint j = 0; j < channels; j++) {
+            for (uint k = 0; k < BLOCK; k++) {
+                TEST_CHECK(out[j * stride + k] == expected[j][i * BLOCK + k], "%u %s mics, %s: channel %u sample %u is %d, not %d",
+                           channels, layout, mode, j, i * BLOCK + k, out[j * stride + k], expected[j][i * BLOCK + k]);
+            }
+        }
+    }
+
+    const double pdm_clock_hz = pdm_microphone_instance_get_clock(mic)->pdm_clock_hz;
+    struct pdm_microphone_ring_stats ring;
+
+    pdm_microphone_instance_get_ring_stats(mic, &ring);
+    pdm_microphone_instance_stop(mic);
+    pico_emu_set_dma_trace(NULL);
+
+    // every byte stored in order, a whole lap of the raw buffers at least
+    const size_t lane_bytes = PDM_BYTES * channels / n_lanes;
+    if (!planar && channels > 1) {
+        uint8_t* in[PDM_CHANNELS_MAX];
+
+        for (uint j = 0; j < channels; j++) {
+            in[j] = pdm[j];
+        }
+        test_interleave((uint8_t*)expected_raw, in, channels, PDM_BYTES);
+    }
+    for (uint lane = 0; lane < n_lanes; lane++) {
+        const uint8_t* want = (planar || channels == 1) ? pdm[lane] : (const uint8_t*)expected_raw;
+        const size_t n = (captured_size[lane] < lane_bytes) ? captured_size[lane] : lane_bytes;
+
+        TEST_CHECK(n >= COUNT * BLOCK * DECIMATION / 8 * channels / n_lanes, "%u %s mics, %s: lane %u stored %zu bytes",
+                   channels, layout, mode, lane, captured_size[lane]);
+        for (size_t i = 0; i < n; i++) {
+            TEST_CHECK(captured[lane][i] == want[i], "%u %s mics, %s: lane %u byte %zu is %02x, not %02x", channels, layout,
+                       mode, lane, i, captured[lane][i], want[i]);
+        }
+    }
+
+    const uint64_t cycles = stats->cycles - before.cycles;
+    const uint32_t edges = stats->rising_edges[GPIO_CLK] - before.rising_edges[GPIO_CLK];
+    const double clock_hz = (double)edges * PICO_EMU_SYS_HZ / cycles;
+
+    printf("%u %-11s mics, %-12s: %5u PDM clocks at %.0f Hz (%.0f planned), %u DMA transfers, %u IRQs, %u raw buffers, "
+           "%u overruns\n", channels, layout, mode, edges, clock_hz, pdm_clock_hz, stats->dma_transfers - before.dma_transfers,
+           stats->irqs - before.irqs, ring.blocks_written, ring.overruns);
+    TEST_CHECK(stats->pin_conflicts == before.pin_conflicts, "%u %s mics, %s: %u cycles with the clock pin driven apart",
+               channels, layout, mode, stats->pin_conflicts - before.pin_conflicts);
+    TEST_CHECK(stats->rx_dropped == before.rx_dropped, "%u %s mics, %s: %u pushes dropped", channels, layout, mode,
+               stats->rx_dropped - before.rx_dropped);
+    TEST_CHECK(fabs(clock_hz - pdm_clock_hz) < pdm_clock_hz * 1e-3, "%u %s mics, %s: PDM clock %.0f Hz", channels, layout,
+               mode, clock_hz);
+    TEST_CHECK(ring.overruns == 0 && ring.underruns > 0, "%u %s mics, %s: %u overruns, %u underruns", channels, layout, mode,
+               ring.overruns, ring.underruns);
+    TEST_CHECK(free_running ? stats->irqs == before.irqs : stats->irqs - before.irqs >= ring.blocks_written * n_lanes,
+               "%u %s mics, %s: %u IRQs", channels, layout, mode, stats->irqs - before.irqs);
+
+    pdm_microphone_destroy(mic);
+    TEST_CHECK(pico_emu_dma_claimed() == 0 && pico_emu_instructions_used(pio) == 0, "%u %s mics, %s: not released", channels,
+               layout, mode);
+}
+
+// the emulator sees the conflict that pio_enable_sm_mask_in_sync() avoids:
+// two planar state machines started a cycle apart drive the clock pin apart
+static void run_out_of_sync() {
+    const pio_program_t* program = &pdm_microphone_data_n1_program;
+    const struct pico_emu_stats* stats = pico_emu_get_stats();
+    const uint32_t conflicts = stats->pin_conflicts;
+    const uint offset = pio_add_program(pio0, program);
+
+    for (uint sm = 0; sm < 2; sm++) {
+        pdm_microphone_data_planar_init(pio0, sm, offset, 4.0f, GPIO_DATA + sm, GPIO_CLK);
+    }
+    pio_sm_set_enabled(pio0, 0, true);
+    pico_emu_run(1);
+    pio_sm_set_enabled(pio0, 1, true);
+    pico_emu_run(1000);
+    pio_set_sm_mask_enabled(pio0, 3, false);
+    pio_remove_program(pio0, program, offset);
+
+    printf("2 planar state machines a cycle apart: %u cycles with the clock pin driven apart\n",
+           stats->pin_conflicts - conflicts);
+    TEST_CHECK(stats->pin_conflicts - conflicts > 100, "%u conflicts", stats->pin_conflicts - conflicts);
+}
+
+int main() {
+    static const uint channels[] = { 1, 2, 4 };
+
+    make_streams();
+
+    for (uint c = 0; c < 3; c++) {
+        for (int planar = 0; planar < 2; planar++) {
+            for (int free_running = 0; free_running < 2; free_running++) {
+                // both PIO blocks, and state machines other than 0 where the lanes leave room
+                const PIO pio = (c + planar) % 2 ? pio1 : pio0;
+                const uint pio_sm = planar ? NUM_PIO_STATE_MACHINES - channels[c] : 1 + (uint)free_running;
+
+                run(channels[c], planar, free_running, pio, pio_sm);
+            }
+        }
+    }
+
+    run_out_of_sync();
+
+    return 0;
+}
@@ -0,0 +1,322 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The multi-stage PDM decimator, for every decimation and half-band count it
+// supports:
+//  - frequency response: sigma-delta modulated tones through
+//    pdm_decimator_process(), checking the passband ripple up to 0.4 fs and
+//    the rejection of tones from 0.6 fs up that alias into it: those the
+//    half-bands remove, and those within 0.4 fs of a multiple of the CIC
+//    output rate, which the CIC folds straight into the passband and only its
+//    own response (around its nulls) attenuates
+//  - volume: the multiplier and shift stand for the gain they are computed
+//    from, including gains with no fractional bits left (shift 0) and gains
+//    too large to represent, which must saturate (built with UBSan, so an
+//    out of range shift fails the test too); the Q31 output matches the
+//    16-bit one and resolves steps finer than the 16-bit CIC scale
+//  - cost: ticks per output sample of each stage, timed in isolation, and the
+//    pdm_profile percentiles of whole pdm_decimator_process() calls
+//
+// pdm_decimator.c is included rather than linked, for its stage functions.
+
+#include "../src/pdm_decimator.c"
+
+#include "test_common.h"
+
+#define FS 16000
+#define N 2048 // output samples analysed per tone
+#define SKIP 512 // output samples skipped while the filters and DC blocker settle
+#define AMPLITUDE 16384.0
+
+#define PASSBAND_RIPPLE_DB 0.5
+#define STOPBAND_DB -50.0 // half-band stopband, measured -54 dB worst (at 0.6 fs)
+#define CIC_IMAGE_DB -28.0 // CIC images, measured -32 dB worst (1.6 fs with one half-band)
+
+struct config {
+    uint8_t decimation;
+    uint8_t hb_stages;
+};
+
+static const struct config configs[] = {
+    { 48, 1 }, { 64, 1 }, { 64, 2 }, { 128, 1 }, { 128, 2 },
+};
+
+static uint8_t pdm[(N + SKIP) * DECIMATION_MAX / 8];
+static int16_t out[N + SKIP];
+static int32_t out32[N + SKIP];
+static double x[N];
+
+// amplitude (of 32768) of the output tone at bin k of N, for an input tone
+// of cycles_per_sample cycles per output sample
+static double response(struct pdm_decimator* dec, double cycles_per_sample, int k) {
+    const uint D = dec->decimation;
+    const uint8_t* data[1] = { pdm };
+    int16_t* o[1] = { out };
+
+    test_modulate_tone(pdm, (N + SKIP) * D / 8, AMPLITUDE, D / cycles_per_sample, 0);
+    pdm_decimator_reset(dec);
+    pdm_decimator_process(dec, data, o, N + SKIP, 64);
+
+    for (int i = 0; i < N; i++) {
+        x[i] = out[SKIP + i];
+    }
+
+    return test_tone_amplitude(x, N, (double)k / N);
+}
+
+static void check_response(const struct config* c) {
+    struct pdm_decimator dec;
+    double ref, lo = 1e9, hi = 0;
+    double worst[2] = { -1e9, -1e9 }, worst_f[2] = { 0, 0 };
+
+    TEST_CHECK(pdm_decimator_init(&dec, 1, c->decimation, c->hb_stages, FS) == 0, "/%u, %u half-bands", c->decimation, c->hb_stages);
+
+    // passband: 0.02 - 0.4 fs
+    for (int k = N / 50; k <= 4 * N / 10; k += N / 40) {
+        const double a = response(&dec, (double)k / N, k);
+
+        lo = (a < lo) ? a : lo;
+        hi = (a > hi) ? a : hi;
+    }
+    ref = sqrt(lo * hi);
+    const double ripple = 20 * log10(hi / lo);
+
+    // stopband: tones from 0.6 fs to 4.1 fs, and the alias of each at k;
+    // [1] collects those within 0.4 fs of a multiple of the CIC output rate
+    static const double from[] = { 0.6, 0.7, 0.8, 0.9, 1.1, 1.3, 1.4, 1.6, 1.7, 1.9, 2.1, 2.3, 2.4, 2.6, 3.4, 3.6, 3.9, 4.1 };
+    const double cic_rate = 1 << c->hb_stages; // in fs
+
+    for (size_t i = 0; i < sizeof(from) / sizeof(from[0]); i++) {
+        const int m = (int)(from[i] + 0.5); // nearest multiple of fs
+        const int k_in = (int)(from[i] * N);
+        const int k = abs(k_in - m * N);
+        const double a = response(&dec, (double)k_in / N, k);
+        const double db = 20 * log10(a / ref);
+        const double image = cic_rate * floor(from[i] / cic_rate + 0.5);
+        const int r = (image > 0 && fabs(from[i] - image) <= 0.4 + 1e-9);
+
+        if (db > worst[r]) {
+            worst[r] = db;
+            worst_f[r] = from[i];
+        }
+    }
+
+    printf("/%-3u %u half-band(s): passband ripple %.3f dB (limit %.1f), worst alias %.1f dB from %.1f fs (limit %.0f), "
+           "from CIC images %.1f dB from %.1f fs (limit %.0f)\n",
+           c->decimation, c->hb_stages, ripple, PASSBAND_RIPPLE_DB, worst[0], worst_f[0], STOPBAND_DB, worst[1], worst_f[1],
+           CIC_IMAGE_DB);
+    TEST_CHECK(ripple < PASSBAND_RIPPLE_DB, "/%u, %u half-bands: passband ripple %.3f dB", c->decimation, c->hb_stages, ripple);
+    TEST_CHECK(worst[0] < STOPBAND_DB, "/%u, %u half-bands: alias at %.1f dB from %.1f fs", c->decimation, c->hb_stages, worst[0],
+               worst_f[0]);
+    TEST_CHECK(worst[1] < CIC_IMAGE_DB, "/%u, %u half-bands: CIC image alias at %.1f dB from %.1f fs", c->decimation,
+               c->hb_stages, worst[1], worst_f[1]);
+
+    pdm_decimator_deinit(&dec);
+}
+
+// the factor applied to the DC blocker's output, as pdm_decimator_set_volume()
+// defines it
+static double volume_factor(const struct pdm_decimator* dec, uint16_t volume) {
+    return (double)dec->gain * volume * 32768 * (1 << dec->cic_shift) / ((dec->max_volume ? dec->max_volume : 1) * (double)dec->cic_offset);
+}
+
+static void check_volume(const struct config* c) {
+    static const uint8_t gains[] = { 1, 16, 255 };
+    static const uint8_t max_volumes[] = { 1, 64, 255 };
+    static const uint16_t volumes[] = { 0, 1, 64, 1000, 30000, 65535 };
+    struct pdm_decimator dec;
+    int shift0 = 0, saturating = 0;
+    long off_grid = 0, on_grid = 0;
+
+    TEST_CHECK(pdm_decimator_init(&dec, 1, c->decimation, c->hb_stages, FS) == 0, "/%u", c->decimation);
+    test_modulate_tone(pdm, (N + SKIP) * c->decimation / 8, AMPLITUDE, 100.5 * c->decimation, 0);
+
+    for (size_t g = 0; g < sizeof(gains); g++) {
+        for (size_t m = 0; m < sizeof(max_volumes); m++) {
+            for (size_t v = 0; v < sizeof(volumes) / sizeof(volumes[0]); v++) {
+                const uint8_t* data[1] = { pdm };
+                int16_t* o[1] = { out };
+                int32_t* o32[1] = { out32 };
+
+                dec.gain = gains[g];
+                dec.max_volume = max_volumes[m];
+                pdm_decimator_set_volume(&dec, volumes[v]);
+
+                const double factor = volume_factor(&dec, volumes[v]);
+                const double represented = (double)dec.vol_mult / (1 << dec.vol_shift);
+
+                TEST_CHECK(dec.vol_shift <= 15 && dec.vol_mult >= 1 && dec.vol_mult <= 65535, "mult %d, shift %u", dec.vol_mult, dec.vol_shift);
+                if (factor >= 65535) {
+                    // every sample of half a 16-bit LSB or more saturates
+                    TEST_CHECK(dec.vol_limit <= (1 << (FRAC_BITS - dec.vol_pre)) / 2 + 1 && dec.vol_mult == 65535,
+                               "factor %.0f: mult %d, limit %d", factor, dec.vol_mult, dec.vol_limit);
+                    saturating++;
+                } else if (factor * (1 << 15) >= 0.5) {
+                    TEST_CHECK(fabs(represented - factor) <= 0.5 / (1 << dec.vol_shift) + 1e-9,
+                               "gain %u, max %u, volume %u: factor %f as %d >> %u", gains[g], max_volumes[m], volumes[v],
+                               factor, dec.vol_mult, dec.vol_shift);
+                }
+                shift0 += (dec.vol_shift == 0);
+
+                pdm_decimator_reset(&dec);
+                pdm_decimator_process(&dec, data, o, N + SKIP, volumes[v]);
+                pdm_decimator_reset(&dec);
+                pdm_decimator_process32(&dec, data, o32, N + SKIP, volumes[v]);
+
+                for (int i = SKIP; i < N + SKIP; i++) {
+                    // the Q31 samples keep fractions of the 16-bit CIC scale, not just
+                    // multiples of the volume factor
+                    if (dec.vol_shift <= 16 - FRAC_BITS && abs(out32[i]) < INT32_MAX) {
+                        const int64_t step = (int64_t)dec.vol_mult << (16 - dec.vol_shift);
+
+                        off_grid += (out32[i] % step != 0);
+                        on_grid += (out32[i] % step == 0);
+                    }
+
+                    // Q31 rounded to 16 bits is the 16-bit output, where neither saturates
+                    if (out[i] > -32700 && out[i] < 32700) {
+                        TEST_CHECK(llabs((((int64_t)out32[i] + 32768) >> 16) - out[i]) <= 1, "gain %u, max %u, volume %u: sample %d is %d, Q31 %d",
+                                   gains[g], max_volumes[m], volumes[v], i, out[i], out32[i]);
+                    } else {
+                        TEST_CHECK(factor >= 65535 || abs(out32[i]) >= (32700 << 16) - 65536,
+                                   "sample %d saturated at 16 bits (%d) only (Q31 %d)", i, out[i], out32[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    TEST_CHECK(shift0 > 0 && saturating > 0, "/%u: %d shift 0 cases, %d saturating", c->decimation, shift0, saturating);
+    TEST_CHECK(off_grid > 4 * on_grid, "/%u: %ld Q31 samples on the 16-bit CIC scale, %ld between", c->decimation, on_grid, off_grid);
+    pdm_decimator_deinit(&dec);
+}
+
+static volatile int32_t sink;
+
+// ticks per output sample of each stage of dec, timed in isolation
+static void stage_costs(const struct config* c) {
+    struct pdm_decimator dec;
+    struct pdm_decimator_stage_cost costs[PDM_DECIMATOR_STAGES_MAX];
+    struct pdm_decimator_channel* state = &dec.channel[0];
+    const int n_cic = 1 << c->hb_stages;
+    const int samples = N + SKIP;
+    double ticks[PDM_DECIMATOR_STAGES_MAX] = { 0 };
+    uint32_t t;
+    int32_t acc = 0;
+
+    TEST_CHECK(pdm_decimator_init(&dec, 1, c->decimation, c->hb_stages, FS) == 0, "/%u", c->decimation);
+    pdm_decimator_set_volume(&dec, 64);
+    test_modulate_tone(pdm, samples * c->decimation / 8, AMPLITUDE, 100.5 * c->decimation, 0);
+    const int n_stages = pdm_decimator_get_stage_costs(&dec, costs, PDM_DECIMATOR_STAGES_MAX);
+    int stage = 0;
+
+    t = pdm_profile_now();
+    for (int i = 0; i < samples; i++) {
+        for (int m = 0; m < n_cic; m++) {
+            acc += pdm_decimator_cic(&dec, state->cic, pdm + (i * n_cic + m) * dec.cic_decimation / 8);
+        }
+    }
+    ticks[stage++] = (double)(uint32_t)(pdm_profile_now() - t) / samples;
+
+    if (c->hb_stages == 2) {
+        t = pdm_profile_now();
+        for (int i = 0; i < samples; i++) {
+            for (int m = 0; m < 2; m++) {
+                pdm_decimator_push(state->hb1, &state->hb1_index, PDM_DECIMATOR_HB1_TAPS, out[i] + m);
+                acc += pdm_decimator_halfband(pdm_decimator_push(state->hb1, &state->hb1_index, PDM_DECIMATOR_HB1_TAPS, out[i] - m),
+                                              hb1_coefs, sizeof(hb1_coefs) / sizeof(hb1_coefs[0]));
+            }
+        }
+        ticks[stage++] = (double)(uint32_t)(pdm_profile_now() - t) / samples;
+    }
+
+    t = pdm_profile_now();
+    for (int i = 0; i < samples; i++) {
+        pdm_decimator_push(state->hb2, &state->hb2_index, PDM_DECIMATOR_HB2_TAPS, out[i]);
+        acc += pdm_decimator_halfband(pdm_decimator_push(state->hb2, &state->hb2_index, PDM_DECIMATOR_HB2_TAPS, -out[i]),
+                                      hb2_coefs, sizeof(hb2_coefs) / sizeof(hb2_coefs[0]));
+    }
+    ticks[stage++] = (double)(uint32_t)(pdm_profile_now() - t) / samples;
+
+    t = pdm_profile_now();
+    for (int i = 0; i < samples; i++) {
+        acc += pdm_decimator_comp(pdm_decimator_push(state->comp, &state->comp_index, PDM_DECIMATOR_COMP_TAPS, out[i]), dec.comp_coefs);
+    }
+    ticks[stage++] = (double)(uint32_t)(pdm_profile_now() - t) / samples;
+
+    t = pdm_profile_now();
+    for (int i = 0; i < samples; i++) {
+        int32_t y = out[i];
+
+        state->dc += (y * 256 - state->dc) >> dec.dc_shift;
+        y -= state->dc >> 8;
+        y = (y < -dec.vol_limit) ? -dec.vol_limit : (y > dec.vol_limit) ? dec.vol_limit : y;
+        acc += (y * dec.vol_mult + ((1 << dec.vol_shift) >> 1)) >> dec.vol_shift;
+    }
+    ticks[stage++] = (double)(uint32_t)(pdm_profile_now() - t) / samples;
+    sink = acc;
+
+    TEST_CHECK(stage == n_stages, "%d stages timed, %d costed", stage, n_stages);
+
+    printf("/%-3u %u half-band(s), ticks per output sample (%u Hz):", c->decimation, c->hb_stages, pdm_profile_tick_hz());
+    for (int s = 0; s < n_stages; s++) {
+        printf(" %s %.1f (%u mults)%s", costs[s].name, ticks[s], costs[s].mults, (s + 1 < n_stages) ? "," : "\n");
+    }
+
+    // whole calls of 16 samples, as a driver filtering 1 ms blocks makes them
+    const uint8_t* data[1] = { pdm };
+    int16_t* o[1] = { out };
+    struct pdm_profile_stats stats;
+
+    pdm_profile_reset();
+    for (int i = 0; i + 16 <= samples; i += 16) {
+        data[0] = pdm + i * c->decimation / 8;
+        o[0] = out + i;
+
+        PDM_PROFILE_BEGIN(start);
+        pdm_decimator_process(&dec, data, o, 16, 64);
+        PDM_PROFILE_END(PDM_PROFILE_FILTER, start);
+    }
+    TEST_CHECK(pdm_profile_get_stats(PDM_PROFILE_FILTER, &stats), "no profile");
+    printf("     pdm_decimator_process() of 16 samples: %u calls, ticks p50 %u, p90 %u, p99 %u, max %u\n",
+           stats.count, stats.p50, stats.p90, stats.p99, stats.max);
+
+    pdm_decimator_deinit(&dec);
+}
+
+// decimations the CIC cannot run at: none, less than a byte per CIC output,
+// not a multiple of a byte, and channel counts it has no layout for
+static void check_rejected() {
+    static const struct { uint8_t channels, decimation, hb_stages; } rejected[] = {
+        { 1, 0, 1 }, { 1, 0, 2 }, { 1, 8, 1 }, { 1, 16, 2 }, { 1, 40, 1 }, { 1, 255, 1 }, { 3, 48, 1 },
+    };
+    struct pdm_decimator dec;
+
+    for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+        TEST_CHECK(pdm_decimator_init(&dec, rejected[i].channels, rejected[i].decimation, rejected[i].hb_stages, FS) == -1,
+                   "%u channels /%u, %u half-bands: accepted", rejected[i].channels, rejected[i].decimation,
+                   rejected[i].hb_stages);
+        TEST_CHECK(dec.cic_lut == NULL, "/%u: LUT allocated", rejected[i].decimation);
+    }
+    printf("rejected decimations: ok\n");
+}
+
+int main() {
+    check_rejected();
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        check_response(&configs[i]);
+    }
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        check_volume(&configs[i]);
+    }
+    printf("volume: ok\n");
+    for (size_t i = 0; i < sizeof(configs) / sizeof(configs[0]); i++) {
+        stage_costs(&configs[i]);
+    }
+
+    return 0;
+}
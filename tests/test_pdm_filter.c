@@ -0,0 +1,311 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// Runs the single-stage sinc filter, Open_PDM_Filter_48/64/128 and the filter
+// bank (planar, bit-interleaved and Q31), over fixed PDM streams and compares
+// their output with golden/pdm_filter_golden.h, then prints the throughput of
+// each kernel. With --golden it prints a new golden header instead (from
+// Open_PDM_Filter_XX, after a change that is meant to alter the output).
+
+#include "OpenPDMFilter.h"
+
+#include "test_common.h"
+
+#define FS 16000
+#define BLOCK (FS / 1000) // samples per Open_PDM_Filter_XX call
+#define GOLDEN_SAMPLES 256
+#define DECIMATIONS 3
+#define STREAMS 3
+#define VOLUME 64
+
+static const uint8_t decimations[DECIMATIONS] = { 48, 64, 128 };
+static const char* const stream_names[STREAMS] = { "tone", "noise", "square" };
+
+static uint8_t pdm[DECIMATIONS][STREAMS][GOLDEN_SAMPLES * DECIMATION_MAX / 8];
+static TPDMFilter_InitStruct filter[STREAMS];
+static TPDMFilterBank_InitStruct bank;
+static uint32_t interleaved[GOLDEN_SAMPLES * DECIMATION_MAX / 8];
+static int16_t out[4][GOLDEN_SAMPLES];
+static int32_t out32[4][GOLDEN_SAMPLES];
+
+#include "golden/pdm_filter_golden.h"
+
+// tone: -6 dBFS at 1/32 of the output rate; noise: a tone with white noise
+// beneath it, like a microphone in a quiet room; square: full-scale PDM (all
+// 1s, then all 0s) every 32 samples, which saturates the output
+static void make_streams() {
+    for (int d = 0; d < DECIMATIONS; d++) {
+        const uint D = decimations[d];
+        const size_t n_bytes = GOLDEN_SAMPLES * D / 8;
+        struct test_modulator m = { 0, 0 };
+        uint32_t seed = 1;
+
+        test_modulate_tone(pdm[d][0], n_bytes, 16384, 32.0 * D, 0);
+
+        for (size_t i = 0; i < n_bytes; i++) {
+            uint8_t byte = 0;
+
+            for (int k = 0; k < 8; k++) {
+                const double t = (double)(i * 8 + k) / (7.0 * D);
+                const int32_t x = lround(4096 * sin(2 * M_PI * t)) + (int32_t)(test_random(&seed) >> 20) - 2048;
+
+                byte = (byte << 1) | test_modulate_bit(&m, x);
+            }
+            pdm[d][1][i] = byte;
+        }
+
+        for (size_t i = 0; i < n_bytes; i++) {
+            pdm[d][2][i] = ((i * 8 / D) % 32 < 16) ? 0xFF : 0x00;
+        }
+    }
+}
+
+static void filter_init(TPDMFilter_InitStruct* filter, uint8_t decimation) {
+    memset(filter, 0, sizeof(*filter));
+    filter->Fs = FS;
+    filter->LP_HZ = FS / 2;
+    filter->HP_HZ = 10;
+    filter->In_MicChannels = 1;
+    filter->Out_MicChannels = 1;
+    filter->Decimation = decimation;
+    filter->MaxVolume = 64;
+    filter->Gain = 16;
+    Open_PDM_Filter_Init(filter);
+}
+
+static void bank_init(TPDMFilterBank_InitStruct* bank, uint8_t decimation, uint8_t channels) {
+    memset(bank, 0, sizeof(*bank));
+    bank->Fs = FS;
+    bank->LP_HZ = FS / 2;
+    bank->HP_HZ = 10;
+    bank->Channels = channels;
+    bank->Decimation = decimation;
+    bank->MaxVolume = 64;
+    bank->Gain = 16;
+    Open_PDM_FilterBank_Init(bank);
+}
+
+static void run_filter(int d, int s, int16_t* o) {
+    const uint D = decimations[d];
+
+    for (int i = 0; i < GOLDEN_SAMPLES; i += BLOCK) {
+        uint8_t* data = pdm[d][s] + i * D / 8;
+
+        if (D == 48) {
+            Open_PDM_Filter_48(data, (uint16_t*)o + i, VOLUME, &filter[s]);
+        } else if (D == 64) {
+            Open_PDM_Filter_64(data, (uint16_t*)o + i, VOLUME, &filter[s]);
+        } else {
+            Open_PDM_Filter_128(data, (uint16_t*)o + i, VOLUME, &filter[s]);
+        }
+    }
+}
+
+// all streams at once, one per channel, in blocks of odd sizes so that the
+// state carries over at every offset
+static void run_bank_planar(int d, bool q31) {
+    const uint D = decimations[d];
+
+    for (int i = 0, n; i < GOLDEN_SAMPLES; i += n) {
+        uint8_t* data[STREAMS];
+        uint16_t* o[STREAMS];
+        int32_t* o32[STREAMS];
+
+        n = (GOLDEN_SAMPLES - i < 7) ? GOLDEN_SAMPLES - i : 7;
+        for (int s = 0; s < STREAMS; s++) {
+            data[s] = pdm[d][s] + i * D / 8;
+            o[s] = (uint16_t*)out[s] + i;
+            o32[s] = out32[s] + i;
+        }
+        if (q31) {
+            Open_PDM_FilterBank_Process32(data, o32, n, VOLUME, &bank);
+        } else {
+            Open_PDM_FilterBank_Process(data, o, n, VOLUME, &bank);
+        }
+    }
+}
+
+static const int interleave_streams[4] = { 0, 1, 2, 0 };
+
+// streams 0, 1 (, 2, 0) bit-interleaved as the PIO captures 1, 2 or 4 mics
+static void interleave(int d, uint8_t channels) {
+    const uint D = decimations[d];
+    uint8_t* in[4];
+
+    for (int ch = 0; ch < channels; ch++) {
+        in[ch] = pdm[d][interleave_streams[ch]];
+    }
+    if (channels == 1) {
+        memcpy(interleaved, in[0], GOLDEN_SAMPLES * D / 8);
+    } else {
+        test_interleave((uint8_t*)interleaved, in, channels, GOLDEN_SAMPLES * D / 8);
+    }
+}
+
+static void run_bank_interleaved(uint8_t channels) {
+    uint16_t* o[4];
+
+    for (int ch = 0; ch < channels; ch++) {
+        o[ch] = (uint16_t*)out[ch];
+    }
+
+    Open_PDM_FilterBank_ProcessInterleaved((uint8_t*)interleaved, o, GOLDEN_SAMPLES, VOLUME, &bank);
+}
+
+static void check(const char* kernel, int d, int s, const int16_t* o) {
+    for (int i = 0; i < GOLDEN_SAMPLES; i++) {
+        TEST_CHECK(o[i] == golden[d][s][i], "%s /%u %s: sample %d is %d, golden %d", kernel, decimations[d],
+                   stream_names[s], i, o[i], golden[d][s][i]);
+    }
+}
+
+// Q31: the same filter before the 16-bit rounding, saturated at the int32_t
+// range instead of +/-32700
+static void check32(int d, int s, const int32_t* o) {
+    for (int i = 0; i < GOLDEN_SAMPLES; i++) {
+        if (golden[d][s][i] > -32700 && golden[d][s][i] < 32700) {
+            const int32_t rounded = (o[i] + 32768) >> 16;
+
+            TEST_CHECK(abs(rounded - golden[d][s][i]) <= 1, "Process32 /%u %s: sample %d is %d (Q31 %d), golden %d",
+                       decimations[d], stream_names[s], i, rounded, o[i], golden[d][s][i]);
+        }
+    }
+}
+
+// output samples per second (all channels) of run() over the streams at
+// decimation d, repeated for at least 50 ms after the filters are set up
+static void throughput(const char* kernel, int d, int samples, void (*run)(int d)) {
+    const uint32_t start = pdm_profile_now();
+    uint32_t end;
+    int runs = 0;
+
+    do {
+        run(d);
+        runs++;
+        end = pdm_profile_now();
+    } while (test_seconds(start, end) < 0.05);
+
+    printf("%-30s /%-3u %8.2f Msamples/s\n", kernel, decimations[d], (double)runs * samples / test_seconds(start, end) / 1e6);
+}
+
+static void run_filter_all(int d) {
+    for (int s = 0; s < STREAMS; s++) {
+        run_filter(d, s, out[s]);
+    }
+}
+
+static void run_bank_planar16(int d) {
+    run_bank_planar(d, false);
+}
+
+static void run_bank_planar32(int d) {
+    run_bank_planar(d, true);
+}
+
+static void run_bank_interleaved1(int d) {
+    (void)d;
+    run_bank_interleaved(1);
+}
+
+static void run_bank_interleaved2(int d) {
+    (void)d;
+    run_bank_interleaved(2);
+}
+
+static void run_bank_interleaved4(int d) {
+    (void)d;
+    run_bank_interleaved(4);
+}
+
+static void print_golden() {
+    printf("// generated by test_pdm_filter --golden: Open_PDM_Filter_48/64/128 over the\n");
+    printf("// tone, noise and square streams, %d samples each\n\n", GOLDEN_SAMPLES);
+    printf("static const int16_t golden[%d][%d][%d] = {\n", DECIMATIONS, STREAMS, GOLDEN_SAMPLES);
+    for (int d = 0; d < DECIMATIONS; d++) {
+        printf("    { // /%u\n", decimations[d]);
+        for (int s = 0; s < STREAMS; s++) {
+            filter_init(&filter[s], decimations[d]);
+            run_filter(d, s, out[0]);
+            printf("        { // %s", stream_names[s]);
+            for (int i = 0; i < GOLDEN_SAMPLES; i++) {
+                printf("%s%d,", (i % 12) ? " " : "\n            ", out[0][i]);
+            }
+            printf("\n        },\n");
+        }
+        printf("    },\n");
+    }
+    printf("};\n");
+}
+
+int main(int argc, char** argv) {
+    make_streams();
+
+    if (argc > 1 && strcmp(argv[1], "--golden") == 0) {
+        print_golden();
+
+        return 0;
+    }
+
+    for (int d = 0; d < DECIMATIONS; d++) {
+        if (!LUT_HAS(decimations[d])) {
+            printf("/%u: not covered by the LUT (LUT_DECIMATION %d)\n", decimations[d], LUT_DECIMATION);
+            continue;
+        }
+
+        for (int s = 0; s < STREAMS; s++) {
+            filter_init(&filter[s], decimations[d]);
+            run_filter(d, s, out[0]);
+            check("Open_PDM_Filter", d, s, out[0]);
+        }
+
+        bank_init(&bank, decimations[d], STREAMS);
+        run_bank_planar(d, false);
+        for (int s = 0; s < STREAMS; s++) {
+            check("Process", d, s, out[s]);
+        }
+
+        bank_init(&bank, decimations[d], STREAMS);
+        run_bank_planar(d, true);
+        for (int s = 0; s < STREAMS; s++) {
+            check32(d, s, out32[s]);
+        }
+
+        for (uint8_t channels = 1; channels <= 4; channels *= 2) {
+            interleave(d, channels);
+            bank_init(&bank, decimations[d], channels);
+            run_bank_interleaved(channels);
+            for (int ch = 0; ch < channels; ch++) {
+                check("ProcessInterleaved", d, interleave_streams[ch], out[ch]);
+            }
+        }
+    }
+    printf("golden: ok\n");
+
+    for (int d = 0; d < DECIMATIONS; d++) {
+        if (!LUT_HAS(decimations[d])) {
+            continue;
+        }
+        for (int s = 0; s < STREAMS; s++) {
+            filter_init(&filter[s], decimations[d]);
+        }
+        throughput("Open_PDM_Filter", d, STREAMS * GOLDEN_SAMPLES, run_filter_all);
+        bank_init(&bank, decimations[d], STREAMS);
+        throughput("FilterBank_Process", d, STREAMS * GOLDEN_SAMPLES, run_bank_planar16);
+        throughput("FilterBank_Process32", d, STREAMS * GOLDEN_SAMPLES, run_bank_planar32);
+        interleave(d, 1);
+        bank_init(&bank, decimations[d], 1);
+        throughput("FilterBank_ProcessInterleaved", d, GOLDEN_SAMPLES, run_bank_interleaved1);
+        interleave(d, 2);
+        bank_init(&bank, decimations[d], 2);
+        throughput("  2 channels", d, 2 * GOLDEN_SAMPLES, run_bank_interleaved2);
+        interleave(d, 4);
+        bank_init(&bank, decimations[d], 4);
+        throughput("  4 channels", d, 4 * GOLDEN_SAMPLES, run_bank_interleaved4);
+    }
+
+    return 0;
+}
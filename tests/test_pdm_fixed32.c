@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// Built with FILTER_BANK_FIXED32: runs random, full-scale and tone PDM through
+// the 32-bit filter bank datapath and through Open_PDM_Filter_48/64/128 (the
+// 64-bit datapath, which the filter bank matches exactly by default) at a
+// range of gains and volumes, and checks that they differ by at most
+// MAX_LSB_DIFF, as OpenPDMFilter.h states.
+
+#include "OpenPDMFilter.h"
+
+#include "test_common.h"
+
+#ifndef FILTER_BANK_FIXED32
+#error "build with FILTER_BANK_FIXED32"
+#endif
+
+#define FS 16000
+#define BLOCK (FS / 1000)
+#define SAMPLES 2048
+#define STREAMS 4
+#define MAX_LSB_DIFF 1
+
+static const char* const stream_names[STREAMS] = { "random", "biased", "full-scale", "tone" };
+
+static uint8_t pdm[STREAMS][SAMPLES * DECIMATION_MAX / 8];
+static int16_t expected[SAMPLES];
+static int16_t out[STREAMS][SAMPLES];
+
+// random: uniform bits; biased: bits at a density that wanders between 0 and
+// 1; full-scale: runs of all 1s and all 0s of random length; tone: -3 dBFS
+static void make_streams(uint D) {
+    const size_t n_bytes = SAMPLES * D / 8;
+    uint32_t seed = D;
+    uint32_t density = 1u << 31;
+
+    for (size_t i = 0; i < n_bytes; i++) {
+        pdm[0][i] = test_random(&seed);
+
+        uint8_t byte = 0;
+
+        density += (test_random(&seed) >> 24) * 0x100000 - 0x8000000;
+        for (int k = 0; k < 8; k++) {
+            byte = (byte << 1) | (test_random(&seed) < density);
+        }
+        pdm[1][i] = byte;
+    }
+
+    for (size_t i = 0; i < n_bytes;) {
+        const size_t run = 1 + test_random(&seed) % (8 * D);
+        const uint8_t byte = (test_random(&seed) & 1) ? 0xFF : 0x00;
+
+        for (size_t j = 0; j < run && i < n_bytes; j++) {
+            pdm[2][i++] = byte;
+        }
+    }
+
+    test_modulate_tone(pdm[3], n_bytes, 23000, 50.0 * D, 0);
+}
+
+int main() {
+    static const uint8_t decimations[] = { 48, 64, 128 };
+    static const uint8_t gains[] = { 1, 16, 64 };
+    static const uint16_t volumes[] = { 1, 7, 64, 255, 1000, 65535 };
+    static TPDMFilter_InitStruct filter;
+    static TPDMFilterBank_InitStruct bank;
+    int worst = 0;
+
+    for (int d = 0; d < 3; d++) {
+        const uint8_t D = decimations[d];
+
+        make_streams(D);
+
+        for (int g = 0; g < 3; g++) {
+            for (int v = 0; v < 6; v++) {
+                uint8_t* in[STREAMS];
+                uint16_t* o[STREAMS];
+
+                memset(&bank, 0, sizeof(bank));
+                bank.Fs = FS;
+                bank.LP_HZ = FS / 2;
+                bank.HP_HZ = 10;
+                bank.Channels = STREAMS;
+                bank.Decimation = D;
+                bank.MaxVolume = 64;
+                bank.Gain = gains[g];
+                Open_PDM_FilterBank_Init(&bank);
+                for (int s = 0; s < STREAMS; s++) {
+                    in[s] = pdm[s];
+                    o[s] = (uint16_t*)out[s];
+                }
+                Open_PDM_FilterBank_Process(in, o, SAMPLES, volumes[v], &bank);
+
+                for (int s = 0; s < STREAMS; s++) {
+                    memset(&filter, 0, sizeof(filter));
+                    filter.Fs = FS;
+                    filter.LP_HZ = FS / 2;
+                    filter.HP_HZ = 10;
+                    filter.In_MicChannels = 1;
+                    filter.Out_MicChannels = 1;
+                    filter.Decimation = D;
+                    filter.MaxVolume = 64;
+                    filter.Gain = gains[g];
+                    Open_PDM_Filter_Init(&filter);
+
+                    for (int i = 0; i < SAMPLES; i += BLOCK) {
+                        uint8_t* data = pdm[s] + i * D / 8;
+                        uint16_t* e = (uint16_t*)expected + i;
+
+                        if (D == 48) {
+                            Open_PDM_Filter_48(data, e, volumes[v], &filter);
+                        } else if (D == 64) {
+                            Open_PDM_Filter_64(data, e, volumes[v], &filter);
+                        } else {
+                            Open_PDM_Filter_128(data, e, volumes[v], &filter);
+                        }
+                    }
+
+                    for (int i = 0; i < SAMPLES; i++) {
+                        const int diff = abs(out[s][i] - expected[i]);
+
+                        TEST_CHECK(diff <= MAX_LSB_DIFF, "/%u %s, gain %u, volume %u: sample %d is %d, 64-bit datapath %d",
+                                   D, stream_names[s], gains[g], volumes[v], i, out[s][i], expected[i]);
+                        worst = (diff > worst) ? diff : worst;
+                    }
+                }
+            }
+        }
+    }
+    printf("FILTER_BANK_FIXED32: at most %d LSB from the 64-bit datapath (limit %d)\n", worst, MAX_LSB_DIFF);
+
+    return 0;
+}
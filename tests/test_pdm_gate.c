@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The activity gate on the emulated PIO and DMA (see stubs/pico_emu.h), with
+// the filter bank and the multi-stage decimator: of two mics, the first is
+// idle (long enough for the filters to settle before the gate closes it) until
+// a tone burst starts at a raw buffer boundary, faded in over the end of the
+// raw buffer before; the second plays a tone throughout. The gate must close
+// the idle channel (reading 0s), reopen it on the burst's first raw buffer
+// and, having primed its filter over the end of the previous raw buffer,
+// continue as a run without the gate would: the reopened channel matches the
+// ungated one within a few LSBs, and the other channel matches it exactly.
+// When the reader is so far behind that the DMA is already reusing the
+// previous raw buffer, the gate must not prime from it: the reopened channel
+// then starts far from the ungated output, and only comes close to it once
+// the filter's history is refilled.
+
+#include "pico/pdm_microphone.h"
+
+#include "pico_emu.h"
+#include "test_common.h"
+
+#define FS 16000
+#define DECIMATION 64
+#define BLOCK 32 // samples per raw buffer
+#define COUNT 8 // raw buffers
+#define BURST 20 // raw buffer the first mic's tone burst starts at
+#define READS 28 // raw buffers read
+#define SAMPLES (READS * BLOCK)
+#define PDM_BYTES ((READS + COUNT) * BLOCK * DECIMATION / 8)
+#define GPIO_DATA 2
+#define GPIO_CLK 10
+#define AMPLITUDE 16384.0
+#define PERIOD 20 // output samples per tone cycle
+#define FADE 16 // output samples of the burst, at 1/8 of its amplitude, before its raw buffer
+
+#define OPEN_LEVEL 256 // an idle mic reads 0, the tone about 2000
+#define HOLD 16 // quiet raw buffers before the gate closes, for the filters to settle on the idle mic first
+#define PRIME 24 // output samples, PDM_MICROPHONE_GATE_PRIME
+#define SETTLE (2 * BLOCK) // output samples from the burst after which even an unprimed filter has caught up
+#define MATCH_LSB 4 // reopened channel against the ungated run, past the priming window
+#define SETTLED_LSB 64 // unprimed channel against it, SETTLE samples on (the IIR stages take longer to forget)
+
+static uint8_t pdm[2][PDM_BYTES];
+static int16_t ungated[2][SAMPLES];
+static int16_t gated[2][SAMPLES];
+static int16_t out[2 * BLOCK];
+
+// the burst fades in over the end of the raw buffer before it, too quietly to
+// open the gate, so that a filter primed over it differs from one resuming
+// from the idle mic
+static void make_streams() {
+    const size_t burst_byte = BURST * BLOCK * DECIMATION / 8;
+    const size_t fade_byte = burst_byte - FADE * DECIMATION / 8;
+
+    test_modulate_tone(pdm[0], fade_byte, 0, 1, 0);
+    test_modulate_tone(pdm[0] + fade_byte, burst_byte - fade_byte, AMPLITUDE / 8, PERIOD * DECIMATION, 0);
+    test_modulate_tone(pdm[0] + burst_byte, PDM_BYTES - burst_byte, AMPLITUDE, PERIOD * DECIMATION, 0);
+    test_modulate_tone(pdm[1], PDM_BYTES, AMPLITUDE, (PERIOD + 7) * DECIMATION, 0);
+}
+
+// READS raw buffers into samples; if lag, the reader lets the DMA get the most
+// a reader can be behind it (raw_buffer_count - 2) before reading the burst
+static uint32_t capture(uint filter_stages, uint gate_open_level, bool lag, int16_t samples[2][SAMPLES]) {
+    const struct pdm_microphone_config config = {
+        .gpio_data = GPIO_DATA,
+        .gpio_clk = GPIO_CLK,
+        .pio = pio0,
+        .pio_sm = 0,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .filter_stages = filter_stages,
+        .channels = 2,
+        .decimation = DECIMATION,
+        .raw_buffer_count = COUNT,
+        .read_mode = PDM_MICROPHONE_READ_BLOCKING,
+        .gate_open_level = gate_open_level,
+        .gate_hold = HOLD,
+    };
+    pdm_microphone_t* mic = pdm_microphone_create(&config);
+    struct pdm_microphone_health health;
+
+    TEST_CHECK(mic, "%u filter stages: create failed", filter_stages);
+    pdm_microphone_instance_set_filter_gain(mic, 1); // half scale tones, unclipped
+    pico_emu_disconnect_mics();
+    pico_emu_connect_mic(GPIO_DATA, GPIO_CLK, pdm[0], PDM_BYTES);
+    pico_emu_connect_mic(GPIO_DATA + 1, GPIO_CLK, pdm[1], PDM_BYTES);
+    TEST_CHECK(pdm_microphone_instance_start(mic) == 0, "%u filter stages: start failed", filter_stages);
+
+    for (uint i = 0; i < READS; i++) {
+        if (lag && i == BURST) {
+            struct pdm_microphone_ring_stats ring;
+
+            do {
+                pico_emu_run(PICO_EMU_SYS_HZ / 100000);
+                pdm_microphone_instance_get_ring_stats(mic, &ring);
+            } while (ring.blocks_written < BURST + COUNT - 2);
+            TEST_CHECK(ring.blocks_written == BURST + COUNT - 2, "lagging reader: %u raw buffers written",
+                       ring.blocks_written);
+        }
+
+        TEST_CHECK(pdm_microphone_instance_read(mic, out, BLOCK) == BLOCK, "%u filter stages: short read", filter_stages);
+        for (uint j = 0; j < 2; j++) {
+            memcpy(&samples[j][i * BLOCK], &out[j * BLOCK], BLOCK * sizeof(out[0]));
+        }
+    }
+
+    pdm_microphone_instance_get_health(mic, &health);
+    TEST_CHECK(health.ring.overruns == 0, "%u filter stages: %u overruns", filter_stages, health.ring.overruns);
+    pdm_microphone_destroy(mic);
+
+    return health.gated;
+}
+
+// largest difference of channel j from the ungated run over [from, to)
+static int max_error(uint j, uint from, uint to) {
+    int worst = 0;
+
+    for (uint i = from; i < to; i++) {
+        const int error = abs(gated[j][i] - ungated[j][i]);
+
+        worst = (error > worst) ? error : worst;
+    }
+
+    return worst;
+}
+
+static void run(uint filter_stages) {
+    const uint burst = BURST * BLOCK;
+
+    capture(filter_stages, 0, false, ungated);
+
+    // the reader keeps up: the reopened channel's filter is primed
+    const uint32_t n_gated = capture(filter_stages, OPEN_LEVEL, false, gated);
+    bool closed = true;
+
+    for (uint i = HOLD * BLOCK; i < burst; i++) {
+        closed &= (gated[0][i] == 0);
+    }
+    const int primed_start = max_error(0, burst, burst + PRIME);
+    const int primed = max_error(0, burst + PRIME, SAMPLES);
+    const int other = max_error(1, 0, SAMPLES);
+
+    printf("%u filter stages: %u raw buffers gated, reopened channel %d LSB off the ungated run (%d in the first %u "
+           "samples), the other %d\n", filter_stages, n_gated, primed, primed_start, PRIME, other);
+    TEST_CHECK(closed && n_gated >= BURST - HOLD, "%u filter stages: idle channel not gated (%u raw buffers)",
+               filter_stages, n_gated);
+    TEST_CHECK(n_gated <= BURST - HOLD + 1, "%u filter stages: %u raw buffers gated, past the burst", filter_stages, n_gated);
+    TEST_CHECK(primed <= MATCH_LSB, "%u filter stages: reopened channel %d LSB off", filter_stages, primed);
+    TEST_CHECK(other == 0, "%u filter stages: open channel %d LSB off", filter_stages, other);
+
+    // the reader as far behind as it gets: no priming from a reused raw buffer
+    capture(filter_stages, OPEN_LEVEL, true, gated);
+    const int unprimed_start = max_error(0, burst, burst + PRIME);
+    const int unprimed = max_error(0, burst + SETTLE, SAMPLES);
+
+    printf("%u filter stages, reader lagging: reopened channel %d LSB off in the first %u samples, %d after %u\n",
+           filter_stages, unprimed_start, PRIME, unprimed, SETTLE);
+    TEST_CHECK(unprimed_start > primed_start, "%u filter stages: primed from a reused raw buffer", filter_stages);
+    TEST_CHECK(unprimed <= SETTLED_LSB, "%u filter stages: unprimed channel %d LSB off after settling", filter_stages,
+               unprimed);
+    TEST_CHECK(max_error(1, 0, SAMPLES) == 0, "%u filter stages, reader lagging: open channel off", filter_stages);
+}
+
+int main() {
+    make_streams();
+
+    run(0);
+    run(2);
+
+    return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The capture health counters (pdm_microphone_instance_get_health()) on the
+// emulated PIO and DMA (see stubs/pico_emu.h):
+//  - late IRQs: with both DMA IRQ lines masked for two and a half raw buffers
+//    after one was serviced, both halves of the ping-pong are pending when the
+//    handler runs; it must count one late IRQ each time, take both raw buffers
+//    and none while the IRQs are on time
+//  - saturated: of two mics, a half scale tone clipped by the default filter
+//    gain and a quiet one, read as 16-bit and as Q31 samples; the count must
+//    equal the samples at the limits in the output of both, the quiet one's
+//    only in the filters' start-up transient
+//  - distance: reads started 0 to raw_buffer_count - 2 raw buffers behind the
+//    DMA land one in each of their buckets, and a read after an overrun in the
+//    last one
+
+#include "pico/pdm_microphone.h"
+
+#include "pico_emu.h"
+#include "test_common.h"
+
+#define FS 16000
+#define DECIMATION 64
+#define BLOCK 32 // samples per raw buffer
+#define COUNT 8 // raw buffers
+#define RAW_CYCLES (PICO_EMU_SYS_HZ / FS * BLOCK) // clk_sys cycles per raw buffer
+#define STEP_CYCLES 1000
+#define READS 24 // raw buffers read for the clipping counts
+#define PDM_BYTES (4 * READS * BLOCK * DECIMATION / 8)
+#define GPIO_DATA 2
+#define GPIO_CLK 10
+#define LOUD 16384.0 // clipped by the default filter gain
+#define QUIET 1024.0 // half scale through the default filter gain, clipped only as the filters start up
+#define PERIOD 20 // output samples per tone cycle
+#define LATE 3 // times the IRQs are held off
+
+static uint8_t pdm[2][PDM_BYTES];
+static int16_t out[2 * BLOCK];
+static int32_t out32[2 * BLOCK];
+
+static pdm_microphone_t* start(uint channels) {
+    const struct pdm_microphone_config config = {
+        .gpio_data = GPIO_DATA,
+        .gpio_clk = GPIO_CLK,
+        .pio = pio0,
+        .pio_sm = 0,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .channels = channels,
+        .decimation = DECIMATION,
+        .raw_buffer_count = COUNT,
+        .read_mode = PDM_MICROPHONE_READ_BLOCKING,
+    };
+    pdm_microphone_t* mic = pdm_microphone_create(&config);
+
+    TEST_CHECK(mic, "%u channels: create failed", channels);
+    pico_emu_disconnect_mics();
+    for (uint j = 0; j < channels; j++) {
+        pico_emu_connect_mic(GPIO_DATA + j, GPIO_CLK, pdm[j], PDM_BYTES);
+    }
+    TEST_CHECK(pdm_microphone_instance_start(mic) == 0, "%u channels: start failed", channels);
+
+    return mic;
+}
+
+static uint32_t blocks_written(pdm_microphone_t* mic) {
+    struct pdm_microphone_ring_stats ring;
+
+    pdm_microphone_instance_get_ring_stats(mic, &ring);
+
+    return ring.blocks_written;
+}
+
+static void check_late_irqs() {
+    pdm_microphone_t* mic = start(1);
+    struct pdm_microphone_health health;
+
+    while (blocks_written(mic) < 2) {
+        pico_emu_run(STEP_CYCLES);
+    }
+
+    for (uint i = 0; i < LATE; i++) {
+        // just after a raw buffer was taken, hold the IRQs off past the next two
+        const uint32_t irqs = pico_emu_get_stats()->irqs;
+
+        while (pico_emu_get_stats()->irqs == irqs) {
+            pico_emu_run(1);
+        }
+        const uint32_t written = blocks_written(mic);
+
+        irq_set_enabled(DMA_IRQ_0, false);
+        irq_set_enabled(DMA_IRQ_1, false);
+        pico_emu_run(RAW_CYCLES * 5 / 2);
+        TEST_CHECK(blocks_written(mic) == written, "late IRQs: raw buffers taken with the IRQs masked");
+        irq_set_enabled(DMA_IRQ_0, true);
+        irq_set_enabled(DMA_IRQ_1, true);
+        pico_emu_run(1);
+
+        pdm_microphone_instance_get_health(mic, &health);
+        TEST_CHECK(health.late_irqs == i + 1, "late IRQs: %u counted after holding the IRQs off %u times", health.late_irqs,
+                   i + 1);
+        TEST_CHECK(health.ring.blocks_written == written + 2, "late IRQs: %u raw buffers taken at once",
+                   health.ring.blocks_written - written);
+
+        // serviced on time again
+        pico_emu_run(RAW_CYCLES * 4);
+        pdm_microphone_instance_get_health(mic, &health);
+        TEST_CHECK(health.late_irqs == i + 1, "late IRQs: %u counted with the IRQs on time", health.late_irqs);
+    }
+
+    printf("late IRQs: %u counted after holding the IRQs off %u times, %u raw buffers written\n", health.late_irqs, LATE,
+           health.ring.blocks_written);
+    pdm_microphone_destroy(mic);
+}
+
+static void check_saturated(bool wide) {
+    const char* format = wide ? "Q31" : "16-bit";
+    pdm_microphone_t* mic = start(2);
+    struct pdm_microphone_health health;
+    uint32_t clipped[2] = { 0 };
+    uint32_t quiet_settled = 0; // the quiet channel's past the first raw buffer
+
+    for (uint i = 0; i < READS; i++) {
+        const int n = wide ? pdm_microphone_instance_read32(mic, out32, BLOCK) : pdm_microphone_instance_read(mic, out, BLOCK);
+
+        TEST_CHECK(n == BLOCK, "%s: short read", format);
+        for (uint j = 0; j < 2; j++) {
+            for (uint k = 0; k < BLOCK; k++) {
+                const uint x = j * BLOCK + k;
+
+                const bool at_limit = wide ? (out32[x] == INT32_MAX || out32[x] <= -INT32_MAX) : (out[x] >= 32700 || out[x] <= -32700);
+
+                clipped[j] += at_limit;
+                quiet_settled += (at_limit && j == 1 && i > 0);
+            }
+        }
+    }
+
+    pdm_microphone_instance_get_health(mic, &health);
+    printf("saturated, %s: %u counted, %u and %u samples at the limits\n", format, health.saturated, clipped[0], clipped[1]);
+    TEST_CHECK(clipped[0] > READS && quiet_settled == 0, "%s: %u and %u samples clipped, %u of the quiet channel's settled",
+               format, clipped[0], clipped[1], quiet_settled);
+    TEST_CHECK(health.saturated == clipped[0] + clipped[1], "%s: %u saturated counted, %u clipped", format, health.saturated,
+               clipped[0] + clipped[1]);
+    TEST_CHECK(health.ring.overruns == 0, "%s: %u overruns", format, health.ring.overruns);
+    pdm_microphone_destroy(mic);
+}
+
+// a block read once the DMA is target raw buffers ahead of the reader
+static void read_behind(pdm_microphone_t* mic, uint32_t target) {
+    struct pdm_microphone_ring_stats ring;
+
+    for (pdm_microphone_instance_get_ring_stats(mic, &ring); ring.blocks_written - ring.blocks_read < target;
+         pdm_microphone_instance_get_ring_stats(mic, &ring)) {
+        pico_emu_run(STEP_CYCLES);
+    }
+    TEST_CHECK(ring.blocks_written - ring.blocks_read == target, "distance: %u raw buffers behind, not %u",
+               ring.blocks_written - ring.blocks_read, target);
+    TEST_CHECK(pdm_microphone_instance_read(mic, out, BLOCK) == BLOCK, "distance: short read");
+}
+
+static void check_distance() {
+    pdm_microphone_t* mic = start(1);
+    struct pdm_microphone_health health;
+    uint32_t expected[PDM_MICROPHONE_DISTANCE_BUCKETS] = { 0 };
+
+    // 0 (waiting for the DMA) to COUNT - 2 raw buffers behind it, then overrun
+    for (uint32_t fill = 0; fill <= COUNT - 2; fill++) {
+        read_behind(mic, fill);
+        expected[fill * PDM_MICROPHONE_DISTANCE_BUCKETS / COUNT]++;
+    }
+    read_behind(mic, COUNT + 1);
+    expected[PDM_MICROPHONE_DISTANCE_BUCKETS - 1]++;
+
+    pdm_microphone_instance_get_health(mic, &health);
+    printf("distance:");
+    for (uint b = 0; b < PDM_MICROPHONE_DISTANCE_BUCKETS; b++) {
+        printf(" %u", health.distance[b]);
+        TEST_CHECK(health.distance[b] == expected[b], "distance: %u reads in bucket %u, not %u", health.distance[b], b,
+                   expected[b]);
+    }
+    printf(", %u overruns\n", health.ring.overruns);
+    TEST_CHECK(health.ring.overruns == 1, "distance: %u overruns", health.ring.overruns);
+    pdm_microphone_destroy(mic);
+}
+
+int main() {
+    test_modulate_tone(pdm[0], PDM_BYTES, LOUD, PERIOD * DECIMATION, 0);
+    test_modulate_tone(pdm[1], PDM_BYTES, QUIET, (PERIOD + 7) * DECIMATION, 0);
+
+    check_late_irqs();
+    check_saturated(false);
+    check_saturated(true);
+    check_distance();
+
+    return 0;
+}
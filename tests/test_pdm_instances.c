@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The instance bookkeeping of pdm_microphone.c on the emulated PIO and DMA
+// (see stubs/pico_emu.h): groups on both PIO blocks share the capture programs
+// loaded there, claims of taken state machines, a LUT at another decimation or
+// more DMA channels than are left fail without leaking anything, the shared
+// DMA IRQ handlers are added with the first running group and removed with the
+// last, each group's samples ready handler runs for its own raw buffers, and
+// destroying everything (or re-initialising the single-group API) gives back
+// every state machine, DMA channel and instruction slot. Last, a group behind
+// the audio source calls reports the driver's counters and latency, and its
+// deinit gives everything back too.
+
+#include "hardware/irq.h"
+#include "pico/audio_source.h"
+#include "pico/pdm_microphone.h"
+
+#include "pico_emu.h"
+#include "test_common.h"
+
+#define FS 16000
+#define BLOCK 16 // samples per raw buffer
+#define GROUPS 6 // as many as the DMA channel pairs allow
+#define PROGRAM_LENGTH 4
+
+static pdm_microphone_t* mic[GROUPS];
+static uint ready[GROUPS];
+
+static void on_ready(pdm_microphone_t* m, void* context) {
+    const uint i = (uint)(uintptr_t)context;
+
+    TEST_CHECK(m == mic[i], "group %u called with another group", i);
+    ready[i]++;
+}
+
+// claims that a failed create must leave as they were
+struct claims {
+    uint32_t sm[NUM_PIOS];
+    uint32_t instructions[NUM_PIOS];
+    uint32_t dma;
+};
+
+static struct claims claims() {
+    struct claims c = { .dma = pico_emu_dma_claimed() };
+
+    for (uint p = 0; p < NUM_PIOS; p++) {
+        const PIO pio = p ? pio1 : pio0;
+
+        c.sm[p] = 0;
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++) {
+            c.sm[p] |= pio_sm_is_claimed(pio, sm) << sm;
+        }
+        c.instructions[p] = pico_emu_instructions_used(pio);
+    }
+
+    return c;
+}
+
+static void check_fails(const struct pdm_microphone_config* config, const char* why) {
+    const struct claims before = claims();
+
+    TEST_CHECK(pdm_microphone_create(config) == NULL, "%s: created", why);
+
+    const struct claims after = claims();
+    TEST_CHECK(!memcmp(&before, &after, sizeof(before)), "%s: claims changed (SMs %x %x -> %x %x, DMA %03x -> %03x)", why,
+               before.sm[0], before.sm[1], after.sm[0], after.sm[1], before.dma, after.dma);
+}
+
+static uint popcount(uint32_t x) {
+    return __builtin_popcount(x);
+}
+
+static void check_released(const char* when) {
+    const struct claims c = claims();
+
+    TEST_CHECK(!c.sm[0] && !c.sm[1], "%s: SMs %x %x still claimed", when, c.sm[0], c.sm[1]);
+    TEST_CHECK(!c.dma, "%s: DMA channels %03x still claimed", when, c.dma);
+    TEST_CHECK(!c.instructions[0] && !c.instructions[1], "%s: instructions %08x %08x still loaded", when, c.instructions[0],
+               c.instructions[1]);
+    TEST_CHECK(!pico_emu_irq_handlers(DMA_IRQ_0) && !pico_emu_irq_handlers(DMA_IRQ_1), "%s: IRQ handlers left", when);
+}
+
+int main() {
+    struct pdm_microphone_config config = {
+        .gpio_data = 2,
+        .gpio_clk = 20,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .channels = 4,
+        .decimation = 48,
+        .raw_buffer_count = 8,
+        .read_mode = PDM_MICROPHONE_READ_NONBLOCKING,
+    };
+
+    // two 4-mic groups on each PIO block share one copy of the n4 program there
+    for (uint i = 0; i < 4; i++) {
+        config.pio = (i < 2) ? pio0 : pio1;
+        config.pio_sm = i % 2;
+        config.gpio_data = 2 + 4 * i;
+        mic[i] = pdm_microphone_create(&config);
+        TEST_CHECK(mic[i], "group %u: create failed", i);
+    }
+    struct claims c = claims();
+    TEST_CHECK(c.sm[0] == 0x3 && c.sm[1] == 0x3, "SMs %x %x", c.sm[0], c.sm[1]);
+    TEST_CHECK(popcount(c.instructions[0]) == PROGRAM_LENGTH && popcount(c.instructions[1]) == PROGRAM_LENGTH,
+               "instructions %08x %08x", c.instructions[0], c.instructions[1]);
+    TEST_CHECK(popcount(c.dma) == 8, "DMA channels %03x", c.dma);
+
+    // a state machine in use, and the single-stage LUT at another decimation
+    config.pio = pio0;
+    config.pio_sm = 1;
+    check_fails(&config, "taken state machine");
+    config.pio_sm = 2;
+    config.decimation = 64;
+    check_fails(&config, "LUT at another decimation");
+
+    // the multi-stage decimator has its own tables
+    config.filter_stages = 1;
+    mic[4] = pdm_microphone_create(&config);
+    TEST_CHECK(mic[4], "decimator group: create failed");
+
+    // one planar mic loads the n1 program next to the n4 one
+    config.pio_sm = 3;
+    config.filter_stages = 0;
+    config.decimation = 48;
+    config.planar = true;
+    config.channels = 1;
+    config.gpio_data = 26;
+    mic[5] = pdm_microphone_create(&config);
+    TEST_CHECK(mic[5], "planar group: create failed");
+    c = claims();
+    TEST_CHECK(popcount(c.instructions[0]) == 2 * PROGRAM_LENGTH, "instructions %08x", c.instructions[0]);
+    TEST_CHECK(c.dma == 0xFFF, "DMA channels %03x", c.dma);
+
+    // out of DMA channels, with state machines to spare
+    config.pio = pio1;
+    config.pio_sm = 2;
+    config.planar = false;
+    config.channels = 4;
+    check_fails(&config, "no DMA channels left");
+
+    // the shared handlers come with the first running group and go with the last
+    for (uint i = 0; i < GROUPS; i++) {
+        pdm_microphone_instance_set_samples_ready_handler(mic[i], on_ready, (void*)(uintptr_t)i);
+        TEST_CHECK(pdm_microphone_instance_start(mic[i]) == 0, "group %u: start failed", i);
+        TEST_CHECK(pico_emu_irq_handlers(DMA_IRQ_0) == 1 && pico_emu_irq_handlers(DMA_IRQ_1) == 1, "group %u: %u + %u handlers",
+                   i, pico_emu_irq_handlers(DMA_IRQ_0), pico_emu_irq_handlers(DMA_IRQ_1));
+    }
+
+    // 5 ms: 5 raw buffers for every group, each reported to its own handler
+    pico_emu_run(PICO_EMU_SYS_HZ / 200);
+    for (uint i = 0; i < GROUPS; i++) {
+        struct pdm_microphone_ring_stats ring;
+
+        pdm_microphone_instance_get_ring_stats(mic[i], &ring);
+        printf("group %u: %u raw buffers, %u samples ready calls\n", i, ring.blocks_written, ready[i]);
+        TEST_CHECK(ring.blocks_written >= 4 && ready[i] == ring.blocks_written, "group %u: %u raw buffers, %u calls", i,
+                   ring.blocks_written, ready[i]);
+    }
+
+    for (uint i = 0; i < GROUPS; i++) {
+        pdm_microphone_instance_stop(mic[i]);
+        TEST_CHECK(pico_emu_irq_handlers(DMA_IRQ_0) == (i < GROUPS - 1), "group %u stopped: %u handlers", i,
+                   pico_emu_irq_handlers(DMA_IRQ_0));
+    }
+
+    // stopped groups are not serviced any more
+    memset(ready, 0, sizeof(ready));
+    pico_emu_run(PICO_EMU_SYS_HZ / 500);
+    for (uint i = 0; i < GROUPS; i++) {
+        TEST_CHECK(ready[i] == 0, "group %u: %u calls after stop", i, ready[i]);
+    }
+
+    // restarted, then destroyed while running
+    TEST_CHECK(pdm_microphone_instance_start(mic[0]) == 0, "restart failed");
+    TEST_CHECK(pico_emu_irq_handlers(DMA_IRQ_0) == 1, "%u handlers after restart", pico_emu_irq_handlers(DMA_IRQ_0));
+    for (uint i = 0; i < GROUPS; i++) {
+        pdm_microphone_destroy(mic[i]);
+    }
+    check_released("destroyed");
+
+    // the single-group API re-initialises in place
+    struct pdm_microphone_config single = {
+        .gpio_data = 2,
+        .gpio_clk = 3,
+        .pio = pio0,
+        .pio_sm = 0,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+    };
+    TEST_CHECK(pdm_microphone_init(&single) == 0, "init failed");
+    TEST_CHECK(pdm_microphone_init(&single) == 0, "second init failed");
+    c = claims();
+    TEST_CHECK(c.sm[0] == 0x1 && popcount(c.instructions[0]) == PROGRAM_LENGTH && popcount(c.dma) == 2,
+               "after two inits: SMs %x, instructions %08x, DMA %03x", c.sm[0], c.instructions[0], c.dma);
+    TEST_CHECK(pdm_microphone_start() == 0, "start failed");
+    pico_emu_run(PICO_EMU_SYS_HZ / 1000);
+    pdm_microphone_stop();
+    pdm_microphone_deinit();
+    check_released("deinit");
+
+    // an audio source left to overrun its 8 raw buffers before the first read
+    struct audio_source source;
+    struct audio_source_stats stats;
+    struct pdm_microphone_health health;
+    int16_t samples[4 * BLOCK];
+
+    config.pio = pio1;
+    config.pio_sm = 0;
+    config.channels = 4;
+    config.planar = false;
+    config.gpio_data = 2;
+    config.read_mode = PDM_MICROPHONE_READ_BLOCKING;
+    TEST_CHECK(pdm_microphone_source_init(&source, &config) == 0, "source: init failed");
+    TEST_CHECK(source.channels == 4 && source.sample_rate == FS && source.sample_buffer_size == BLOCK, "source: fields");
+    TEST_CHECK(audio_source_start(&source) == 0, "source: start failed");
+    pico_emu_run(PICO_EMU_SYS_HZ / 100);
+    for (uint i = 0; i < 4; i++) {
+        TEST_CHECK(audio_source_read(&source, samples, BLOCK) == BLOCK, "source: read %u came up short", i);
+    }
+
+    audio_source_get_stats(&source, &stats);
+    pdm_microphone_instance_get_health(source.context, &health);
+    const uint32_t latency_us = audio_source_latency_us(&source);
+    const uint32_t expected_us = (pdm_microphone_instance_blocks_available(source.context) + 1) * BLOCK * 1000000ull / FS;
+
+    printf("source: %u raw buffers, %u read, %u overruns, %u dropped, latency %u us\n", stats.blocks_written,
+           stats.blocks_read, stats.overruns, stats.blocks_dropped, latency_us);
+    TEST_CHECK(stats.blocks_written == health.ring.blocks_written && stats.blocks_read == health.ring.blocks_read,
+               "source: %u / %u blocks, driver %u / %u", stats.blocks_written, stats.blocks_read, health.ring.blocks_written,
+               health.ring.blocks_read);
+    TEST_CHECK(stats.overruns == health.ring.overruns + health.pcm_ring.overruns && stats.overruns > 0,
+               "source: %u overruns", stats.overruns);
+    TEST_CHECK(stats.blocks_dropped == health.ring.blocks_dropped + health.pcm_ring.blocks_dropped && stats.blocks_dropped > 0,
+               "source: %u dropped", stats.blocks_dropped);
+    TEST_CHECK(stats.underruns == health.ring.underruns + health.pcm_ring.underruns &&
+               stats.blocks_repeated == health.ring.blocks_repeated + health.pcm_ring.blocks_repeated &&
+               stats.saturated == health.saturated, "source: underruns, repeats or clipping differ from the driver's");
+    TEST_CHECK(latency_us == expected_us, "source: latency %u us, not %u", latency_us, expected_us);
+
+    audio_source_stop(&source);
+    audio_source_deinit(&source);
+    TEST_CHECK(source.context == NULL, "source: context left after deinit");
+    check_released("source deinit");
+
+    printf("ok\n");
+
+    return 0;
+}
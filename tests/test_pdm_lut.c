@@ -0,0 +1,54 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// Open_PDM_FilterBank_CheckLUT() on every decimation the LUT serves: the LUT
+// built by Open_PDM_FilterBank_Init() at run time or, with LUT_PRECOMPUTED,
+// the one pdm_lut_gen.py generated at configure time, must match the sinc^3
+// kernel. The driver no longer runs this check when it starts (only with
+// PDM_CHECK_LUT), so this is where a generator or LUT change gets caught.
+
+#include "OpenPDMFilter.h"
+
+#include "test_common.h"
+
+int main() {
+    static const uint8_t decimations[] = { 48, 64, 128 };
+    static TPDMFilterBank_InitStruct bank;
+    int checked = 0;
+
+    for (int d = 0; d < 3; d++) {
+        const uint8_t D = decimations[d];
+
+        if (!LUT_HAS(D) || D % LUT_BITS || (LUT_BITS == 12 && D % 24)) {
+            continue;
+        }
+
+        memset(&bank, 0, sizeof(bank));
+        bank.Fs = 16000;
+        bank.LP_HZ = 8000;
+        bank.HP_HZ = 10;
+        bank.Channels = 1;
+        bank.Decimation = D;
+        bank.MaxVolume = 64;
+        bank.Gain = 16;
+        Open_PDM_FilterBank_Init(&bank);
+
+        const uint32_t errors = Open_PDM_FilterBank_CheckLUT(D);
+
+        TEST_CHECK(errors == 0, "/%u, %d-bit LUT: %u entries differ from the kernel", D, LUT_BITS, errors);
+        checked++;
+    }
+
+#ifdef LUT_PRECOMPUTED
+    printf("precomputed %d-bit LUT for /%d: ok\n", LUT_BITS, LUT_DECIMATION);
+#else
+    printf("run time %d-bit LUT up to /%d: %d decimations ok\n", LUT_BITS, LUT_DECIMATION, checked);
+#endif
+    TEST_CHECK(checked > 0, "no decimation to check");
+
+    return 0;
+}
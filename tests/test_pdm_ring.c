@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// Stress test of the raw buffer ring (pdm_ring.c). First 20000 randomised
+// interleavings of a producer filling raw buffers word by word, as the DMA
+// does, and publishing each one it completes, with a consumer acquiring,
+// reading and releasing them, recovering from underruns by waiting or
+// replaying and resyncing now and then, over ring sizes from 4 to 64: a raw
+// buffer acquired is always complete, it is only overwritten while being read
+// once the producer lapped the reader, and the counts of raw buffers read,
+// dropped and repeated add up. Then the same with the producer on its own
+// thread, in bursts and pauses, against a consumer checking every word.
+
+#include <pthread.h>
+#include <sched.h>
+
+#include "pdm_ring.h"
+
+#include "test_common.h"
+
+#define INTERLEAVINGS 20000
+#define STEPS 2000 // producer and consumer steps per interleaving
+#define WORDS 8 // per raw buffer
+#define COUNT_MAX 64
+
+#define THREAD_COUNT 16
+#define THREAD_WORDS 64
+#define THREAD_BLOCKS 50000
+
+static uint32_t data[COUNT_MAX][WORDS];
+
+static void interleave(uint32_t* seed, int iteration) {
+    const uint32_t count = 4 + 2 * (test_random(seed) % 31);
+    const uint32_t resync_fill = test_random(seed) % count;
+    const uint32_t producer_percent = test_random(seed) % 100;
+    const uint32_t mode = test_random(seed) % 3; // wait, replay, or both and resync
+    struct pdm_ring ring;
+    uint32_t word = 0;
+    int index = -1;
+    uint32_t sequence = 0;
+    uint32_t read_word = 0;
+    uint32_t released = 0;
+    uint32_t torn = 0;
+
+    pdm_ring_init(&ring, count, resync_fill);
+    memset(data, 0xFF, sizeof(data));
+
+    for (int step = 0; step < STEPS; step++) {
+        if (test_random(seed) % 100 < producer_percent) {
+            data[ring.written % count][word] = ring.written;
+            if (++word == WORDS) {
+                word = 0;
+                pdm_ring_publish(&ring, ring.written + 1);
+            }
+            continue;
+        }
+
+        if (index < 0) {
+            const uint32_t fill = ring.written - ring.read;
+            const uint32_t available = pdm_ring_available(&ring);
+            const uint32_t overruns = ring.overruns;
+
+            TEST_CHECK(available == ((fill > count - 2) ? count - 2 : fill), "%d: %u available of %u", iteration, available, fill);
+
+            index = pdm_ring_acquire(&ring);
+            TEST_CHECK(fill > count - 2 || (ring.overruns == overruns && (index >= 0) == (fill > 0)),
+                       "%d: fill %u acquired %d, %u overruns", iteration, fill, index, ring.overruns - overruns);
+
+            if (index < 0) {
+                pdm_ring_underrun(&ring, mode == 1 || (mode == 2 && test_random(seed) % 2));
+                TEST_CHECK((int32_t)(ring.written - ring.read) >= 0, "%d: read %u past written %u", iteration, ring.read,
+                           ring.written);
+                continue;
+            }
+
+            TEST_CHECK((uint32_t)index == ring.read % count, "%d: index %d for raw buffer %u", iteration, index, ring.read);
+            TEST_CHECK(ring.written - ring.read - 1 < count - 2, "%d: acquired %u with %u written", iteration, ring.read,
+                       ring.written);
+            sequence = ring.read;
+            read_word = 0;
+            for (int w = 0; w < WORDS; w++) {
+                TEST_CHECK(data[index][w] == sequence, "%d: raw buffer %u acquired incomplete", iteration, sequence);
+            }
+            continue;
+        }
+
+        // overwritten under the reader only once the producer is a whole ring ahead
+        if (data[index][read_word] != sequence) {
+            TEST_CHECK(ring.written >= sequence + count, "%d: raw buffer %u overwritten with %u written", iteration, sequence,
+                       ring.written);
+            torn++;
+        }
+        if (++read_word == WORDS) {
+            pdm_ring_release(&ring);
+            released++;
+            index = -1;
+
+            if (mode == 2 && test_random(seed) % 50 == 0) {
+                pdm_ring_resync(&ring, test_random(seed) % count);
+                TEST_CHECK((int32_t)(ring.written - ring.read) >= 0, "%d: resynced past written", iteration);
+            }
+        }
+    }
+
+    if (index >= 0) {
+        pdm_ring_release(&ring);
+        released++;
+    }
+    TEST_CHECK(ring.read == released + ring.dropped - ring.repeated, "%d: read %u, released %u, dropped %u, repeated %u",
+               iteration, ring.read, released, ring.dropped, ring.repeated);
+
+    if (iteration < 6) {
+        printf("count %2u, producer %2u%%, mode %u: %4u written, %4u read, %3u overruns, %4u underruns, %4u dropped, "
+               "%4u repeated, %u words overwritten\n", count, producer_percent, mode, ring.written, ring.read,
+               ring.overruns, ring.underruns, ring.dropped, ring.repeated, torn);
+    }
+}
+
+static struct pdm_ring thread_ring;
+static volatile uint32_t thread_data[THREAD_COUNT][THREAD_WORDS];
+static volatile bool thread_done;
+
+static void* producer(void* arg) {
+    uint32_t seed = 7;
+
+    (void)arg;
+    for (uint32_t s = 0; s < THREAD_BLOCKS; s++) {
+        for (int w = 0; w < THREAD_WORDS; w++) {
+            thread_data[s % THREAD_COUNT][w] = s;
+        }
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        pdm_ring_publish(&thread_ring, s + 1);
+
+        // bursts of raw buffers, giving the CPU away in between, and now and
+        // then a pause long enough for the consumer to underrun
+        for (volatile int k = 2000; k; k--);
+        if (test_random(&seed) % 4 == 0) {
+            sched_yield();
+        }
+        if (s % 1000 == 0) {
+            for (volatile int k = test_random(&seed) % 100000; k; k--);
+        }
+    }
+    thread_done = true;
+
+    return NULL;
+}
+
+static void threads() {
+    pthread_t thread;
+    uint32_t released = 0;
+    uint32_t torn = 0;
+    uint32_t last = 0;
+
+    pdm_ring_init(&thread_ring, THREAD_COUNT, THREAD_COUNT / 2);
+    pthread_create(&thread, NULL, producer, NULL);
+
+    while (!thread_done || pdm_ring_available(&thread_ring)) {
+        const int index = pdm_ring_acquire(&thread_ring);
+
+        if (index < 0) {
+            pdm_ring_underrun(&thread_ring, false);
+            sched_yield(); // the producer may share the CPU
+            continue;
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        const uint32_t s = thread_ring.read;
+        TEST_CHECK(s >= last, "read went back from %u to %u", last, s);
+        last = s;
+
+        for (int w = 0; w < THREAD_WORDS; w++) {
+            if (thread_data[index][w] != s) {
+                __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                TEST_CHECK(thread_ring.written >= s + THREAD_COUNT, "raw buffer %u overwritten with %u written", s,
+                           thread_ring.written);
+                torn++;
+                break;
+            }
+        }
+        pdm_ring_release(&thread_ring);
+        released++;
+    }
+    pthread_join(thread, NULL);
+
+    printf("two threads: %u written, %u read, %u overruns, %u underruns, %u dropped, %u overwritten while read\n",
+           thread_ring.written, released, thread_ring.overruns, thread_ring.underruns, thread_ring.dropped, torn);
+    TEST_CHECK(thread_ring.read == released + thread_ring.dropped - thread_ring.repeated, "read %u, released %u, dropped %u",
+               thread_ring.read, released, thread_ring.dropped);
+    TEST_CHECK(thread_ring.read == THREAD_BLOCKS, "read up to %u of %u", thread_ring.read, THREAD_BLOCKS);
+}
+
+int main() {
+    uint32_t seed = 1;
+
+    for (int i = 0; i < INTERLEAVINGS; i++) {
+        interleave(&seed, i);
+    }
+    threads();
+
+    return 0;
+}
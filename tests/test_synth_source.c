@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ */
+
+// The synthetic audio source (synth_source.c) through the audio source calls:
+//  - tone: channel j at (j + 1) times the frequency, at the configured
+//    amplitude and a SINAD well above 16 bits' worth
+//  - PDM: the tone through the sigma-delta modulator and back through the
+//    multi-stage decimator at /48 (1 half-band), /64 and /128, at the tone's
+//    amplitude and a SINAD for each decimation
+//  - read32: the Q31 samples of the same config round to the 16-bit ones
+//  - noise: uniform within the amplitude, independent per channel, and the
+//    same samples however the reads split them
+//  - the rest of the interface: stats counting whole blocks read, no
+//    latency, configs rejected, and deinit releasing the context
+
+#include "pico/synth_source.h"
+
+#include "test_common.h"
+
+#define FS 16000
+#define BLOCK 48 // samples per channel per block
+#define N 4096 // samples per channel analysed, a whole number of tone cycles
+#define SKIP 2048 // samples per channel skipped while the PDM decimator settles
+#define FREQUENCY 1000
+#define AMPLITUDE 16384
+
+#define TONE_SINAD_DB 88.0 // measured 92.7 dB
+#define AMPLITUDE_DB 0.1
+
+struct pdm_case {
+    uint decimation;
+    uint filter_stages;
+    double sinad_db; // limit, about 3 dB under the measured SINAD
+};
+
+static const struct pdm_case pdm_cases[] = {
+    { 48, 1, 61.0 }, { 64, 2, 68.0 }, { 128, 2, 80.0 },
+};
+
+static int16_t buffer[SYNTH_SOURCE_CHANNELS_MAX * (SKIP + N)];
+static int16_t split[SYNTH_SOURCE_CHANNELS_MAX * (SKIP + N)];
+static int32_t buffer32[SYNTH_SOURCE_CHANNELS_MAX * (SKIP + N)];
+static double x[SKIP + N];
+
+// SINAD and amplitude (in dB of AMPLITUDE) of channel ch's tone, past skip
+static void measure(const int16_t* samples, size_t n_samples, uint ch, size_t skip, double* sinad, double* amplitude_db) {
+    const double frequency = (double)FREQUENCY * (ch + 1) / FS;
+
+    for (size_t i = 0; i < N; i++) {
+        x[i] = samples[ch * n_samples + skip + i];
+    }
+    *sinad = test_sinad(x, N, frequency);
+    *amplitude_db = 20 * log10(test_tone_amplitude(x, N, frequency) / AMPLITUDE);
+}
+
+static void check_tone() {
+    const struct synth_source_config config = {
+        .signal = SYNTH_SOURCE_TONE,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .channels = 2,
+        .frequency = FREQUENCY,
+        .amplitude = AMPLITUDE,
+    };
+    struct audio_source source;
+
+    TEST_CHECK(synth_source_init(&source, &config) == 0, "tone: init failed");
+    TEST_CHECK(audio_source_start(&source) == 0, "tone: start failed");
+    TEST_CHECK(audio_source_read(&source, buffer, N) == N, "tone: short read");
+
+    for (uint ch = 0; ch < config.channels; ch++) {
+        double sinad, amplitude_db;
+
+        measure(buffer, N, ch, 0, &sinad, &amplitude_db);
+        printf("tone, channel %u at %u Hz: SINAD %.1f dB, amplitude %+.3f dB\n", ch, FREQUENCY * (ch + 1), sinad,
+               amplitude_db);
+        TEST_CHECK(sinad >= TONE_SINAD_DB, "tone channel %u: SINAD %.1f dB", ch, sinad);
+        TEST_CHECK(fabs(amplitude_db) < AMPLITUDE_DB, "tone channel %u: amplitude %+.3f dB", ch, amplitude_db);
+    }
+
+    // the Q31 samples from the start again, rounded as the 16-bit reads
+    audio_source_start(&source);
+    TEST_CHECK(audio_source_read32(&source, buffer32, N) == N, "tone: short read32");
+    for (size_t i = 0; i < config.channels * N; i++) {
+        const int32_t rounded = (buffer32[i] > 0x7FFF7FFF) ? 32767 : (buffer32[i] + 0x8000) >> 16;
+
+        TEST_CHECK(rounded == buffer[i], "tone: Q31 sample %zu rounds to %d, not %d", i, rounded, buffer[i]);
+    }
+
+    audio_source_deinit(&source);
+    TEST_CHECK(source.context == NULL, "tone: context left after deinit");
+}
+
+static void check_pdm(const struct pdm_case* c) {
+    const struct synth_source_config config = {
+        .signal = SYNTH_SOURCE_PDM,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .channels = 2,
+        .frequency = FREQUENCY,
+        .amplitude = AMPLITUDE,
+        .decimation = c->decimation,
+        .filter_stages = c->filter_stages,
+    };
+    struct audio_source source;
+    int max_error = 0;
+
+    TEST_CHECK(synth_source_init(&source, &config) == 0, "PDM /%u: init failed", c->decimation);
+    TEST_CHECK(audio_source_read(&source, buffer, SKIP + N) == SKIP + N, "PDM /%u: short read", c->decimation);
+
+    for (uint ch = 0; ch < config.channels; ch++) {
+        double sinad, amplitude_db;
+
+        measure(buffer, SKIP + N, ch, SKIP, &sinad, &amplitude_db);
+        printf("PDM /%-3u %u half-band(s), channel %u: SINAD %.1f dB (limit %.1f), amplitude %+.3f dB\n", c->decimation,
+               c->filter_stages, ch, sinad, c->sinad_db, amplitude_db);
+        TEST_CHECK(sinad >= c->sinad_db, "PDM /%u channel %u: SINAD %.1f dB", c->decimation, ch, sinad);
+        TEST_CHECK(fabs(amplitude_db) < AMPLITUDE_DB, "PDM /%u channel %u: amplitude %+.3f dB", c->decimation, ch,
+                   amplitude_db);
+    }
+
+    // the Q31 reads of the same bit streams, within a 16-bit step
+    audio_source_start(&source);
+    TEST_CHECK(audio_source_read32(&source, buffer32, SKIP + N) == SKIP + N, "PDM /%u: short read32", c->decimation);
+    for (size_t i = 0; i < config.channels * (SKIP + N); i++) {
+        const int error = abs((int)((buffer32[i] + 0x8000) >> 16) - buffer[i]);
+
+        max_error = (error > max_error) ? error : max_error;
+    }
+    TEST_CHECK(max_error <= 1, "PDM /%u: Q31 samples up to %d off the 16-bit ones", c->decimation, max_error);
+
+    audio_source_deinit(&source);
+}
+
+static void check_noise() {
+    const struct synth_source_config config = {
+        .signal = SYNTH_SOURCE_NOISE,
+        .sample_rate = FS,
+        .sample_buffer_size = BLOCK,
+        .channels = 4,
+        .amplitude = AMPLITUDE,
+        .seed = 12345,
+    };
+    const size_t n = SKIP + N;
+    struct audio_source source;
+    struct audio_source_stats stats;
+    uint32_t seed = 1;
+
+    TEST_CHECK(synth_source_init(&source, &config) == 0, "noise: init failed");
+    TEST_CHECK(audio_source_read(&source, buffer, n) == (int)n, "noise: short read");
+
+    // the same samples in reads of 1 to 100 samples
+    audio_source_start(&source);
+    for (size_t done = 0; done < n;) {
+        const size_t chunk = (1 + test_random(&seed) % 100 < n - done) ? 1 + test_random(&seed) % 100 : n - done;
+        int16_t part[SYNTH_SOURCE_CHANNELS_MAX * 100];
+
+        TEST_CHECK(audio_source_read(&source, part, chunk) == (int)chunk, "noise: short read of %zu", chunk);
+        for (uint ch = 0; ch < config.channels; ch++) {
+            memcpy(&split[ch * n + done], &part[ch * chunk], chunk * sizeof(part[0]));
+        }
+        done += chunk;
+    }
+    TEST_CHECK(!memcmp(buffer, split, config.channels * n * sizeof(buffer[0])), "noise: depends on how reads split it");
+
+    // level, and no correlation between the channels
+    double power[SYNTH_SOURCE_CHANNELS_MAX] = { 0 };
+    double worst_correlation = 0;
+
+    for (uint ch = 0; ch < config.channels; ch++) {
+        for (size_t i = 0; i < n; i++) {
+            TEST_CHECK(abs(buffer[ch * n + i]) <= AMPLITUDE, "noise: channel %u sample %zu is %d", ch, i, buffer[ch * n + i]);
+            power[ch] += (double)buffer[ch * n + i] * buffer[ch * n + i];
+        }
+    }
+    for (uint a = 0; a < config.channels; a++) {
+        TEST_CHECK(fabs(sqrt(power[a] / n) / (AMPLITUDE / sqrt(3)) - 1) < 0.02, "noise: channel %u rms %.1f", a,
+                   sqrt(power[a] / n));
+        for (uint b = a + 1; b < config.channels; b++) {
+            double product = 0;
+
+            for (size_t i = 0; i < n; i++) {
+                product += (double)buffer[a * n + i] * buffer[b * n + i];
+            }
+            const double correlation = fabs(product / sqrt(power[a] * power[b]));
+            worst_correlation = (correlation > worst_correlation) ? correlation : worst_correlation;
+        }
+    }
+    printf("noise, %u channels: rms %.1f (%.1f expected), worst correlation %.4f, same in split reads\n", config.channels,
+           sqrt(power[0] / n), AMPLITUDE / sqrt(3), worst_correlation);
+    TEST_CHECK(worst_correlation < 0.05, "noise: channels correlated by %.4f", worst_correlation);
+
+    // whole blocks read since the last start, and nothing else to report
+    audio_source_get_stats(&source, &stats);
+    TEST_CHECK(stats.blocks_written == n / BLOCK && stats.blocks_read == n / BLOCK, "noise: %u blocks written, %u read",
+               stats.blocks_written, stats.blocks_read);
+    TEST_CHECK(!stats.overruns && !stats.underruns && !stats.blocks_dropped && !stats.blocks_repeated && !stats.saturated,
+               "noise: stats other than blocks");
+    TEST_CHECK(audio_source_latency_us(&source) == 0, "noise: latency");
+    TEST_CHECK(source.channels == config.channels && source.sample_rate == FS && source.sample_buffer_size == BLOCK,
+               "noise: source fields");
+    audio_source_stop(&source);
+    audio_source_deinit(&source);
+}
+
+static void check_rejected() {
+    static const struct synth_source_config rejected[] = {
+        { .signal = SYNTH_SOURCE_TONE, .sample_rate = FS, .sample_buffer_size = BLOCK, .channels = 0 },
+        { .signal = SYNTH_SOURCE_TONE, .sample_rate = FS, .sample_buffer_size = BLOCK, .channels = SYNTH_SOURCE_CHANNELS_MAX + 1 },
+        { .signal = SYNTH_SOURCE_TONE, .sample_rate = 0, .sample_buffer_size = BLOCK, .channels = 1 },
+        { .signal = SYNTH_SOURCE_TONE, .sample_rate = FS, .sample_buffer_size = 0, .channels = 1 },
+        { .signal = SYNTH_SOURCE_PDM, .sample_rate = FS, .sample_buffer_size = BLOCK, .channels = 1,
+          .amplitude = SYNTH_SOURCE_PDM_AMPLITUDE_MAX + 1 },
+        { .signal = SYNTH_SOURCE_PDM, .sample_rate = FS, .sample_buffer_size = BLOCK, .channels = 3 },
+        { .signal = SYNTH_SOURCE_PDM, .sample_rate = FS, .sample_buffer_size = BLOCK, .channels = 1, .decimation = 48 },
+    };
+    struct audio_source source;
+
+    for (size_t i = 0; i < sizeof(rejected) / sizeof(rejected[0]); i++) {
+        TEST_CHECK(synth_source_init(&source, &rejected[i]) == -1, "config %zu accepted", i);
+    }
+    printf("rejected configs: ok\n");
+}
+
+int main() {
+    check_tone();
+    for (size_t i = 0; i < sizeof(pdm_cases) / sizeof(pdm_cases[0]); i++) {
+        check_pdm(&pdm_cases[i]);
+    }
+    check_noise();
+    check_rejected();
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2021 Arm Limited and Contributors. All rights reserved.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Host tool that prints the PDM clock plan for a set of output sample rates:
+ *
+ *   cc -O2 -I../src/include -o pdm_clock_planner pdm_clock_planner.c ../src/pdm_clock.c -lm
+ *   ./pdm_clock_planner [-s min_khz:max_khz] [-p min_hz:max_hz] [-c cycles_per_bit] [-d 48,64,128] [-t ppm] rate...
+ *
+ * e.g. ./pdm_clock_planner 44100 48000 88200 96000
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/pdm_clock.h"
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-s min_khz:max_khz] [-p min_hz:max_hz] [-c cycles_per_bit] [-d decimation,...] [-t ppm] rate...\n", name);
+    exit(1);
+}
+
+int main(int argc, char* argv[]) {
+    uint32_t sample_rates[PDM_CLOCK_RATES_MAX];
+    uint8_t decimations[8] = { 48, 64, 128 };
+    struct pdm_clock_request request = {
+        .sample_rates = sample_rates,
+        .decimations = decimations,
+        .n_decimations = 3,
+        .cycles_per_bit = 4, // pdm_microphone_data_n1/n2/n4
+        .sys_clock_min_khz = 48000,
+        .sys_clock_max_khz = 133000,
+        .pdm_clock_min_hz = 1000000,
+        .pdm_clock_max_hz = 4800000,
+        .tolerance_ppm = 100, // well within what the ASRC / USB feedback absorbs
+    };
+    struct pdm_clock_plan plan;
+    int i;
+
+    for (i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u:%u", &request.sys_clock_min_khz, &request.sys_clock_max_khz) != 2) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u:%u", &request.pdm_clock_min_hz, &request.pdm_clock_max_hz) != 2) {
+                usage(argv[0]);
+            }
+        } else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) {
+            request.cycles_per_bit = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            request.tolerance_ppm = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            char* d = strtok(argv[++i], ",");
+            request.n_decimations = 0;
+            while (d && request.n_decimations < sizeof(decimations)) {
+                decimations[request.n_decimations++] = atoi(d);
+                d = strtok(NULL, ",");
+            }
+        } else if (argv[i][0] == '-' || request.n_sample_rates == PDM_CLOCK_RATES_MAX) {
+            usage(argv[0]);
+        } else {
+            sample_rates[request.n_sample_rates++] = atoi(argv[i]);
+        }
+    }
+
+    if (request.n_sample_rates == 0) {
+        usage(argv[0]);
+    }
+
+    if (pdm_clock_plan(&request, &plan) < 0) {
+        fprintf(stderr, "no clk_sys between %u and %u kHz works for all rates\n",
+                request.sys_clock_min_khz, request.sys_clock_max_khz);
+        return 1;
+    }
+
+    printf("clk_sys %u kHz\n", plan.sys_clock_khz);
+    printf("%8s %5s %12s %10s %14s %10s %10s\n", "rate", "dec", "clkdiv", "PDM clk", "achieved", "error ppm", "jitter ns");
+    for (i = 0; i < plan.n_configs; i++) {
+        const struct pdm_clock_config* c = &plan.config[i];
+
+        printf("%8u %5u %6u+%3u/256 %10u %14.4f %10.3f %10.2f\n", c->sample_rate, c->decimation, c->clkdiv_int,
+               c->clkdiv_frac, c->pdm_clock_hz, c->achieved_rate, c->rate_error_ppm, c->jitter_ns);
+    }
+
+    return 0;
+}